@@ -7,6 +7,7 @@
 #include <Match/core/utils.hpp>
 #include <Match/core/setting.hpp>
 #include <Match/core/loader.hpp>
+#include <Match/core/thread_pool.hpp>
 #include <Match/vulkan/manager.hpp>
 #include <Match/vulkan/renderer.hpp>
 #include <Match/imgui/imgui.hpp>
@@ -8,5 +8,7 @@
 namespace Match {
     MATCH_API std::vector<std::string> EnumerateDevices();
     MATCH_API APIManager &Initialize();
+    // 会等待设备空闲, 不要在录制帧的过程中调用
+    MATCH_API DefragmentationStats Defragment();
     MATCH_API void Destroy();
 }
@@ -20,6 +20,7 @@ namespace Match {
         std::string chinese_font_filename = "";
         float font_size = 13.0f;
         bool enable_ray_tracing = false;
+        bool enable_async_compute = false;
         std::vector<std::string> device_extensions {};
     };
 
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <Match/commons.hpp>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Match {
+    // 常驻的工作线程池, 由APIManager创建一次, 各模块共享, 避免每次并行计算都创建线程
+    class ThreadPool {
+        no_copy_move_construction(ThreadPool)
+    public:
+        // thread_count包括调用线程, 为0时使用硬件线程数
+        MATCH_API ThreadPool(uint32_t thread_count = 0);
+        uint32_t get_thread_count() const { return thread_count; }
+        // 将task_count个任务分给至多max_worker_count个线程(包括调用线程), 阻塞直到全部完成
+        // task的第二个参数是线程序号, 小于实际参与的线程数, 可用来索引每个线程的临时数据
+        // max_worker_count为0时使用全部线程, 在任务中嵌套调用时直接在当前线程中执行
+        MATCH_API void parallel_for(uint32_t task_count, const std::function<void(uint32_t, uint32_t)> &task, uint32_t max_worker_count = 0);
+        MATCH_API ~ThreadPool();
+    INNER_VISIBLE:
+        MATCH_API void worker_loop();
+        MATCH_API void run_tasks(uint32_t worker_idx);
+    INNER_VISIBLE:
+        uint32_t thread_count;
+        std::vector<std::thread> workers;
+        // 同一时间只分发一组任务
+        std::mutex dispatch_mutex;
+        std::mutex mutex;
+        std::condition_variable job_condition;
+        std::condition_variable done_condition;
+        bool stop;
+        uint64_t generation;
+        const std::function<void(uint32_t, uint32_t)> *task;
+        uint32_t task_count;
+        std::atomic<uint32_t> next_task;
+        uint32_t worker_limit;
+        uint32_t joined_count;
+        uint32_t running_count;
+    };
+}
@@ -8,6 +8,22 @@ namespace Match {
 
     MATCH_API std::vector<char> read_binary_file(const std::string &filename);
 
+    // 只读映射整个文件, 数据由操作系统按需换页, 不占用额外的堆内存
+    class MappedFile {
+        no_copy_move_construction(MappedFile)
+    public:
+        MATCH_API MappedFile(const std::string &filename);
+        bool is_mapped() const { return data != nullptr; }
+        const uint8_t *get_data() const { return data; }
+        uint64_t get_size() const { return size; }
+        MATCH_API ~MappedFile();
+    INNER_VISIBLE:
+        const uint8_t *data;
+        uint64_t size;
+        void *file_handle;
+        void *mapping_handle;
+    };
+
     template <class T>
     ClassHashCode get_class_hash_code() {
         return typeid(std::remove_reference_t<T>).hash_code();
@@ -6,7 +6,7 @@ namespace Match {
     class CommandPool {
         no_copy_move_construction(CommandPool)
     public:
-        MATCH_API CommandPool(vk::CommandPoolCreateFlags flags);
+        MATCH_API CommandPool(vk::CommandPoolCreateFlags flags, uint32_t queue_family_index = -1u);
         MATCH_API ~CommandPool();
         MATCH_API std::vector<vk::CommandBuffer> allocate_command_buffer(uint32_t count);
         MATCH_API vk::CommandBuffer allocate_single_use();
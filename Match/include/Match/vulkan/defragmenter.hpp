@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Match/vulkan/commons.hpp>
+
+namespace Match {
+    class Defragmentable {
+        default_no_copy_move_construction(Defragmentable)
+    public:
+        virtual ~Defragmentable() = default;
+        virtual bool is_movable() = 0;
+        virtual void begin_move(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) = 0;
+        virtual void end_move() = 0;
+    };
+
+    struct DefragmentationStats {
+        uint64_t bytes_moved = 0;
+        uint64_t bytes_freed = 0;
+        uint32_t allocations_moved = 0;
+        uint32_t device_memory_blocks_freed = 0;
+        float fragmentation_before = 0;
+        float fragmentation_after = 0;
+    };
+
+    class Defragmenter {
+        no_copy_move_construction(Defragmenter)
+        using ResourceMovedCallback = std::function<void()>;
+        struct MovedAddressRange {
+            vk::DeviceAddress old_address;
+            vk::DeviceAddress new_address;
+            uint64_t size;
+        };
+    public:
+        MATCH_API Defragmenter();
+        MATCH_API DefragmentationStats defragment();
+        MATCH_API vk::DeviceAddress remap_address(vk::DeviceAddress address) const;
+        MATCH_API uint32_t register_resource_moved_callback(const ResourceMovedCallback &callback);
+        MATCH_API void remove_resource_moved_callback(uint32_t id);
+        MATCH_API ~Defragmenter();
+    INNER_VISIBLE:
+        MATCH_API void report_moved_address(vk::DeviceAddress old_address, vk::DeviceAddress new_address, uint64_t size);
+        MATCH_API float calculate_fragmentation();
+    INNER_VISIBLE:
+        uint32_t current_callback_id;
+        std::map<uint32_t, ResourceMovedCallback> callbacks;
+        std::vector<MovedAddressRange> moved_address_ranges;
+    };
+}
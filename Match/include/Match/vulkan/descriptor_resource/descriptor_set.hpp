@@ -48,11 +48,18 @@ namespace Match {
     private:
         MATCH_API vk::DescriptorSetLayoutBinding &get_layout_binding(uint32_t binding);
         MATCH_API void update_input_attachments();
+        MATCH_API void register_resource_moved_callback();
+        MATCH_API void update_moved_resources();
     INNER_VISIBLE:
         bool allocated;
         std::optional<std::weak_ptr<Renderer>> renderer;
         std::map<uint32_t, std::vector<std::pair<std::string, std::shared_ptr<Sampler>>>> input_attachments_temp;
+        // 碎片整理后重新绑定用, 只保存弱引用, 不延长资源的生命周期
+        std::map<uint32_t, std::vector<std::pair<std::weak_ptr<Texture>, std::weak_ptr<Sampler>>>> textures_temp;
+        std::map<uint32_t, std::vector<std::weak_ptr<StorageBuffer>>> storage_buffers_temp;
+        std::map<uint32_t, std::vector<std::weak_ptr<StorageImage>>> storage_images_temp;
         std::optional<uint32_t> callback_id;
+        std::optional<uint32_t> moved_callback_id;
         std::vector<vk::DescriptorSetLayoutBinding> layout_bindings;
         vk::DescriptorSetLayout descriptor_layout;
         std::vector<vk::DescriptorSet> descriptor_sets;
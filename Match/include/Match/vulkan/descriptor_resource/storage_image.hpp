@@ -8,6 +8,7 @@ namespace Match {
         no_copy_move_construction(StorageImage)
     public:
         MATCH_API StorageImage(uint32_t width, uint32_t height, vk::Format format, bool sampled, bool enable_clear);
+        MATCH_API StorageImage(std::unique_ptr<Image> image);
         vk::ImageLayout get_image_layout() override { return vk::ImageLayout::eGeneral; }
         vk::ImageView get_image_view() override { return image_view; };
         uint32_t get_mip_levels() override { return 1; };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Match/vulkan/commons.hpp>
+#include <deque>
+#include <mutex>
+
+namespace Match {
+    class DestructionQueue {
+        no_copy_move_construction(DestructionQueue)
+        using Destroyer = std::function<void()>;
+    public:
+        MATCH_API DestructionQueue();
+        MATCH_API void enqueue(const Destroyer &destroyer);
+        MATCH_API void submit_frame();
+        MATCH_API void collect();
+        MATCH_API void flush();
+        MATCH_API ~DestructionQueue();
+    INNER_VISIBLE:
+        std::mutex mutex;
+        uint64_t current_frame;
+        std::deque<std::pair<uint64_t, Destroyer>> destroyers;
+    };
+}
@@ -21,6 +21,8 @@ namespace Match {
         uint32_t present_family_index = -1;
         vk::Queue compute_queue;
         uint32_t compute_family_index = -1;
+        uint32_t compute_queue_index = 0;
+        std::vector<uint32_t> concurrent_family_indices;
         vk::Queue transfer_queue;
         uint32_t transfer_family_index = -1;
     };
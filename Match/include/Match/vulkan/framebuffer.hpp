@@ -3,6 +3,7 @@
 #include <Match/vulkan/commons.hpp>
 #include <Match/vulkan/resource/image.hpp>
 #include <Match/vulkan/resource/shader_program.hpp>
+#include <Match/vulkan/resource/renderpass_builder.hpp>
 
 namespace Match {
     class Renderer;
@@ -11,7 +12,8 @@ namespace Match {
         no_copy_construction(Attachment)
     public:
         MATCH_API Attachment();
-        MATCH_API Attachment(const vk::AttachmentDescription& description, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect);
+        MATCH_API Attachment(const vk::AttachmentDescription& description, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect, VmaMemoryUsage vma_usage = VMA_MEMORY_USAGE_AUTO);
+        MATCH_API Attachment(std::unique_ptr<Image> image, vk::ImageAspectFlags aspect);
         MATCH_API Attachment(Attachment &&rhs);
         MATCH_API void operator=(Attachment &&rhs);
         MATCH_API ~Attachment();
@@ -35,6 +37,9 @@ namespace Match {
         MATCH_API FrameBufferSet(const Renderer &renderer);
         MATCH_API ~FrameBufferSet();
     INNER_VISIBLE:
+        MATCH_API void create_aliased_attachments(const RenderPassBuilder &builder);
+    INNER_VISIBLE:
+        std::vector<VmaAllocation> aliased_allocations;
         std::vector<Attachment> attachments;
         std::vector<std::unique_ptr<FrameBuffer>> framebuffers;
     };
@@ -4,9 +4,13 @@
 #include <Match/vulkan/device.hpp>
 #include <Match/vulkan/swapchain.hpp>
 #include <Match/core/setting.hpp>
+#include <Match/core/thread_pool.hpp>
 #include <Match/vulkan/resource/resource_factory.hpp>
 #include <Match/vulkan/command_pool.hpp>
 #include <Match/vulkan/descriptor_resource/descriptor_pool.hpp>
+#include <Match/vulkan/defragmenter.hpp>
+#include <Match/vulkan/destruction_queue.hpp>
+#include <Match/vulkan/resource/staging_buffer_pool.hpp>
 
 namespace Match {
     class APIManager {
@@ -24,12 +28,16 @@ namespace Match {
         MATCH_API std::shared_ptr<RuntimeSetting> get_runtime_setting();
         MATCH_API std::shared_ptr<ResourceFactory> create_resource_factory(const std::string &root);
         MATCH_API CommandPool &get_command_pool();
+        MATCH_API ThreadPool &get_thread_pool();
+        MATCH_API DefragmentationStats defragment();
         MATCH_API void destroy();
     private:
         MATCH_API static APIManager &GetInstance();
         MATCH_API static void Quit();
     private:
-        MATCH_API void recreate_swapchin();
+        MATCH_API std::unique_ptr<Swapchain> recreate_swapchin();
+    INNER_VISIBLE:
+        MATCH_API void destroy_later(const std::function<void()> &destroyer);
     private:
         MATCH_API void create_vk_instance();
         MATCH_API void create_vk_surface();
@@ -46,5 +54,9 @@ namespace Match {
         std::unique_ptr<Swapchain> swapchain;
         std::unique_ptr<CommandPool> command_pool;
         std::unique_ptr<DescriptorPool> descriptor_pool;
+        std::unique_ptr<Defragmenter> defragmenter;
+        std::unique_ptr<StagingBufferPool> staging_buffer_pool;
+        std::unique_ptr<DestructionQueue> destruction_queue;
+        std::unique_ptr<ThreadPool> thread_pool;
     };
 }
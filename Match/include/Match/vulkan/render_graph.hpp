@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/descriptor_resource/storage_image.hpp>
+#include <Match/vulkan/descriptor_resource/storage_buffer.hpp>
+
+namespace Match {
+    class RenderGraph;
+
+    class RenderGraphPass {
+        no_copy_move_construction(RenderGraphPass)
+        using ExecuteCallback = std::function<void()>;
+        struct ResourceReference {
+            std::string name;
+            RenderGraphResourceUsage usage;
+            bool write;
+        };
+    public:
+        RenderGraphPass(const std::string &name, RenderGraphPassType type) : name(name), type(type) {}
+        MATCH_API RenderGraphPass &read(const std::string &resource_name, RenderGraphResourceUsage usage);
+        MATCH_API RenderGraphPass &write(const std::string &resource_name, RenderGraphResourceUsage usage);
+        MATCH_API RenderGraphPass &set_side_effect();
+        MATCH_API RenderGraphPass &execute(const ExecuteCallback &callback);
+    INNER_VISIBLE:
+        std::string name;
+        RenderGraphPassType type;
+        bool side_effect = false;
+        std::vector<ResourceReference> references;
+        ExecuteCallback callback;
+    };
+
+    class RenderGraph {
+        no_copy_move_construction(RenderGraph)
+        // Pass对资源的一次访问
+        struct AccessState {
+            vk::PipelineStageFlags stage;
+            vk::AccessFlags access;
+            vk::ImageLayout layout;
+        };
+        // 最后一次写入(包括布局转换)已经对哪些阶段和访问可见, 读取需要的阶段或访问没有被覆盖时才需要屏障
+        struct ResourceState {
+            vk::PipelineStageFlags write_stage;
+            vk::AccessFlags write_access;
+            vk::PipelineStageFlags visible_stage;
+            vk::AccessFlags visible_access;
+            // 最后一次写入之后读取过的阶段, 下一次写入或布局转换前需要等待
+            vk::PipelineStageFlags read_stage;
+            vk::ImageLayout layout;
+        };
+        struct Resource {
+            std::shared_ptr<StorageImage> image;
+            std::shared_ptr<StorageBuffer> buffer;
+            bool transient = false;
+            bool output = false;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            vk::Format format = vk::Format::eUndefined;
+            std::pair<uint32_t, uint32_t> lifetime { -1u, 0 };
+            uint32_t alias_group = -1u;
+            ResourceState state { vk::PipelineStageFlagBits::eAllCommands, vk::AccessFlagBits::eMemoryWrite, {}, {}, {}, vk::ImageLayout::eGeneral };
+        };
+    public:
+        MATCH_API RenderGraph(std::weak_ptr<Renderer> renderer);
+        MATCH_API RenderGraph &import_image(const std::string &name, std::shared_ptr<StorageImage> image);
+        MATCH_API RenderGraph &import_buffer(const std::string &name, std::shared_ptr<StorageBuffer> buffer);
+        MATCH_API RenderGraph &create_image(const std::string &name, uint32_t width, uint32_t height, vk::Format format = vk::Format::eR8G8B8A8Unorm);
+        MATCH_API RenderGraph &mark_output(const std::string &name);
+        MATCH_API RenderGraphPass &add_pass(const std::string &name, RenderGraphPassType type);
+        MATCH_API void compile();
+        MATCH_API void execute();
+        MATCH_API std::shared_ptr<StorageImage> get_image(const std::string &name);
+        MATCH_API vk::ImageLayout get_image_layout(const std::string &name);
+        MATCH_API ~RenderGraph();
+    INNER_VISIBLE:
+        MATCH_API std::vector<uint32_t> sort_passes();
+        MATCH_API void allocate_transient_images();
+        MATCH_API AccessState get_required_state(const RenderGraphPass &pass, uint32_t reference_index);
+        MATCH_API static bool need_barrier(const Resource &resource, const AccessState &required, bool write);
+        MATCH_API bool need_barriers(const RenderGraphPass &pass);
+        MATCH_API void record_barriers(vk::CommandBuffer command_buffer, const RenderGraphPass &pass);
+    INNER_VISIBLE:
+        std::weak_ptr<Renderer> renderer;
+        std::map<std::string, Resource> resources;
+        std::vector<std::unique_ptr<RenderGraphPass>> passes;
+        std::vector<uint32_t> execution_order;
+        std::vector<ResourceState> alias_group_states;
+        std::vector<VmaAllocation> allocations;
+        bool compiled = false;
+    };
+}
@@ -19,11 +19,17 @@ namespace Match {
         Renderer &renderer;
     };
 
+    struct AsyncComputeTiming {
+        float compute_time = 0;
+        float graphics_time = 0;
+        float overlap_time = 0;
+    };
+
     class Renderer {
         no_copy_move_construction(Renderer)
         using ResourceRecreateCallback = std::function<void()>;
     public:
-        MATCH_API Renderer(std::shared_ptr<RenderPassBuilder> builder);
+        MATCH_API Renderer(std::shared_ptr<RenderPassBuilder> builder, RenderingMode mode = RenderingMode::eRenderPass);
         MATCH_API ~Renderer();
         template<class LayerType>
         void attach_render_layer(const std::string &name) {
@@ -38,6 +44,8 @@ namespace Match {
         MATCH_API void acquire_next_image();
         MATCH_API void begin_render_pass();
         MATCH_API void end_render_pass();
+        MATCH_API void suspend_render_pass();
+        MATCH_API void resume_render_pass();
         MATCH_API void report_submit_info(const vk::SubmitInfo &submit_info);
         MATCH_API void present(const std::vector<vk::PipelineStageFlags> &wait_stages = {}, const std::vector<vk::Semaphore> &wait_samaphores = {});
         MATCH_API void begin_render();
@@ -57,6 +65,9 @@ namespace Match {
                 throw std::runtime_error("Match Core Fatal");
             }
             inner_bind_shader_program(bind_point, shader_program);
+            if constexpr (bind_point == vk::PipelineBindPoint::eGraphics) {
+                apply_dynamic_states(*shader_program);
+            }
         }
         MATCH_API void bind_vertex_buffer(const std::shared_ptr<VertexBuffer> &vertex_buffer, uint32_t binding = 0);
         MATCH_API void bind_vertex_buffers(const std::vector<std::shared_ptr<VertexBuffer>> &vertex_buffers, uint32_t first_binding = 0);
@@ -64,6 +75,12 @@ namespace Match {
         MATCH_API void set_viewport(float x, float y, float width, float height);
         MATCH_API void set_viewport(float x, float y, float width, float height, float min_depth, float max_depth);
         MATCH_API void set_scissor(int x, int y, uint32_t width, uint32_t height);
+        MATCH_API void set_cull_mode(CullMode mode);
+        MATCH_API void set_front_face(FrontFace mode);
+        MATCH_API void set_depth_test_enable(bool enable);
+        MATCH_API void set_depth_write_enable(bool enable);
+        MATCH_API void set_depth_compare_op(vk::CompareOp op);
+        MATCH_API void set_primitive_topology(Topology topology);
         MATCH_API void next_subpass();
         MATCH_API void continue_subpass_to(const std::string &subpass_name);
         MATCH_API void draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance);
@@ -71,12 +88,30 @@ namespace Match {
         MATCH_API void draw_mesh(std::shared_ptr<const Mesh> mesh, uint32_t instance_count, uint32_t first_instance);
         MATCH_API void draw_model_mesh(std::shared_ptr<const Model> model, const std::string &name, uint32_t instance_count, uint32_t first_instance);
         MATCH_API void draw_model(std::shared_ptr<const Model> model, uint32_t instance_count, uint32_t first_instance);
+        MATCH_API void draw_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t draw_count = uint32_t(-1), uint32_t first_draw = 0);
+        MATCH_API void draw_indexed_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t draw_count = uint32_t(-1), uint32_t first_draw = 0);
+        MATCH_API void draw_indexed_indirect_count(std::shared_ptr<IndirectBuffer> indirect_buffer, std::shared_ptr<StorageBuffer> count_buffer, uint64_t count_offset = 0, uint32_t max_draw_count = uint32_t(-1));
         MATCH_API void trace_rays(uint32_t width = uint32_t(-1), uint32_t height = uint32_t(-1), uint32_t depth = 1);
         MATCH_API void dispatch(uint32_t group_count_x, uint32_t group_count_y = 1, uint32_t group_count_z = 1);
+        MATCH_API void dispatch_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t index = 0);
+        MATCH_API void memory_barrier(vk::PipelineStageFlags src_stages, vk::AccessFlags src_access, vk::PipelineStageFlags dst_stages, vk::AccessFlags dst_access);
+        MATCH_API void compute_to_compute_barrier();
+        MATCH_API void compute_to_graphics_barrier();
+        // 必须在acquire_next_image之后, present之前调用, 每帧最多录制一次
+        MATCH_API void begin_async_compute();
+        MATCH_API void end_async_compute(vk::PipelineStageFlags graphics_wait_stage = vk::PipelineStageFlagBits::eVertexShader);
+        MATCH_API const AsyncComputeTiming &get_async_compute_timing() const { return async_compute_timing; }
         MATCH_API uint32_t register_resource_recreate_callback(const ResourceRecreateCallback &callback);
         MATCH_API void remove_resource_recreate_callback(uint32_t id);
     private:
         MATCH_API void inner_bind_shader_program(vk::PipelineBindPoint bind_point, std::shared_ptr<ShaderProgram> shader_program);
+        MATCH_API void apply_dynamic_states(const GraphicsShaderProgram &shader_program);
+        MATCH_API void begin_rendering(uint32_t subpass_idx);
+        MATCH_API void end_rendering();
+        MATCH_API void update_async_compute_timing();
+    INNER_VISIBLE:
+        MATCH_API vk::Image get_attachment_image(uint32_t attachment_idx);
+        MATCH_API vk::ImageView get_attachment_image_view(uint32_t attachment_idx);
     public:
         MATCH_API void set_clear_value(const std::string &name, const vk::ClearValue &value);
         MATCH_API vk::CommandBuffer get_command_buffer();
@@ -85,6 +120,7 @@ namespace Match {
         MATCH_API void update_resources();
         MATCH_API void update_renderpass();
     INNER_VISIBLE:
+        RenderingMode mode;
         std::shared_ptr<RenderPassBuilder> render_pass_builder;
         std::unique_ptr<RenderPass> render_pass;
         std::unique_ptr<FrameBufferSet> framebuffer_set;
@@ -97,11 +133,25 @@ namespace Match {
         uint32_t current_in_flight;
         uint32_t current_subpass;
         vk::CommandBuffer current_buffer;
+        std::vector<vk::ImageLayout> attachment_layouts;
+        bool viewport_set;
+        bool scissor_set;
         std::vector<vk::CommandBuffer> command_buffers;
         std::vector<vk::Semaphore> image_available_semaphores;
         std::vector<vk::Semaphore> render_finished_semaphores;
         std::vector<vk::Fence> in_flight_fences;
         std::vector<std::vector<vk::SubmitInfo>> in_flight_submit_infos;
+        std::unique_ptr<CommandPool> compute_command_pool;
+        std::vector<vk::CommandBuffer> compute_command_buffers;
+        std::vector<vk::Semaphore> compute_finished_semaphores;
+        std::vector<bool> compute_recorded;
+        bool in_async_compute;
+        bool frame_begun;
+        vk::PipelineStageFlags compute_wait_stage;
+        vk::QueryPool timestamp_query_pool;
+        bool compute_timestamp_supported;
+        float timestamp_period;
+        AsyncComputeTiming async_compute_timing;
     private:
         std::shared_ptr<GraphicsShaderProgram> current_graphics_shader_program;
         std::shared_ptr<RayTracingShaderProgram> current_ray_tracing_shader_program;
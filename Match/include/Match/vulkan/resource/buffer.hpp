@@ -2,9 +2,11 @@
 
 #include <Match/vulkan/commons.hpp>
 #include <Match/vulkan/descriptor_resource/storage_buffer.hpp>
+#include <Match/vulkan/defragmenter.hpp>
+#include <mutex>
 
 namespace Match {
-    class Buffer : public StorageBuffer {
+    class Buffer : public StorageBuffer, public Defragmentable {
         no_copy_construction(Buffer);
     public:
         MATCH_API Buffer(uint64_t size, vk::BufferUsageFlags buffer_usage, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags);
@@ -12,17 +14,47 @@ namespace Match {
         MATCH_API void *map();
         MATCH_API bool is_mapped();
         MATCH_API void unmap();
+        MATCH_API void flush(uint64_t offset = 0, uint64_t size = VK_WHOLE_SIZE);
+        MATCH_API void invalidate(uint64_t offset = 0, uint64_t size = VK_WHOLE_SIZE);
+        bool is_persistent_mapped() const { return persistent_mapped; }
+        bool is_coherent() const { return coherent; }
+        void pin() { pinned = true; }
+        void unpin() { pinned = false; }
         MATCH_API ~Buffer();
         vk::Buffer get_buffer(uint32_t in_flight_num) override { return buffer; }
         uint64_t get_size() override { return size; }
+    INNER_VISIBLE:
+        MATCH_API bool is_movable() override;
+        MATCH_API void begin_move(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) override;
+        MATCH_API void end_move() override;
     INNER_VISIBLE:
         uint64_t size;
         bool mapped;
+        bool persistent_mapped;
+        bool coherent;
+        bool pinned;
+        // 只有显存中的缓冲会被碎片整理移动, 这些缓冲额外带有拷贝需要的用途
+        bool defragmentable;
+        std::mutex map_mutex;
         void *data_ptr;
+        vk::BufferUsageFlags usage;
         vk::Buffer buffer;
+        vk::Buffer moving_buffer;
         VmaAllocation buffer_allocation;
     };
 
+    class ReadbackBuffer : public Buffer {
+        no_copy_move_construction(ReadbackBuffer)
+    public:
+        MATCH_API ReadbackBuffer(uint64_t size, vk::BufferUsageFlags additional_usage = {});
+        MATCH_API const void *read(uint64_t offset = 0, uint64_t size = VK_WHOLE_SIZE);
+        template <class Type>
+        std::vector<Type> read_to_vector(uint32_t offset_count, uint32_t count) {
+            auto *ptr = static_cast<const Type *>(read(offset_count * sizeof(Type), count * sizeof(Type)));
+            return std::vector<Type>(ptr, ptr + count);
+        }
+    };
+
     class InFlightBuffer : public StorageBuffer {
         no_copy_construction(InFlightBuffer);
     public:
@@ -39,40 +71,73 @@ namespace Match {
     class TwoStageBuffer : public StorageBuffer {
         no_copy_move_construction(TwoStageBuffer)
     public:
-        MATCH_API TwoStageBuffer(uint64_t size, vk::BufferUsageFlags usage, vk::BufferUsageFlags additional_usage = {});
+        constexpr static uint64_t update_buffer_threshold = 4096;
+    public:
+        MATCH_API TwoStageBuffer(uint64_t size, vk::BufferUsageFlags usage, vk::BufferUsageFlags additional_usage = {}, BufferUploadMode mode = BufferUploadMode::eDynamic);
+        // 静态模式下映射整个缓冲需要一块同样大小的暂存缓冲, 大缓冲应使用map_range或write分块上传
+        // 静态模式下映射后第一次flush拷贝整个缓冲, 之后只拷贝mark_dirty标记的区间
         MATCH_API void *map();
+        MATCH_API void *map_range(uint64_t offset, uint64_t size);
+        MATCH_API void write(uint64_t offset, const void *data, uint64_t size, bool flush_now = true);
+        MATCH_API void mark_dirty(uint64_t offset, uint64_t size);
         MATCH_API void flush();
         MATCH_API void unmap();
         template <class Type>
-        uint32_t upload_data_from_vector(const std::vector<Type> &data, uint32_t offset_count = 0) {
-            auto mapped = staging->is_mapped();
-            auto *ptr = static_cast<uint8_t *>(staging->map());
-            memcpy(ptr + (offset_count * sizeof(Type)), data.data(), data.size() * sizeof(Type));
-            flush();
-            if (!mapped) {
-                staging->unmap();
-            }
+        uint32_t upload_data_from_vector(const std::vector<Type> &data, uint32_t offset_count = 0, bool flush_now = true) {
+            write(offset_count * sizeof(Type), data.data(), data.size() * sizeof(Type), flush_now);
             return offset_count + data.size();
         }
         MATCH_API ~TwoStageBuffer();
         vk::Buffer get_buffer(uint32_t in_flight_num) override { return buffer->get_buffer(in_flight_num); }
         uint64_t get_size() override { return buffer->get_size(); }
     INNER_VISIBLE:
+        MATCH_API uint8_t *reserve_staging(uint64_t offset, uint64_t size);
+        MATCH_API void release_staging();
+    INNER_VISIBLE:
+        BufferUploadMode mode;
         std::unique_ptr<Buffer> staging;
         std::unique_ptr<Buffer> buffer;
+        bool whole_mapped;
+        // 静态模式下整个映射后还没有拷贝过
+        bool whole_dirty;
+        uint64_t staging_used;
+        std::vector<std::pair<uint64_t, uint64_t>> dirty_ranges;
+        std::vector<vk::BufferCopy> pending_copies;
     };
 
     class VertexBuffer : public TwoStageBuffer {
         no_copy_move_construction(VertexBuffer)
     public:
-        MATCH_API VertexBuffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage);
+        MATCH_API VertexBuffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode = BufferUploadMode::eDynamic);
     };
 
     class IndexBuffer : public TwoStageBuffer {
         no_copy_move_construction(IndexBuffer)
     public:
-        MATCH_API IndexBuffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage);
+        MATCH_API IndexBuffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode = BufferUploadMode::eDynamic);
     INNER_VISIBLE:
         vk::IndexType type;
     };
+
+    class IndirectBuffer : public TwoStageBuffer {
+        no_copy_move_construction(IndirectBuffer)
+    public:
+        MATCH_API IndirectBuffer(IndirectCommandType type, uint32_t max_draw_count, vk::BufferUsageFlags additional_usage = {}, BufferUploadMode mode = BufferUploadMode::eDynamic);
+        template <class CommandType>
+        uint32_t upload_commands(const std::vector<CommandType> &commands, uint32_t offset_count = 0, bool flush_now = true) {
+            static_assert(std::is_same_v<CommandType, vk::DrawIndirectCommand> || std::is_same_v<CommandType, vk::DrawIndexedIndirectCommand> || std::is_same_v<CommandType, vk::DispatchIndirectCommand>);
+            auto end = upload_data_from_vector(commands, offset_count, flush_now);
+            draw_count = std::max(draw_count, end);
+            return end;
+        }
+        void set_draw_count(uint32_t count) { draw_count = count; }
+        uint32_t get_draw_count() const { return draw_count; }
+        uint32_t get_max_draw_count() const { return max_draw_count; }
+        uint32_t get_stride() const { return stride; }
+    INNER_VISIBLE:
+        IndirectCommandType type;
+        uint32_t stride;
+        uint32_t max_draw_count;
+        uint32_t draw_count;
+    };
 }
@@ -57,7 +57,7 @@ namespace Match {
                     return stage_vector_ptr->size();
                 },
                 .create_buffer_callback = [](uint32_t count) {
-                    return std::make_shared<Buffer>(count * sizeof(type_t), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+                    return std::make_shared<Buffer>(count * sizeof(type_t), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
                 },
                 .destroy_stage_vector_callback = [](void *ptr) {
                     auto *stage_vector_ptr = static_cast<vector_t *>(ptr);
@@ -106,12 +106,13 @@ namespace Match {
             for (auto &[group_id, group_info] : groups) {
                 for (auto &[class_hash_code, ptr] : group_info.custom_data_stage_vector_ptr_map) {
                     auto &wrapper = custom_data_wrapper_map.at(class_hash_code);
+                    auto &buffer = custom_data_buffer_map.at(class_hash_code);
                     memcpy(
-                        static_cast<uint8_t *>(custom_data_buffer_map.at(class_hash_code)->map()) + wrapper.size * group_info.offset,
+                        static_cast<uint8_t *>(buffer->map()) + wrapper.size * group_info.offset,
                         wrapper.get_stage_vector_data_ptr_callback(ptr),
                         wrapper.get_stage_vector_size_callback(ptr) * wrapper.size
                     );
-                    custom_data_buffer_map.at(class_hash_code)->unmap();
+                    buffer->flush(wrapper.size * group_info.offset, wrapper.get_stage_vector_size_callback(ptr) * wrapper.size);
                 }
             }
 
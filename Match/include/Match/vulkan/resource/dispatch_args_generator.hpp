@@ -0,0 +1,23 @@
+#pragma once
+
+#include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/resource/shader_program.hpp>
+#include <Match/vulkan/resource/push_constants.hpp>
+#include <Match/vulkan/descriptor_resource/descriptor_set.hpp>
+
+namespace Match {
+    // 读取前一个计算Pass写入count_buffer的数量, 生成dispatch_indirect使用的参数, 不需要回读到CPU
+    // args_buffer需要使用IndirectCommandType::eDispatch创建, 并附加eStorageBuffer用途
+    class DispatchArgsGenerator {
+        no_copy_move_construction(DispatchArgsGenerator)
+    public:
+        MATCH_API DispatchArgsGenerator(std::shared_ptr<StorageBuffer> count_buffer, std::shared_ptr<IndirectBuffer> args_buffer, uint32_t group_size);
+        MATCH_API void generate(Renderer &renderer, uint32_t count_index = 0, uint32_t args_index = 0);
+        MATCH_API ~DispatchArgsGenerator();
+    INNER_VISIBLE:
+        uint32_t group_size;
+        std::shared_ptr<DescriptorSet> descriptor_set;
+        std::shared_ptr<PushConstants> push_constants;
+        std::shared_ptr<ComputeShaderProgram> shader_program;
+    };
+}
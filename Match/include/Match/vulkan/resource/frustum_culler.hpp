@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Match/vulkan/resource/model.hpp>
+#include <Match/vulkan/resource/gltf_scene.hpp>
+#include <array>
+
+namespace Match {
+    struct FrustumCullingStats {
+        uint32_t object_count = 0;
+        uint32_t visible_count = 0;
+        uint32_t culled_count = 0;
+        uint32_t updated_count = 0;
+        float update_time = 0;
+        float cull_time = 0;
+    };
+
+    // CPU视锥剔除, 包围盒与变换按SoA布局保存, 每次迭代用SIMD处理多个物体
+    // 物体移动后只重新计算所在分组的世界空间包围盒(AABB), 剔除时用AABB与6个平面测试
+    class FrustumCuller {
+        no_copy_move_construction(FrustumCuller)
+        struct SoAVec3 {
+            std::vector<float> x, y, z;
+        };
+    public:
+        // 每个分组的物体数, 是所有SIMD宽度的整数倍
+        constexpr static uint32_t group_size = 8;
+    public:
+        MATCH_API FrustumCuller();
+        MATCH_API uint32_t add_object(const glm::vec3 &pos_min, const glm::vec3 &pos_max, const glm::mat4 &transform);
+        MATCH_API uint32_t add_object(std::shared_ptr<const Mesh> mesh, const glm::mat4 &transform);
+        MATCH_API uint32_t add_object(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform);
+        MATCH_API std::vector<uint32_t> add_model(std::shared_ptr<const Model> model, const glm::mat4 &transform);
+        MATCH_API void set_transform(uint32_t object_index, const glm::mat4 &transform);
+        MATCH_API void update_bounds();
+        MATCH_API void cull(const glm::mat4 &view_project);
+        bool is_visible(uint32_t object_index) const { return visibility[object_index] != 0; }
+        const std::vector<uint32_t> &get_visible_objects() const { return visible_objects; }
+        glm::vec3 get_world_center(uint32_t object_index) const { return { world_center.x[object_index], world_center.y[object_index], world_center.z[object_index] }; }
+        glm::vec3 get_world_extent(uint32_t object_index) const { return { world_extent.x[object_index], world_extent.y[object_index], world_extent.z[object_index] }; }
+        uint32_t get_object_count() const { return object_count; }
+        const FrustumCullingStats &get_stats() const { return stats; }
+        MATCH_API ~FrustumCuller();
+    INNER_VISIBLE:
+        MATCH_API void resize(uint32_t capacity);
+    INNER_VISIBLE:
+        uint32_t object_count;
+        SoAVec3 local_center;
+        SoAVec3 local_extent;
+        // 仿射变换矩阵的前3行, transforms[row * 4 + column]
+        std::array<std::vector<float>, 12> transforms;
+        SoAVec3 world_center;
+        SoAVec3 world_extent;
+        std::vector<uint8_t> group_dirty;
+        bool bounds_dirty;
+        std::vector<uint8_t> visibility;
+        std::vector<uint32_t> visible_objects;
+        FrustumCullingStats stats;
+    };
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Match/vulkan/resource/gltf_scene.hpp>
+
+namespace Match {
+    struct GLTFAnimatorStats {
+        uint32_t instance_count = 0;
+        uint32_t track_count = 0;
+        uint32_t lane_count = 0;
+        float evaluate_time = 0;
+    };
+
+    // 同一个动画的多个播放实例, 每个实例拥有独立的时间和节点TRS
+    // 关键帧按轨道连续存放, 每个实例缓存每条轨道上一次的关键帧, 顺序播放时查找为均摊O(1)
+    // 求值时将一批实例的所有轨道展开为SoA的通道, 线性插值和三次样条统一为4项加权和后用SIMD计算
+    class GLTFAnimator {
+        no_copy_move_construction(GLTFAnimator)
+        struct Track {
+            uint32_t node;
+            GLTFAnimationPath path;
+            GLTFInterpolation interpolation;
+            uint32_t key_offset;
+            uint32_t key_count;
+            uint32_t value_offset;
+            // 每个关键帧元素的float数, 变形目标权重按分量拆成多条轨道
+            uint32_t stride;
+            uint32_t component_offset;
+            uint32_t cache_index;
+        };
+    INNER_VISIBLE:
+        // 每个线程一份, 通道数按SIMD宽度对齐
+        struct EvaluateScratch {
+            std::vector<float> coefficients[4];
+            std::vector<float> values[4][4];
+            std::vector<float> results[4];
+        };
+    public:
+        // 每个任务处理的实例数
+        constexpr static uint32_t instance_batch_size = 64;
+    public:
+        // 在共享线程池中求值, thread_count为0时使用线程池的全部线程
+        MATCH_API GLTFAnimator(std::shared_ptr<GLTFScene> scene, uint32_t animation_index, uint32_t thread_count = 0);
+        MATCH_API uint32_t add_instance(float time = 0);
+        MATCH_API void set_time(uint32_t instance_index, float time);
+        MATCH_API void advance(float delta_time);
+        MATCH_API void evaluate();
+        // 将实例的姿态写入GLTFScene的节点TRS和变形目标权重
+        MATCH_API void apply_to_scene(uint32_t instance_index);
+        float get_time(uint32_t instance_index) const { return times[instance_index]; }
+        const glm::vec3 &get_translation(uint32_t instance_index, uint32_t node_index) const { return translations[instance_index * node_count + node_index]; }
+        const glm::quat &get_rotation(uint32_t instance_index, uint32_t node_index) const { return rotations[instance_index * node_count + node_index]; }
+        const glm::vec3 &get_scale(uint32_t instance_index, uint32_t node_index) const { return scales[instance_index * node_count + node_index]; }
+        const float *get_weights(uint32_t instance_index, uint32_t node_index) const { return &weights[instance_index * weight_count + weight_offsets[node_index]]; }
+        uint32_t get_instance_count() const { return times.size(); }
+        const GLTFAnimatorStats &get_stats() const { return stats; }
+        MATCH_API static const char *get_simd_name();
+        MATCH_API ~GLTFAnimator();
+    INNER_VISIBLE:
+        MATCH_API uint32_t find_key(const Track &track, float time, uint32_t &cached_key) const;
+        template <uint32_t component_count>
+        void evaluate_tracks(const std::vector<Track> &tracks, uint32_t instance_begin, uint32_t instance_end, EvaluateScratch &scratch);
+        MATCH_API void evaluate_instances(uint32_t instance_begin, uint32_t instance_end, EvaluateScratch &scratch);
+    INNER_VISIBLE:
+        std::shared_ptr<GLTFScene> scene;
+        uint32_t thread_count;
+        float start_time;
+        float duration;
+
+        std::vector<float> key_times;
+        std::vector<float> key_values;
+        // 平移和缩放, 旋转, 变形目标权重分别按3, 4, 1个分量求值
+        std::vector<Track> vec3_tracks;
+        std::vector<Track> quat_tracks;
+        std::vector<Track> scalar_tracks;
+        uint32_t track_count;
+
+        uint32_t node_count;
+        uint32_t weight_count;
+        std::vector<uint32_t> weight_offsets;
+        std::vector<float> times;
+        std::vector<uint32_t> cached_keys;
+        std::vector<glm::vec3> translations;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+        std::vector<float> weights;
+
+        std::vector<EvaluateScratch> thread_scratches;
+        GLTFAnimatorStats stats;
+    };
+}
@@ -3,13 +3,16 @@
 #include <Match/vulkan/descriptor_resource/texture.hpp>
 #include <Match/vulkan/resource/sampler.hpp>
 #include <Match/vulkan/resource/model.hpp>
+#include <Match/vulkan/resource/buffer.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <tiny_gltf.h>
 
 namespace Match {
     class GLTFScene;
     class GLTFMesh;
+    class GLTFNode;
     class DescriptorSet;
+    class MappedFile;
 
     struct GLTFPrimitiveInstanceData {
         uint32_t first_index { 0 };
@@ -20,13 +23,17 @@ namespace Match {
     class GLTFPrimitive final : public RayTracingModel {
         no_copy_move_construction(GLTFPrimitive)
     public:
-        MATCH_API GLTFPrimitive(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive, const std::vector<std::string> &load_attributes);
+        // 只读取数量和包围盒, 顶点数据在GLTFScene分配好偏移后由load_data写入
+        MATCH_API GLTFPrimitive(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive);
         MATCH_API ~GLTFPrimitive();
         GLTFPrimitiveInstanceData get_primitive_instance_data() {
             return primitive_instance_data;
         }
 
         RayTracingModelType get_ray_tracing_model_type() override { return RayTracingModel::RayTracingModelType::eGLTFPrimitive; }
+    INNER_VISIBLE:
+        // 不同图元写入GLTFScene中互不重叠的区间, 可以在多个线程中同时调用
+        MATCH_API void load_data(const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive, const std::vector<std::string> &load_attributes, const std::vector<uint8_t *> &attribute_ptrs, const std::vector<uint64_t> &attribute_offsets);
     INNER_VISIBLE:
         GLTFPrimitiveInstanceData primitive_instance_data {};
         uint32_t index_count { 0 };
@@ -35,16 +42,24 @@ namespace Match {
 
         glm::vec3 pos_min { 0 };
         glm::vec3 pos_max { 0 };
+
+        // 蒙皮属性(JOINTS_0, WEIGHTS_0)在GLTFScene::skin_joints和skin_weights中的偏移, 没有蒙皮属性时为-1
+        int32_t skin_vertex_offset { -1 };
+        // 变形目标的位置偏移在GLTFScene::morph_deltas中按[目标][顶点]排列
+        uint32_t morph_delta_offset { 0 };
+        uint32_t morph_target_count { 0 };
     };
 
     class GLTFMesh {
         no_copy_move_construction(GLTFMesh)
     public:
-        MATCH_API GLTFMesh(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Mesh &gltf_mesh, const std::vector<std::string> &load_attributes);
+        MATCH_API GLTFMesh(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Mesh &gltf_mesh);
         MATCH_API ~GLTFMesh();
     INNER_VISIBLE:
         std::string name {};
         std::vector<std::shared_ptr<GLTFPrimitive>> primitives {};
+        // 变形目标的默认权重
+        std::vector<float> weights {};
     };
 
     class GLTFNode {
@@ -53,19 +68,90 @@ namespace Match {
         MATCH_API GLTFNode(GLTFScene &scene, const tinygltf::Model &gltf_model, uint32_t gltf_node_index, GLTFNode *parent);
         MATCH_API ~GLTFNode();
 
+        // 变换保存在GLTFScene的扁平数组中, 世界矩阵带缓存, 读取为O(1)
         MATCH_API glm::mat4 get_local_matrix();
         MATCH_API glm::mat4 get_world_matrix();
+        MATCH_API void set_translation(const glm::vec3 &translation);
+        MATCH_API void set_rotation(const glm::quat &rotation);
+        MATCH_API void set_scale(const glm::vec3 &scale);
+        uint32_t get_index() const { return index; }
+        // 节点的实例在GLTFScene实例数组中的区间, 带网格但没有EXT_mesh_gpu_instancing的节点只有一个实例
+        uint32_t get_first_instance() const { return first_instance; }
+        uint32_t get_instance_count() const { return instance_count; }
     INNER_VISIBLE:
         std::string name {};
         std::shared_ptr<GLTFMesh> mesh { nullptr };
+        uint32_t first_instance { 0 };
+        uint32_t instance_count { 0 };
 
+        GLTFScene &scene;
+        uint32_t index { 0 };
+        int32_t skin { -1 };
         GLTFNode *parent {};
         std::vector<std::shared_ptr<GLTFNode>> children {};
+    };
+
+    struct GLTFSkin {
+        std::string name {};
+        // 关节在GLTFScene中的节点序号
+        std::vector<uint32_t> joints {};
+        std::vector<glm::mat4> inverse_bind_matrices {};
+    };
+
+    enum class GLTFAnimationPath {
+        eTranslation,
+        eRotation,
+        eScale,
+        eWeights,
+    };
+
+    enum class GLTFInterpolation {
+        eLinear,
+        eStep,
+        eCubicSpline,
+    };
+
+    struct GLTFAnimationSampler {
+        GLTFInterpolation interpolation { GLTFInterpolation::eLinear };
+        std::vector<float> inputs {};
+        // 每个关键帧component_count个float, 三次样条插值时每个关键帧依次为入切线, 值, 出切线
+        std::vector<float> outputs {};
+        uint32_t component_count { 0 };
+    };
+
+    struct GLTFAnimationChannel {
+        uint32_t sampler { 0 };
+        uint32_t node { 0 };
+        GLTFAnimationPath path { GLTFAnimationPath::eTranslation };
+    };
+
+    struct GLTFAnimation {
+        std::string name {};
+        std::vector<GLTFAnimationSampler> samplers {};
+        std::vector<GLTFAnimationChannel> channels {};
+        float start_time { 0 };
+        float end_time { 0 };
+    };
+
+    // 带蒙皮的节点或带变形目标的图元, 由GLTFSkinner在计算着色器中变形后写入GLTFScene的变形顶点缓冲
+    // 每个实例拥有独立的BLAS, 光线追踪时替换原来的图元, 变形后的顶点在节点的局部空间中
+    class GLTFDeformedPrimitive final : public RayTracingModel {
+        no_copy_move_construction(GLTFDeformedPrimitive)
+    public:
+        MATCH_API GLTFDeformedPrimitive(GLTFNode *node, std::shared_ptr<GLTFPrimitive> primitive, uint32_t deformed_vertex_offset);
+        MATCH_API ~GLTFDeformedPrimitive();
+        GLTFNode *get_node() { return node; }
+        std::shared_ptr<GLTFPrimitive> get_primitive() { return primitive; }
+        uint32_t get_deformed_vertex_offset() const { return deformed_vertex_offset; }
 
-        glm::quat rotation { 0, 0, 0, 0 };
-        glm::vec3 scale { 1 };
-        glm::vec3 translation { 0 };
-        glm::mat4 matrix { 1 };
+        RayTracingModelType get_ray_tracing_model_type() override { return RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive; }
+    INNER_VISIBLE:
+        GLTFNode *node;
+        std::shared_ptr<GLTFPrimitive> primitive;
+        uint32_t deformed_vertex_offset;
+        uint32_t joint_matrix_offset { 0 };
+        uint32_t joint_count { 0 };
+        uint32_t morph_weight_offset { 0 };
     };
 
     struct GLTFMaterial {
@@ -79,37 +165,162 @@ namespace Match {
         int metallic_roughness_texture { -1 };
     };
 
+    // 属性缓冲和材质缓冲的存放位置
+    enum class GLTFBufferLocation {
+        // 通过暂存缓冲上传到显存, 光追着色器读取最快, 修改材质时需要经过暂存缓冲拷贝
+        eDeviceLocal,
+        // 主机可见的内存, 适合每帧修改材质, 着色器读取时需要经过PCIe
+        eHostVisible,
+    };
+
+    struct GLTFLoadStats {
+        uint32_t thread_count = 0;
+        uint32_t image_count = 0;
+        uint32_t primitive_count = 0;
+        uint32_t vertex_count = 0;
+        uint32_t index_count = 0;
+        float parse_time = 0;
+        float image_time = 0;
+        float primitive_time = 0;
+        float total_time = 0;
+    };
+
     class GLTFScene final : public RayTracingScene {
         no_copy_move_construction(GLTFScene)
+        struct PrimitiveReference {
+            GLTFNode *node;
+            std::shared_ptr<GLTFPrimitive> primitive;
+            std::shared_ptr<GLTFDeformedPrimitive> deformed_primitive;
+        };
+    INNER_VISIBLE:
+        struct PrimitiveLoadTask {
+            GLTFPrimitive *primitive;
+            const tinygltf::Primitive *gltf_primitive;
+            std::vector<uint64_t> attribute_offsets;
+        };
     public:
-        MATCH_API GLTFScene(const std::string &filename, const std::vector<std::string> &load_attributes);
+        // 图片解码和图元数据读取分到thread_count个线程中, 为0时使用硬件线程数
+        MATCH_API GLTFScene(const std::string &filename, const std::vector<std::string> &load_attributes, uint32_t thread_count = 0, GLTFBufferLocation buffer_location = GLTFBufferLocation::eDeviceLocal);
         MATCH_API ~GLTFScene();
         uint32_t get_textures_count() { return textures.size(); };
         MATCH_API void bind_textures(std::shared_ptr<DescriptorSet> descriptor_set, uint32_t binding);
-        std::shared_ptr<Buffer> get_materials_buffer() { return material_buffer; }
-        std::shared_ptr<Buffer> get_attribute_buffer(const std::string &attribute_name) { return attribute_buffer.at(attribute_name); }
+        std::shared_ptr<StorageBuffer> get_materials_buffer() { return material_buffer; }
+        std::shared_ptr<StorageBuffer> get_attribute_buffer(const std::string &attribute_name) { return attribute_buffer.at(attribute_name); }
+        GLTFBufferLocation get_buffer_location() const { return buffer_location; }
+        uint32_t get_material_count() const { return materials.size(); }
+        GLTFMaterial &get_material(uint32_t material_index) { return materials[material_index]; }
+        // 修改get_material返回的材质后调用, 将所有材质重新写入材质缓冲
+        MATCH_API void update_materials();
         MATCH_API void enumerate_primitives(std::function<void(GLTFNode *node, std::shared_ptr<GLTFPrimitive>)> func);
+        uint32_t get_node_count() const { return all_node_references.size(); }
+        GLTFNode *get_node(uint32_t node_index) { return all_node_references[node_index]; }
+        MATCH_API void set_node_translation(uint32_t node_index, const glm::vec3 &translation);
+        MATCH_API void set_node_rotation(uint32_t node_index, const glm::quat &rotation);
+        MATCH_API void set_node_scale(uint32_t node_index, const glm::vec3 &scale);
+        // 只重新计算局部变换改变过的节点所在的子树, 返回重新计算世界矩阵的节点数
+        MATCH_API uint32_t update_world_matrices();
+        MATCH_API const glm::mat4 &get_world_matrix(uint32_t node_index);
+        uint32_t get_animation_count() const { return animations.size(); }
+        const std::string &get_animation_name(uint32_t animation_index) const { return animations[animation_index].name; }
+        float get_animation_duration(uint32_t animation_index) const { return animations[animation_index].end_time - animations[animation_index].start_time; }
+        // 动画由GLTFAnimator求值, 再用GLTFAnimator::apply_to_scene写入节点
+        const std::vector<float> &get_node_weights(uint32_t node_index) const { return node_weights[node_index]; }
+        // 变形图元按节点上的图元创建, 不按实例创建: EXT_mesh_gpu_instancing的所有实例共用同一份变形结果, 姿态相同
+        uint32_t get_deformed_primitive_count() const { return deformed_primitives.size(); }
+        std::shared_ptr<VertexBuffer> get_deformed_vertex_buffer() { return deformed_vertex_buffer; }
+        // 开启光线追踪时有效, 碎片整理移动缓冲后自动更新
+        vk::DeviceAddress get_deformed_vertex_address() const { return deformed_vertex_address; }
+        MATCH_API void enumerate_deformed_primitives(std::function<void(GLTFNode *node, std::shared_ptr<GLTFDeformedPrimitive>)> func);
+        // 与enumerate_primitives相同, 节点上的图元被变形时model为对应的GLTFDeformedPrimitive
+        MATCH_API void enumerate_ray_tracing_models(std::function<void(GLTFNode *node, std::shared_ptr<GLTFPrimitive>, std::shared_ptr<RayTracingModel> model)> func);
+
+        // 每个实例的世界矩阵为节点的世界矩阵乘以实例的局部矩阵
+        uint32_t get_instance_count() const { return instance_matrices.size(); }
+        const glm::mat4 &get_instance_matrix(uint32_t instance_index) const { return instance_matrices[instance_index]; }
+        glm::mat4 get_instance_world_matrix(uint32_t instance_index) { return get_world_matrix(instance_nodes[instance_index]) * instance_matrices[instance_index]; }
+        // 按实例序号存放世界矩阵, 作为逐实例的顶点缓冲, 每个图元用节点的first_instance和instance_count做一次实例化绘制
+        std::shared_ptr<VertexBuffer> get_instance_transform_buffer() { return instance_transform_buffer; }
+        // 节点的变换改变后调用, 重新写入所有实例的世界矩阵
+        MATCH_API void update_instance_transforms();
+
+        const GLTFLoadStats &get_load_stats() const { return load_stats; }
 
         RayTracingSceneType get_ray_tracing_scene_type() override { return RayTracingSceneType::eGLTFScene; }
     private:
-        MATCH_API void load_images(const tinygltf::Model &gltf_model);
+        // 将GLB的二进制块留在映射的文件中, tinygltf只解析JSON, 不复制二进制块
+        MATCH_API bool load_mapped_glb(tinygltf::TinyGLTF &loader, tinygltf::Model &gltf_model, std::string &err, std::string &warn, const MappedFile &mapped_file, std::map<uint32_t, std::pair<const uint8_t *, uint64_t>> &mapped_images);
+        MATCH_API void load_images(const tinygltf::Model &gltf_model, const std::vector<std::pair<const uint8_t *, uint64_t>> &encoded_images, uint32_t thread_count);
+        MATCH_API void load_primitive_datas(const tinygltf::Model &gltf_model, const std::vector<std::string> &load_attributes, uint32_t thread_count);
         MATCH_API void load_materials(const tinygltf::Model &gltf_model);
+        MATCH_API void load_mesh_instances(const tinygltf::Model &gltf_model);
+        MATCH_API void load_skins(const tinygltf::Model &gltf_model);
+        MATCH_API void load_animations(const tinygltf::Model &gltf_model);
+        MATCH_API void create_deformed_primitives();
+        MATCH_API std::shared_ptr<StorageBuffer> create_storage_buffer(uint64_t size);
+        MATCH_API void *map_storage_buffer(std::shared_ptr<StorageBuffer> buffer);
+        MATCH_API void unmap_storage_buffer(std::shared_ptr<StorageBuffer> buffer);
+    INNER_VISIBLE:
+        // 只在构造时可用
+        const uint8_t *get_accessor_data(const tinygltf::Model &gltf_model, const tinygltf::Accessor &accessor) const {
+            const auto &buffer_view = gltf_model.bufferViews[accessor.bufferView];
+            return buffer_datas[buffer_view.buffer] + buffer_view.byteOffset + accessor.byteOffset;
+        }
     INNER_VISIBLE:
         std::string path;
+        GLTFBufferLocation buffer_location;
 
         std::shared_ptr<Sampler> sampler;
         std::vector<std::shared_ptr<Texture>> textures;
         std::vector<std::shared_ptr<GLTFMesh>> meshes;
         std::vector<std::shared_ptr<GLTFNode>> nodes;
+        // 按先序遍历展开的节点, 父节点在子节点之前, 每个子树在数组中是连续的[index, subtree_end)
         std::vector<GLTFNode *> all_node_references;
+        std::vector<int32_t> node_parents;
+        std::vector<uint32_t> node_subtree_ends;
+        std::vector<glm::vec3> node_translations;
+        std::vector<glm::quat> node_rotations;
+        std::vector<glm::vec3> node_scales;
+        std::vector<glm::mat4> node_matrices;
+        std::vector<glm::mat4> local_matrices;
+        std::vector<glm::mat4> world_matrices;
+        std::vector<uint8_t> node_dirty;
+        bool world_matrices_dirty { false };
+        // gltf节点序号到先序遍历序号的映射, 不在默认场景中的节点为-1
+        std::vector<int32_t> node_index_map;
+        std::vector<std::vector<float>> node_weights;
+        std::vector<PrimitiveReference> primitive_references;
+        // EXT_mesh_gpu_instancing的实例, 按节点的先序遍历顺序连续存放
+        std::vector<glm::mat4> instance_matrices;
+        std::vector<uint32_t> instance_nodes;
+        std::shared_ptr<VertexBuffer> instance_transform_buffer;
+        bool instance_transforms_dirty { false };
+
+        std::vector<GLTFSkin> skins;
+        std::vector<GLTFAnimation> animations;
+        std::vector<glm::uvec4> skin_joints;
+        std::vector<glm::vec4> skin_weights;
+        std::vector<glm::vec3> morph_deltas;
+        std::vector<std::shared_ptr<GLTFDeformedPrimitive>> deformed_primitives;
+        std::shared_ptr<VertexBuffer> deformed_vertex_buffer;
+        vk::DeviceAddress deformed_vertex_address { 0 };
+        std::optional<uint32_t> moved_callback_id;
+        uint32_t deformed_vertex_count { 0 };
+        uint32_t deformed_joint_count { 0 };
+        uint32_t deformed_morph_weight_count { 0 };
 
         std::vector<GLTFMaterial> materials;
-        std::shared_ptr<Buffer> material_buffer;
-        std::map<std::string, std::vector<uint8_t>> attribute_datas;
-        std::map<std::string, std::shared_ptr<Buffer>> attribute_buffer;
+        // eDeviceLocal时为静态模式的TwoStageBuffer, eHostVisible时为Buffer
+        std::shared_ptr<StorageBuffer> material_buffer;
+        std::map<std::string, std::shared_ptr<StorageBuffer>> attribute_buffer;
 
         std::vector<glm::vec3> positions;
         std::vector<uint32_t> indices;
+
+        // 只在构造时使用, 按图元创建顺序排列
+        std::vector<PrimitiveLoadTask> primitive_load_tasks;
+        // 只在构造时使用, 每个buffer的数据地址, 映射GLB时指向文件中的二进制块
+        std::vector<const uint8_t *> buffer_datas;
+        GLTFLoadStats load_stats;
     INNER_VISIBLE:
         // using by ray_tracing_acceration_structure
         std::unique_ptr<Buffer> vertex_buffer;
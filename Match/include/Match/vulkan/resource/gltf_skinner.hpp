@@ -0,0 +1,49 @@
+#pragma once
+
+#include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/resource/shader_program.hpp>
+#include <Match/vulkan/resource/push_constants.hpp>
+#include <Match/vulkan/resource/gltf_scene.hpp>
+#include <Match/vulkan/descriptor_resource/descriptor_set.hpp>
+
+namespace Match {
+    struct GLTFSkinningStats {
+        uint32_t deformed_primitive_count = 0;
+        uint32_t deformed_vertex_count = 0;
+        uint32_t joint_count = 0;
+        uint32_t refit_count = 0;
+        float upload_time = 0;
+    };
+
+    // 在计算着色器中对GLTFScene中带蒙皮或变形目标的图元做变形, 结果写入GLTFScene::get_deformed_vertex_buffer()
+    // 每一帧先用GLTFAnimator::apply_to_scene更新节点, 再在渲染Pass之外调用skin录制变形命令
+    // 场景的BLAS已经由AccelerationStructureBuilder构建时, 同时在命令缓冲中用eUpdate重新拟合变形图元的BLAS, 之后需调用RayTracingInstanceCollect::refit更新TLAS
+    class GLTFSkinner {
+        no_copy_move_construction(GLTFSkinner)
+    public:
+        constexpr static uint32_t group_size = 64;
+    public:
+        MATCH_API GLTFSkinner(std::shared_ptr<GLTFScene> scene);
+        MATCH_API void skin(Renderer &renderer);
+        const GLTFSkinningStats &get_stats() const { return stats; }
+        MATCH_API ~GLTFSkinner();
+    INNER_VISIBLE:
+        MATCH_API void upload_deform_data();
+        MATCH_API void refit_acceleration_structures(Renderer &renderer);
+    INNER_VISIBLE:
+        std::shared_ptr<GLTFScene> scene;
+        std::shared_ptr<TwoStageBuffer> position_buffer;
+        std::shared_ptr<TwoStageBuffer> joint_buffer;
+        std::shared_ptr<TwoStageBuffer> weight_buffer;
+        std::shared_ptr<TwoStageBuffer> morph_delta_buffer;
+        std::shared_ptr<InFlightBuffer> joint_matrix_buffer;
+        std::shared_ptr<InFlightBuffer> morph_weight_buffer;
+        std::shared_ptr<DescriptorSet> descriptor_set;
+        std::shared_ptr<PushConstants> push_constants;
+        std::shared_ptr<ComputeShaderProgram> shader_program;
+        // 每个BLAS使用独立的一段scratch, 所有BLAS在一次调用中更新
+        std::unique_ptr<Buffer> scratch_buffer;
+        std::vector<uint64_t> scratch_offsets;
+        GLTFSkinningStats stats;
+    };
+}
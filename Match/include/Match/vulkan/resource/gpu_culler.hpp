@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/resource/shader_program.hpp>
+#include <Match/vulkan/resource/push_constants.hpp>
+#include <Match/vulkan/resource/gltf_scene.hpp>
+#include <Match/vulkan/resource/hi_z_pyramid.hpp>
+#include <Match/vulkan/descriptor_resource/descriptor_set.hpp>
+
+namespace Match {
+    // 与剔除着色器中的std430布局一致
+    struct CullingDrawInfo {
+        glm::vec3 pos_min;
+        uint32_t index_count;
+        glm::vec3 pos_max;
+        uint32_t first_index;
+        int32_t vertex_offset;
+        uint32_t padding[3];
+    };
+
+    struct CullingInstanceInfo {
+        glm::mat4 transform;
+        uint32_t draw_index;
+        uint32_t instance_id;
+        uint32_t padding[2];
+    };
+
+    struct CullingStats {
+        uint32_t instance_count = 0;
+        uint32_t visible_count = 0;
+        uint32_t culled_count = 0;
+        uint32_t occluded_count = 0;
+        float gpu_time = 0;
+    };
+
+    // GPU视锥剔除, 将可见的实例压缩写入IndirectBuffer, 由draw_indexed_indirect_count绘制
+    // 每个可见实例生成一条instanceCount为1的绘制命令, firstInstance为instance_id, 可以用于读取逐实例的顶点数据
+    // 开启遮挡剔除后分为两个阶段:
+    //   cull + draw: 绘制上一帧可见的实例
+    //   cull_late + draw_late: 用已绘制的深度生成Hi-Z, 测试其余实例并绘制新出现的实例, 同时更新可见性
+    class GPUCuller {
+        no_copy_move_construction(GPUCuller)
+    public:
+        constexpr static uint32_t group_size = 64;
+    public:
+        MATCH_API GPUCuller(uint32_t max_draw_count, uint32_t max_instance_count);
+        MATCH_API uint32_t add_mesh(std::shared_ptr<const Mesh> mesh);
+        MATCH_API std::vector<uint32_t> add_model(std::shared_ptr<const Model> model);
+        MATCH_API uint32_t add_primitive(std::shared_ptr<GLTFPrimitive> primitive);
+        MATCH_API uint32_t add_instance(uint32_t draw_index, const glm::mat4 &transform, uint32_t instance_id = uint32_t(-1));
+        MATCH_API void set_instance_transform(uint32_t instance_index, const glm::mat4 &transform);
+        MATCH_API void enable_occlusion_culling(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name);
+        MATCH_API void cull(Renderer &renderer, const glm::mat4 &view_project);
+        MATCH_API void draw(Renderer &renderer);
+        MATCH_API void cull_late(Renderer &renderer);
+        MATCH_API void draw_late(Renderer &renderer);
+        bool is_occlusion_culling_enabled() const { return hi_z_pyramid.get() != nullptr; }
+        std::shared_ptr<IndirectBuffer> get_indirect_buffer() { return indirect_buffer; }
+        std::shared_ptr<IndirectBuffer> get_late_indirect_buffer() { return late_indirect_buffer; }
+        std::shared_ptr<Buffer> get_count_buffer() { return count_buffer; }
+        const CullingStats &get_stats() const { return stats; }
+        MATCH_API ~GPUCuller();
+    INNER_VISIBLE:
+        MATCH_API uint32_t add_draw(const CullingDrawInfo &draw_info);
+        MATCH_API std::shared_ptr<ComputeShaderProgram> create_culling_program(bool occlusion_culling, std::shared_ptr<DescriptorSet> descriptor_set);
+        MATCH_API void dispatch_culling(Renderer &renderer, std::shared_ptr<ComputeShaderProgram> program, uint32_t phase);
+        MATCH_API void upload(vk::CommandBuffer command_buffer);
+        MATCH_API void update_stats();
+    INNER_VISIBLE:
+        uint32_t max_draw_count;
+        uint32_t max_instance_count;
+        std::vector<CullingDrawInfo> draws;
+        std::vector<CullingInstanceInfo> instances;
+        bool draws_dirty;
+        bool instances_dirty;
+        std::shared_ptr<TwoStageBuffer> draw_buffer;
+        std::shared_ptr<TwoStageBuffer> instance_buffer;
+        std::unique_ptr<InFlightBuffer> instance_staging_buffer;
+        std::shared_ptr<IndirectBuffer> indirect_buffer;
+        std::shared_ptr<Buffer> count_buffer;
+        std::unique_ptr<ReadbackBuffer> count_readback_buffer;
+        std::shared_ptr<DescriptorSet> descriptor_set;
+        std::shared_ptr<PushConstants> push_constants;
+        std::shared_ptr<ComputeShaderProgram> shader_program;
+        std::shared_ptr<HiZPyramid> hi_z_pyramid;
+        std::shared_ptr<Sampler> hi_z_sampler;
+        std::shared_ptr<IndirectBuffer> late_indirect_buffer;
+        std::shared_ptr<TwoStageBuffer> visibility_buffer;
+        std::shared_ptr<DescriptorSet> occlusion_descriptor_set;
+        std::shared_ptr<ComputeShaderProgram> occlusion_shader_program;
+        std::weak_ptr<Renderer> occlusion_renderer;
+        std::optional<uint32_t> callback_id;
+        vk::QueryPool timestamp_query_pool;
+        float timestamp_period;
+        std::vector<bool> stats_recorded;
+        CullingStats stats;
+    };
+}
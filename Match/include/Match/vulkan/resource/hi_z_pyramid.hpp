@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/resource/image.hpp>
+#include <Match/vulkan/resource/sampler.hpp>
+#include <Match/vulkan/descriptor_resource/texture.hpp>
+
+namespace Match {
+    // 从RenderPassBuilder中的深度Attachment生成Hi-Z深度金字塔, 每一级保存覆盖范围内的最大深度
+    // 深度Attachment需要附加eSampled用途, 并且不能开启MSAA
+    class HiZPyramid : public Texture {
+        no_copy_move_construction(HiZPyramid)
+    public:
+        MATCH_API HiZPyramid(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name);
+        MATCH_API void build(Renderer &renderer);
+        uint32_t get_width() const { return width; }
+        uint32_t get_height() const { return height; }
+        vk::ImageLayout get_image_layout() override { return vk::ImageLayout::eGeneral; }
+        vk::ImageView get_image_view() override { return image_view; }
+        uint32_t get_mip_levels() override { return mip_levels; }
+        MATCH_API ~HiZPyramid();
+    INNER_VISIBLE:
+        MATCH_API void create_pyramid();
+        MATCH_API void destroy_pyramid();
+    INNER_VISIBLE:
+        std::weak_ptr<Renderer> renderer;
+        uint32_t depth_attachment_idx;
+        uint32_t callback_id;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_levels;
+        std::unique_ptr<Image> image;
+        vk::ImageView image_view;
+        std::vector<vk::ImageView> mip_views;
+        std::shared_ptr<Sampler> reduce_sampler;
+        vk::DescriptorPool descriptor_pool;
+        vk::DescriptorSetLayout descriptor_layout;
+        std::vector<vk::DescriptorSet> descriptor_sets;
+        vk::PipelineLayout pipeline_layout;
+        vk::Pipeline pipeline;
+    };
+}
@@ -1,14 +1,34 @@
 #pragma once
 
 #include <Match/vulkan/commons.hpp>
+#include <Match/vulkan/defragmenter.hpp>
+#include <optional>
 
 namespace Match {
-    class Image {
+    class Image : public Defragmentable {
         no_copy_move_construction(Image)
+        using ImageMovedCallback = std::function<void()>;
     public:
         MATCH_API Image(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags, uint32_t mip_levels = 1);
+        MATCH_API Image(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples);
+        MATCH_API vk::MemoryRequirements get_memory_requirements();
+        MATCH_API void bind_memory(VmaAllocation allocation);
+        void pin() { pinned = true; }
+        void unpin() { pinned = false; }
         MATCH_API ~Image();
     INNER_VISIBLE:
+        MATCH_API void fill_image_create_info(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples, uint32_t mip_levels);
+        MATCH_API void set_movable(vk::ImageLayout layout, const ImageMovedCallback &callback);
+        MATCH_API bool is_movable() override;
+        MATCH_API void begin_move(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) override;
+        MATCH_API void end_move() override;
+    INNER_VISIBLE:
+        vk::ImageCreateInfo image_create_info;
+        bool pinned;
+        bool owns_allocation;
+        std::optional<vk::ImageLayout> movable_layout;
+        ImageMovedCallback moved_callback;
+        vk::Image moving_image;
         vk::Image image;
         VmaAllocation allocation;
     };
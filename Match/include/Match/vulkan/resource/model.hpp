@@ -32,6 +32,8 @@ namespace Match {
     INNER_VISIBLE:
         BufferPosition position;
         std::vector<uint32_t> indices;
+        glm::vec3 pos_min { 0 };
+        glm::vec3 pos_max { 0 };
     };
 
     class RayTracingModel {
@@ -41,6 +43,7 @@ namespace Match {
             eModel,
             eSphereCollect,
             eGLTFPrimitive,
+            eGLTFDeformedPrimitive,
         };
     public:
         virtual RayTracingModelType get_ray_tracing_model_type() = 0;
@@ -10,13 +10,29 @@ namespace Match {
     class GLTFScene;
     class GLTFNode;
 
+    class AccelerationStructureArena {
+        no_copy_move_construction(AccelerationStructureArena)
+    public:
+        constexpr static uint64_t alignment = 256;
+        static uint64_t align(uint64_t size) { return (size + alignment - 1) & ~(alignment - 1); }
+    public:
+        MATCH_API AccelerationStructureArena(uint64_t size);
+        MATCH_API uint64_t allocate(uint64_t size);
+        MATCH_API ~AccelerationStructureArena();
+    INNER_VISIBLE:
+        std::unique_ptr<Buffer> buffer;
+        uint64_t size;
+        uint64_t used;
+    };
+
     class ModelAccelerationStructure {
         default_no_copy_move_construction(ModelAccelerationStructure);
     public:
         MATCH_API ~ModelAccelerationStructure();
     INNER_VISIBLE:
         vk::AccelerationStructureKHR bottom_level_acceleration_structure ;
-        std::unique_ptr<Buffer> acceleration_structure_buffer;
+        std::shared_ptr<AccelerationStructureArena> arena;
+        uint64_t arena_offset = 0;
     };
 
     class AccelerationStructureBuilder {
@@ -31,7 +47,6 @@ namespace Match {
             std::vector<vk::AccelerationStructureBuildRangeInfoKHR> ranges {};
             vk::AccelerationStructureBuildSizesInfoKHR size {};
             vk::AccelerationStructureKHR uncompacted_acceleration_structure {};
-            std::unique_ptr<Buffer> uncompacted_acceleration_structure_buffer {};
         };
     public:
         MATCH_API void add_model(std::shared_ptr<RayTracingModel> model);
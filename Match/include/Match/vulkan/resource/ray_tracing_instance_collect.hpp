@@ -7,6 +7,8 @@
 #include <Match/core/utils.hpp>
 
 namespace Match {
+    class Renderer;
+
     class RayTracingInstanceCollect {
         no_copy_move_construction(RayTracingInstanceCollect)
     INNER_VISIBLE:
@@ -44,12 +46,16 @@ namespace Match {
         MATCH_API RayTracingInstanceCollect &update(uint32_t group_id, UpdateCallback update_callback);
         template <class CustomInstanceData>
         RayTracingInstanceCollect &update(uint32_t group_id, UpdateCustomDataCallback<CustomInstanceData> update_callback);
+        // 实例不变, 只有BLAS被重新拟合(如GLTFSkinner)时, 在当前帧的命令缓冲中用eUpdate更新TLAS的包围盒
+        MATCH_API RayTracingInstanceCollect &refit(Renderer &renderer);
         MATCH_API ~RayTracingInstanceCollect();
     private:
         MATCH_API InstanceAddressData create_instance_address_data(RayTracingModel &model);
         MATCH_API bool check_model_suitable(RayTracingModel &model);
+        MATCH_API void update_instance_address_data();
     INNER_VISIBLE:
         bool allow_update;
+        uint32_t moved_callback_id;
 
         std::unique_ptr<CustomDataRegistrar<InstanceCreateInfo>> registrar;
         uint32_t instance_count;
@@ -92,8 +98,11 @@ namespace Match {
         switch(scene->get_ray_tracing_scene_type()) {
         case RayTracingScene::RayTracingSceneType::eGLTFScene:
             auto gltf_scene = std::dynamic_pointer_cast<GLTFScene>(scene);
-            gltf_scene->enumerate_primitives([&](auto *node, auto gltf_primitive) {
-                add_instance(group_id, gltf_primitive, node->get_world_matrix(), hit_group, gltf_primitive->get_primitive_instance_data(), std::forward<Args>(args)...);
+            // EXT_mesh_gpu_instancing的每个实例都是一个TLAS实例, 共用图元的BLAS
+            gltf_scene->enumerate_ray_tracing_models([&](auto *node, auto gltf_primitive, auto model) {
+                for (uint32_t i = 0; i < node->get_instance_count(); i ++) {
+                    add_instance(group_id, model, gltf_scene->get_instance_world_matrix(node->get_first_instance() + i), hit_group, gltf_primitive->get_primitive_instance_data(), args...);
+                }
             });
             return *this;
         }
@@ -12,6 +12,7 @@ namespace Match {
         uint32_t offset {};
         vk::ImageAspectFlags aspect {};
         vk::ClearValue clear_value {};
+        bool transient = false;
     };
 
     class RenderPassBuilder;
@@ -47,8 +48,12 @@ namespace Match {
     public:
         MATCH_API RenderPassBuilder();
         MATCH_API RenderPassBuilder &add_attachment(const std::string &name, AttachmentType type, vk::ImageUsageFlags additional_usage = {});
+        // 只在RenderPass内部使用的Attachment, 不保存内容, 可以使用延迟分配的内存或与其他Attachment共用显存
+        MATCH_API RenderPassBuilder &add_transient_attachment(const std::string &name, AttachmentType type, vk::ImageUsageFlags additional_usage = {});
         MATCH_API SubpassBuilder &add_subpass(const std::string &name);
         MATCH_API vk::RenderPassCreateInfo build();
+    private:
+        MATCH_API void analyze_attachments();
     INNER_VISIBLE:
         uint32_t get_attachment_index(const std::string &name, bool is_attachment_read) {
             auto idx = attachments_map.find(name);
@@ -81,5 +86,11 @@ namespace Match {
         std::vector<vk::AttachmentDescription> final_attachments;
         std::vector<vk::SubpassDescription> final_subpasses;
         std::vector<vk::SubpassDependency> final_dependencies;
+
+        bool lazily_allocated_memory_supported = false;
+        std::vector<vk::ImageUsageFlags> final_usages;
+        std::vector<vk::ImageAspectFlags> final_aspects;
+        std::vector<std::vector<uint32_t>> final_alias_groups;
+        std::vector<vk::SubpassDependency> built_dependencies;
     };
 };
@@ -3,6 +3,7 @@
 #include <Match/commons.hpp>
 #include <Match/vulkan/renderpass.hpp>
 #include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/render_graph.hpp>
 #include <Match/vulkan/resource/shader.hpp>
 #include <Match/vulkan/resource/vertex_attribute_set.hpp>
 #include <Match/vulkan/resource/push_constants.hpp>
@@ -15,6 +16,13 @@
 #include <Match/vulkan/descriptor_resource/texture.hpp>
 #include <Match/vulkan/resource/ray_tracing_instance_collect.hpp>
 #include <Match/vulkan/resource/volume_data.hpp>
+#include <Match/vulkan/resource/dispatch_args_generator.hpp>
+#include <Match/vulkan/resource/hi_z_pyramid.hpp>
+#include <Match/vulkan/resource/gpu_culler.hpp>
+#include <Match/vulkan/resource/software_occlusion_culler.hpp>
+#include <Match/vulkan/resource/frustum_culler.hpp>
+#include <Match/vulkan/resource/gltf_skinner.hpp>
+#include <Match/vulkan/resource/gltf_animator.hpp>
 
 namespace Match {
     class ResourceFactory {
@@ -22,29 +30,42 @@ namespace Match {
     public:
         MATCH_API ResourceFactory(const std::string &root);
         MATCH_API std::shared_ptr<RenderPassBuilder> create_render_pass_builder();
-        MATCH_API std::shared_ptr<Renderer> create_renderer(std::shared_ptr<RenderPassBuilder> builder);
+        MATCH_API std::shared_ptr<Renderer> create_renderer(std::shared_ptr<RenderPassBuilder> builder, RenderingMode mode = RenderingMode::eRenderPass);
+        MATCH_API std::shared_ptr<RenderGraph> create_render_graph(std::weak_ptr<Renderer> renderer);
         MATCH_API std::shared_ptr<Shader> load_shader(const std::string &filename);
         MATCH_API std::shared_ptr<Shader> compile_shader(const std::string &filename, ShaderStage stage);
         MATCH_API std::shared_ptr<Shader> compile_shader_from_string(const std::string &code, ShaderStage stage);
         MATCH_API std::shared_ptr<VertexAttributeSet> create_vertex_attribute_set(const std::vector<InputBindingInfo> &binding_infos);
         MATCH_API std::shared_ptr<GraphicsShaderProgram> create_shader_program(std::weak_ptr<Renderer> renderer, const std::string &subpass_name);
-        MATCH_API std::shared_ptr<VertexBuffer> create_vertex_buffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {});
-        MATCH_API std::shared_ptr<IndexBuffer> create_index_buffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {});
+        MATCH_API std::shared_ptr<VertexBuffer> create_vertex_buffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {}, BufferUploadMode mode = BufferUploadMode::eDynamic);
+        MATCH_API std::shared_ptr<IndexBuffer> create_index_buffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {}, BufferUploadMode mode = BufferUploadMode::eDynamic);
+        MATCH_API std::shared_ptr<IndirectBuffer> create_indirect_buffer(IndirectCommandType type, uint32_t max_draw_count, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {}, BufferUploadMode mode = BufferUploadMode::eDynamic);
+        // 非0的first_instance依赖设备启用的drawIndirectFirstInstance特性
+        MATCH_API std::shared_ptr<IndirectBuffer> create_indirect_buffer(std::shared_ptr<const Model> model, uint32_t instance_count = 1, uint32_t first_instance = 0);
+        MATCH_API std::shared_ptr<IndirectBuffer> create_indirect_buffer(std::shared_ptr<GLTFScene> scene);
         MATCH_API std::shared_ptr<DescriptorSet> create_descriptor_set(std::optional<std::weak_ptr<Renderer>> renderer = {});
         MATCH_API std::shared_ptr<PushConstants> create_push_constants(ShaderStages stages, const std::vector<PushConstantInfo> &infos);
         MATCH_API std::shared_ptr<UniformBuffer> create_uniform_buffer(uint64_t size, bool create_for_each_frame_in_flight = false);
-        MATCH_API std::shared_ptr<TwoStageBuffer> create_storage_buffer(uint64_t size);
+        MATCH_API std::shared_ptr<ReadbackBuffer> create_readback_buffer(uint64_t size, vk::BufferUsageFlags additional_usage = vk::BufferUsageFlags {});
+        MATCH_API std::shared_ptr<TwoStageBuffer> create_storage_buffer(uint64_t size, BufferUploadMode mode = BufferUploadMode::eDynamic);
         MATCH_API std::shared_ptr<StorageImage> create_storage_image(uint32_t width, uint32_t height, vk::Format format = vk::Format::eR8G8B8A8Snorm, bool sampled = true, bool enable_clear = false);
         MATCH_API std::shared_ptr<Sampler> create_sampler(const SamplerOptions &options = {});
         MATCH_API std::shared_ptr<Texture> load_texture(const std::string &filename, uint32_t mip_levels = 0);
         MATCH_API std::shared_ptr<Texture> create_texture(const uint8_t *data, uint32_t width, uint32_t height, uint32_t mip_levels = 0);
         MATCH_API std::shared_ptr<Model> load_model(const std::string &filename, const std::vector<std::string> &backlist = {});
         MATCH_API std::shared_ptr<SphereCollect> create_sphere_collect();
-        MATCH_API std::shared_ptr<GLTFScene> load_gltf_scene(const std::string &filename, const std::vector<std::string> &load_attributes = {});
+        MATCH_API std::shared_ptr<GLTFScene> load_gltf_scene(const std::string &filename, const std::vector<std::string> &load_attributes = {}, uint32_t thread_count = 0, GLTFBufferLocation buffer_location = GLTFBufferLocation::eDeviceLocal);
         MATCH_API std::shared_ptr<AccelerationStructureBuilder> create_acceleration_structure_builder();
         MATCH_API std::shared_ptr<RayTracingInstanceCollect> create_ray_tracing_instance_collect(bool allow_update = true);
         MATCH_API std::shared_ptr<RayTracingShaderProgram> create_ray_tracing_shader_program();
         MATCH_API std::shared_ptr<ComputeShaderProgram> create_compute_shader_program();
+        MATCH_API std::shared_ptr<DispatchArgsGenerator> create_dispatch_args_generator(std::shared_ptr<StorageBuffer> count_buffer, std::shared_ptr<IndirectBuffer> args_buffer, uint32_t group_size);
+        MATCH_API std::shared_ptr<GPUCuller> create_gpu_culler(uint32_t max_draw_count, uint32_t max_instance_count);
+        MATCH_API std::shared_ptr<HiZPyramid> create_hi_z_pyramid(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name);
+        MATCH_API std::shared_ptr<SoftwareOcclusionCuller> create_software_occlusion_culler(uint32_t width = 320, uint32_t height = 192, uint32_t thread_count = 0);
+        MATCH_API std::shared_ptr<FrustumCuller> create_frustum_culler();
+        MATCH_API std::shared_ptr<GLTFSkinner> create_gltf_skinner(std::shared_ptr<GLTFScene> scene);
+        MATCH_API std::shared_ptr<GLTFAnimator> create_gltf_animator(std::shared_ptr<GLTFScene> scene, uint32_t animation_index, uint32_t thread_count = 0);
         MATCH_API std::shared_ptr<VolumeData> load_volume_data(const std::string &filename);
         MATCH_API std::shared_ptr<VolumeData> create_volume_data(const std::vector<float> &raw_data);
     INNER_VISIBLE:
@@ -13,6 +13,7 @@ namespace Match {
         SamplerBorderColor border_color = SamplerBorderColor::eIntOpaqueBlack;
         SamplerFilter mipmap_mode = SamplerFilter::eLinear;
         uint32_t mip_levels = 1;
+        SamplerReductionMode reduction_mode = SamplerReductionMode::eWeightedAverage;
     };
 
     class Sampler {
@@ -19,6 +19,8 @@ namespace Match {
         vk::StencilOpState stencil_front = {};
         vk::StencilOpState stencil_back = {};
         std::vector<vk::DynamicState> dynamic_states;
+        bool dynamic_viewport_scissor = true;
+        bool extended_dynamic_state = false;
     };
 
     struct RayTracingShaderProgramCompileOptions {
@@ -95,6 +97,7 @@ namespace Match {
         std::shared_ptr<VertexAttributeSet> vertex_attribute_set;
         ShaderStageInfo vertex_shader {};
         ShaderStageInfo fragment_shader {};
+        GraphicsShaderProgramCompileOptions compile_options {};
     };
 
     template <>
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <Match/vulkan/resource/model.hpp>
+#include <Match/vulkan/resource/gltf_scene.hpp>
+#include <functional>
+
+namespace Match {
+    struct SoftwareOcclusionStats {
+        uint32_t occluder_triangle_count = 0;
+        uint32_t rasterized_triangle_count = 0;
+        uint32_t occludee_count = 0;
+        uint32_t visible_count = 0;
+        uint32_t occluded_count = 0;
+        float rasterize_time = 0;
+        float test_time = 0;
+        float triangles_per_second = 0;
+    };
+
+    struct SoftwareOcclusionReferenceResult {
+        uint32_t depth_mismatch_count = 0;
+        uint32_t visibility_mismatch_count = 0;
+        float max_depth_error = 0;
+        float reference_rasterize_time = 0;
+        float reference_triangles_per_second = 0;
+    };
+
+    // CPU软件光栅化的遮挡剔除, 在GPU驱动剔除不可用时在录制绘制命令前剔除被遮挡的物体
+    // 选取的遮挡物以低分辨率光栅化到深度缓冲中(SIMD内核, 按屏幕分块多线程光栅化), 再用被测物体的包围盒与深度比较
+    // 深度缓冲按8x4的Tile保存最大深度, 包围盒测试先比较Tile, 再逐像素比较
+    // 遮挡物和被测物体保存的是模型数据的指针, Model和GLTFScene需要比剔除器存活更久
+    class SoftwareOcclusionCuller {
+        no_copy_move_construction(SoftwareOcclusionCuller)
+        struct Occluder {
+            const uint8_t *positions;
+            uint32_t position_stride;
+            const uint32_t *indices;
+            uint32_t triangle_count;
+            glm::mat4 transform;
+        };
+        struct Occludee {
+            glm::vec3 pos_min;
+            glm::vec3 pos_max;
+            glm::mat4 transform;
+        };
+        // 屏幕空间的三角形, 深度为平面z = a * x + b * y + c
+        struct SetupTriangle {
+            float edge_a[3];
+            float edge_b[3];
+            float edge_c[3];
+            float depth_a, depth_b, depth_c;
+            float depth_max;
+            int32_t min_x, min_y, max_x, max_y;
+        };
+    public:
+        constexpr static uint32_t tile_width = 8;
+        constexpr static uint32_t tile_height = 4;
+        constexpr static uint32_t bin_count_x = 4;
+        constexpr static uint32_t bin_count_y = 4;
+    public:
+        // 三角形分成thread_count份在共享线程池中处理, 为0时使用线程池的线程数
+        MATCH_API SoftwareOcclusionCuller(uint32_t width = 320, uint32_t height = 192, uint32_t thread_count = 0);
+        MATCH_API uint32_t add_occluder(std::shared_ptr<const Model> model, const std::string &mesh_name, const glm::mat4 &transform);
+        MATCH_API uint32_t add_occluder(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform);
+        // 直接使用调用者的顶点和索引数据, 数据需要比剔除器存活更久
+        MATCH_API uint32_t add_occluder(const glm::vec3 *positions, const uint32_t *indices, uint32_t triangle_count, const glm::mat4 &transform);
+        MATCH_API void set_occluder_transform(uint32_t occluder_index, const glm::mat4 &transform);
+        MATCH_API uint32_t add_occludee(const glm::vec3 &pos_min, const glm::vec3 &pos_max, const glm::mat4 &transform);
+        MATCH_API uint32_t add_occludee(std::shared_ptr<const Mesh> mesh, const glm::mat4 &transform);
+        MATCH_API uint32_t add_occludee(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform);
+        MATCH_API void set_occludee_transform(uint32_t occludee_index, const glm::mat4 &transform);
+        MATCH_API void cull(const glm::mat4 &view_project);
+        // 用单线程的标量实现重新光栅化和测试, 与cull的结果比较, 需要在cull之后调用
+        MATCH_API SoftwareOcclusionReferenceResult compare_with_reference();
+        bool is_visible(uint32_t occludee_index) const { return visibility[occludee_index] != 0; }
+        const std::vector<uint32_t> &get_visible_occludees() const { return visible_occludees; }
+        const std::vector<float> &get_depth_buffer() const { return depth_buffer; }
+        const SoftwareOcclusionStats &get_stats() const { return stats; }
+        uint32_t get_width() const { return width; }
+        uint32_t get_height() const { return height; }
+        MATCH_API static const char *get_simd_name();
+        MATCH_API ~SoftwareOcclusionCuller();
+    INNER_VISIBLE:
+        MATCH_API bool setup_triangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, SetupTriangle &triangle) const;
+        MATCH_API void rasterize_triangle(const SetupTriangle &triangle, int32_t bin_min_x, int32_t bin_min_y, int32_t bin_max_x, int32_t bin_max_y);
+        MATCH_API void update_tile_depth(int32_t bin_min_x, int32_t bin_min_y, int32_t bin_max_x, int32_t bin_max_y);
+        MATCH_API bool project_occludee(const Occludee &occludee, int32_t &min_x, int32_t &min_y, int32_t &max_x, int32_t &max_y, float &min_depth) const;
+        MATCH_API bool test_occludee(const Occludee &occludee) const;
+        MATCH_API void rasterize_reference(std::vector<float> &reference_depth, uint32_t &triangle_count) const;
+        MATCH_API bool test_occludee_reference(const Occludee &occludee, const std::vector<float> &reference_depth) const;
+    INNER_VISIBLE:
+        uint32_t width;
+        uint32_t height;
+        uint32_t tile_count_x;
+        uint32_t tile_count_y;
+        uint32_t thread_count;
+        glm::mat4 view_project;
+        std::vector<Occluder> occluders;
+        std::vector<Occludee> occludees;
+        std::vector<float> depth_buffer;
+        std::vector<float> tile_max_depth;
+        // 每个线程独立保存变换后的三角形和每个Bin的三角形序号, 光栅化时不需要加锁
+        std::vector<std::vector<SetupTriangle>> thread_triangles;
+        std::vector<std::vector<std::vector<uint32_t>>> thread_bins;
+        std::vector<uint8_t> visibility;
+        std::vector<uint32_t> visible_occludees;
+        SoftwareOcclusionStats stats;
+    };
+}
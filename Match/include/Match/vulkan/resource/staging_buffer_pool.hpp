@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Match/vulkan/resource/buffer.hpp>
+#include <mutex>
+
+namespace Match {
+    class StagingBufferPool {
+        no_copy_move_construction(StagingBufferPool)
+    public:
+        constexpr static uint64_t chunk_size = 64 * 1024 * 1024;
+        constexpr static uint64_t size_granularity = 64 * 1024;
+        constexpr static uint64_t max_cached_size = 256 * 1024 * 1024;
+    public:
+        MATCH_API StagingBufferPool();
+        MATCH_API std::unique_ptr<Buffer> acquire(uint64_t size);
+        MATCH_API void release(std::unique_ptr<Buffer> buffer);
+        MATCH_API void clear();
+        MATCH_API ~StagingBufferPool();
+    INNER_VISIBLE:
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Buffer>> free_buffers;
+        uint64_t cached_size;
+    };
+}
@@ -13,7 +13,7 @@ namespace Match {
     class Swapchain {
         no_copy_move_construction(Swapchain)
     public:
-        MATCH_API Swapchain();
+        MATCH_API Swapchain(vk::SwapchainKHR old_swapchain = VK_NULL_HANDLE);
         MATCH_API ~Swapchain();
     private:
         MATCH_API void query_swapchain_details(SwapchainDetails &details);
@@ -249,6 +249,36 @@ namespace Match {
         eUint32,
     };
 
+    enum class BufferUploadMode {
+        eDynamic,
+        eStatic,
+    };
+
+    enum class IndirectCommandType {
+        eDraw,
+        eDrawIndexed,
+        eDispatch,
+    };
+
+    enum class RenderingMode {
+        eRenderPass,
+        eDynamicRendering,
+    };
+
+    enum class RenderGraphPassType {
+        eRaster,
+        eCompute,
+        eRayTracing,
+        eTransfer,
+    };
+
+    enum class RenderGraphResourceUsage {
+        eSampled,
+        eStorage,
+        eTransfer,
+        eIndirect,
+    };
+
     typedef VertexType ConstantType;
 
     enum class SamplerFilter {
@@ -263,6 +293,12 @@ namespace Match {
         eClampToBorder,
     };
 
+    enum class SamplerReductionMode {
+        eWeightedAverage,
+        eMin,
+        eMax,
+    };
+
     enum class SamplerBorderColor {
         eFloatTransparentBlack,
         eIntTransparentBlack,
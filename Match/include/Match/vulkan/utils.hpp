@@ -19,6 +19,8 @@ namespace Match {
 
     MATCH_API bool has_stencil_component(vk::Format format);
 
+    MATCH_API vk::ImageAspectFlags get_format_aspect(vk::Format format);
+
     MATCH_API SampleCount get_max_usable_sample_count();
 
     MATCH_API vk::DeviceAddress get_buffer_address(vk::Buffer buffer);
@@ -18,6 +18,10 @@ namespace Match {
         return APIManager::GetInstance();
     }
 
+    DefragmentationStats Defragment() {
+        return APIManager::GetInstance().defragment();
+    }
+
     void Destroy() {
         APIManager::GetInstance().destroy();
         runtime_setting.reset();
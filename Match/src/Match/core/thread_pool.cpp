@@ -0,0 +1,100 @@
+#include <Match/core/thread_pool.hpp>
+#include <algorithm>
+
+namespace Match {
+    // 当前线程是否正在执行线程池的任务, 嵌套调用时不再分发
+    static thread_local bool in_parallel_for = false;
+
+    ThreadPool::ThreadPool(uint32_t thread_count) : stop(false), generation(0), task(nullptr), task_count(0), next_task(0), worker_limit(0), joined_count(0), running_count(0) {
+        if (thread_count == 0) {
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        this->thread_count = thread_count;
+        // 调用线程也参与计算, 只需要创建thread_count - 1个工作线程
+        for (uint32_t i = 1; i < thread_count; i ++) {
+            workers.emplace_back(&ThreadPool::worker_loop, this);
+        }
+    }
+
+    void ThreadPool::run_tasks(uint32_t worker_idx) {
+        uint32_t task_idx;
+        while ((task_idx = next_task.fetch_add(1)) < task_count) {
+            (*task)(task_idx, worker_idx);
+        }
+    }
+
+    void ThreadPool::worker_loop() {
+        in_parallel_for = true;
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            job_condition.wait(lock, [&]() { return stop || generation != seen_generation; });
+            if (stop) {
+                return;
+            }
+            seen_generation = generation;
+            // 本组任务需要的线程已经足够, 或调用线程已经完成全部任务
+            if (joined_count >= worker_limit) {
+                continue;
+            }
+            joined_count ++;
+            running_count ++;
+            uint32_t worker_idx = joined_count;
+            lock.unlock();
+            run_tasks(worker_idx);
+            lock.lock();
+            running_count --;
+            if (running_count == 0) {
+                done_condition.notify_all();
+            }
+        }
+    }
+
+    void ThreadPool::parallel_for(uint32_t task_count, const std::function<void(uint32_t, uint32_t)> &task, uint32_t max_worker_count) {
+        if (task_count == 0) {
+            return;
+        }
+        uint32_t worker_count = max_worker_count == 0 ? thread_count : std::min(max_worker_count, thread_count);
+        worker_count = std::min(worker_count, task_count);
+        if (worker_count <= 1 || in_parallel_for) {
+            for (uint32_t task_idx = 0; task_idx < task_count; task_idx ++) {
+                task(task_idx, 0);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->task = &task;
+            this->task_count = task_count;
+            next_task.store(0);
+            worker_limit = worker_count - 1;
+            joined_count = 0;
+            running_count = 0;
+            generation ++;
+        }
+        job_condition.notify_all();
+
+        in_parallel_for = true;
+        run_tasks(0);
+        in_parallel_for = false;
+
+        // 禁止还没醒来的线程加入, 等待已经加入的线程完成
+        std::unique_lock<std::mutex> lock(mutex);
+        worker_limit = joined_count;
+        done_condition.wait(lock, [&]() { return running_count == 0; });
+        this->task = nullptr;
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        job_condition.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+}
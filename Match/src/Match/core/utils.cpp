@@ -1,5 +1,14 @@
 #include <Match/core/utils.hpp>
 #include <fstream>
+#if defined (PLATFORM_WINDOWS)
+    #define NOMINMAX
+    #include <Windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
 
 namespace Match {
     std::vector<char> read_binary_file(const std::string &filename) {
@@ -19,4 +28,74 @@ namespace Match {
 
         return buffer;
     }
+
+    MappedFile::MappedFile(const std::string &filename) : data(nullptr), size(0), file_handle(nullptr), mapping_handle(nullptr) {
+#if defined (PLATFORM_WINDOWS)
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            MCH_ERROR("Cannot open file {}", filename)
+            return;
+        }
+        file_handle = file;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            MCH_ERROR("Cannot map empty file {}", filename)
+            return;
+        }
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            MCH_ERROR("Cannot map file {}", filename)
+            return;
+        }
+        mapping_handle = mapping;
+        data = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (data == nullptr) {
+            MCH_ERROR("Cannot map file {}", filename)
+            return;
+        }
+        size = file_size.QuadPart;
+#else
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            MCH_ERROR("Cannot open file {}", filename)
+            return;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            MCH_ERROR("Cannot map empty file {}", filename)
+            close(fd);
+            return;
+        }
+        void *ptr = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // 映射建立后文件描述符可以关闭
+        close(fd);
+        if (ptr == MAP_FAILED) {
+            MCH_ERROR("Cannot map file {}", filename)
+            return;
+        }
+        madvise(ptr, file_stat.st_size, MADV_SEQUENTIAL);
+        data = static_cast<const uint8_t *>(ptr);
+        size = file_stat.st_size;
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+#if defined (PLATFORM_WINDOWS)
+        if (data != nullptr) {
+            UnmapViewOfFile(data);
+        }
+        if (mapping_handle != nullptr) {
+            CloseHandle(mapping_handle);
+        }
+        if (file_handle != nullptr) {
+            CloseHandle(file_handle);
+        }
+#else
+        if (data != nullptr) {
+            munmap(const_cast<uint8_t *>(data), size);
+        }
+#endif
+        data = nullptr;
+        size = 0;
+    }
 }
@@ -83,7 +83,19 @@ namespace Match {
         init_info.Device = manager->device->device;
         init_info.QueueFamily = manager->device->graphics_family_index;
         init_info.Queue = manager->device->graphics_queue;
-        init_info.RenderPass = renderer.render_pass->render_pass;
+        VkFormat color_attachment_format = static_cast<VkFormat>(manager->swapchain->format.format);
+        if (renderer.mode == RenderingMode::eDynamicRendering) {
+#ifdef IMGUI_IMPL_VULKAN_HAS_DYNAMIC_RENDERING
+            init_info.UseDynamicRendering = true;
+            init_info.PipelineRenderingCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
+            init_info.PipelineRenderingCreateInfo.colorAttachmentCount = 1;
+            init_info.PipelineRenderingCreateInfo.pColorAttachmentFormats = &color_attachment_format;
+#else
+            MCH_ERROR("ImGui Vulkan backend is built without dynamic rendering support")
+#endif
+        } else {
+            init_info.RenderPass = renderer.render_pass->render_pass;
+        }
         init_info.PipelineCache = VK_NULL_HANDLE;
         init_info.DescriptorPool = descriptor_pool;
         init_info.Subpass = renderer.render_pass_builder->subpass_builders.size() - 1;
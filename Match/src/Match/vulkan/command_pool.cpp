@@ -2,10 +2,13 @@
 #include "inner.hpp"
 
 namespace Match {
-    CommandPool::CommandPool(vk::CommandPoolCreateFlags flags) {
+    CommandPool::CommandPool(vk::CommandPoolCreateFlags flags, uint32_t queue_family_index) {
+        if (queue_family_index == -1u) {
+            queue_family_index = manager->device->graphics_family_index;
+        }
         vk::CommandPoolCreateInfo command_pool_create_info {};
         command_pool_create_info.setFlags(flags)
-            .setQueueFamilyIndex(manager->device->graphics_family_index);
+            .setQueueFamilyIndex(queue_family_index);
         command_pool = manager->device->device.createCommandPool(command_pool_create_info);
     }
 
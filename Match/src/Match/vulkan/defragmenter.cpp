@@ -0,0 +1,132 @@
+#include <Match/vulkan/defragmenter.hpp>
+#include "inner.hpp"
+
+namespace Match {
+    Defragmenter::Defragmenter() : current_callback_id(0) {
+    }
+
+    float Defragmenter::calculate_fragmentation() {
+        VmaTotalStatistics statistics {};
+        vmaCalculateStatistics(manager->vma_allocator, &statistics);
+        auto unused_bytes = statistics.total.statistics.blockBytes - statistics.total.statistics.allocationBytes;
+        if (unused_bytes == 0) {
+            return 0.0f;
+        }
+        return 1.0f - static_cast<float>(statistics.total.unusedRangeSizeMax) / static_cast<float>(unused_bytes);
+    }
+
+    DefragmentationStats Defragmenter::defragment() {
+        DefragmentationStats stats {};
+        // 移动资源时不能有正在执行的帧使用它们, 等待设备空闲后先销毁延迟销毁的资源, 释放出的空间也参与整理
+        manager->device->device.waitIdle();
+        manager->destruction_queue->flush();
+        stats.fragmentation_before = calculate_fragmentation();
+        moved_address_ranges.clear();
+
+        VmaDefragmentationInfo defragmentation_info {};
+        defragmentation_info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+        VmaDefragmentationContext context;
+        if (vmaBeginDefragmentation(manager->vma_allocator, &defragmentation_info, &context) != VK_SUCCESS) {
+            MCH_ERROR("Failed to begin defragmentation")
+            return stats;
+        }
+
+        while (true) {
+            VmaDefragmentationPassMoveInfo pass {};
+            auto result = vmaBeginDefragmentationPass(manager->vma_allocator, context, &pass);
+            if (result == VK_SUCCESS) {
+                break;
+            }
+            if (result != VK_INCOMPLETE) {
+                MCH_ERROR("Failed to begin defragmentation pass: {}", static_cast<int32_t>(result))
+                break;
+            }
+
+            std::vector<Defragmentable *> moving_resources;
+            auto command_buffer = manager->command_pool->allocate_single_use();
+            for (uint32_t i = 0; i < pass.moveCount; i ++) {
+                auto &move = pass.pMoves[i];
+                VmaAllocationInfo allocation_info {};
+                vmaGetAllocationInfo(manager->vma_allocator, move.srcAllocation, &allocation_info);
+                auto *resource = static_cast<Defragmentable *>(allocation_info.pUserData);
+                if (resource == nullptr || !resource->is_movable()) {
+                    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                    continue;
+                }
+                resource->begin_move(command_buffer, move.dstTmpAllocation);
+                moving_resources.push_back(resource);
+            }
+            manager->command_pool->free_single_use(command_buffer);
+
+            for (auto *resource : moving_resources) {
+                resource->end_move();
+            }
+
+            result = vmaEndDefragmentationPass(manager->vma_allocator, context, &pass);
+            if (result == VK_SUCCESS) {
+                break;
+            }
+            if (result != VK_INCOMPLETE) {
+                MCH_ERROR("Failed to end defragmentation pass: {}", static_cast<int32_t>(result))
+                break;
+            }
+        }
+
+        VmaDefragmentationStats vma_stats {};
+        vmaEndDefragmentation(manager->vma_allocator, context, &vma_stats);
+        stats.bytes_moved = vma_stats.bytesMoved;
+        stats.bytes_freed = vma_stats.bytesFreed;
+        stats.allocations_moved = vma_stats.allocationsMoved;
+        stats.device_memory_blocks_freed = vma_stats.deviceMemoryBlocksFreed;
+
+        if (stats.allocations_moved > 0) {
+            for (auto &[id, callback] : callbacks) {
+                callback();
+            }
+        }
+        moved_address_ranges.clear();
+
+        stats.fragmentation_after = calculate_fragmentation();
+        MCH_INFO("Defragmentation moved {} allocations ({} bytes), freed {} bytes in {} blocks, fragmentation {:.3f} -> {:.3f}", stats.allocations_moved, stats.bytes_moved, stats.bytes_freed, stats.device_memory_blocks_freed, stats.fragmentation_before, stats.fragmentation_after)
+        return stats;
+    }
+
+    void Defragmenter::report_moved_address(vk::DeviceAddress old_address, vk::DeviceAddress new_address, uint64_t size) {
+        // 同一个资源可能在多个pass中被移动(A->B->C), 只记录整理前的地址到最终地址的映射
+        bool merged = false;
+        for (auto &range : moved_address_ranges) {
+            if (old_address <= range.new_address && range.new_address < old_address + size) {
+                range.new_address = new_address + (range.new_address - old_address);
+                merged = true;
+            }
+        }
+        if (!merged) {
+            moved_address_ranges.push_back({ old_address, new_address, size });
+        }
+    }
+
+    vk::DeviceAddress Defragmenter::remap_address(vk::DeviceAddress address) const {
+        for (auto &range : moved_address_ranges) {
+            if (range.old_address <= address && address < range.old_address + range.size) {
+                return range.new_address + (address - range.old_address);
+            }
+        }
+        return address;
+    }
+
+    uint32_t Defragmenter::register_resource_moved_callback(const ResourceMovedCallback &callback) {
+        uint32_t id = current_callback_id;
+        current_callback_id ++;
+        callbacks.insert(std::make_pair(id, callback));
+        return id;
+    }
+
+    void Defragmenter::remove_resource_moved_callback(uint32_t id) {
+        callbacks.erase(id);
+    }
+
+    Defragmenter::~Defragmenter() {
+        callbacks.clear();
+        moved_address_ranges.clear();
+    }
+}
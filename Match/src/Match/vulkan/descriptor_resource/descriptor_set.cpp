@@ -41,9 +41,11 @@ namespace Match {
         }
         allocated = false;
 
-        manager->descriptor_pool->free_descriptor_sets(descriptor_sets);
+        manager->destroy_later([descriptor_sets = std::move(descriptor_sets), descriptor_layout = descriptor_layout]() {
+            manager->descriptor_pool->free_descriptor_sets(descriptor_sets);
+            manager->device->device.destroyDescriptorSetLayout(descriptor_layout);
+        });
         descriptor_sets.clear();
-        manager->device->device.destroyDescriptorSetLayout(descriptor_layout);
 
         return *this;
     }
@@ -65,6 +67,13 @@ namespace Match {
             }
             callback_id.reset();
         }
+        if (moved_callback_id.has_value() && manager->defragmenter.get() != nullptr) {
+            manager->defragmenter->remove_resource_moved_callback(moved_callback_id.value());
+            moved_callback_id.reset();
+        }
+        textures_temp.clear();
+        storage_buffers_temp.clear();
+        storage_images_temp.clear();
         this->free();
         layout_bindings.clear();
     }
@@ -105,6 +114,8 @@ namespace Match {
             return *this;
         }
         assert(layout_binding.descriptorCount == textures_samplers.size());
+        register_resource_moved_callback();
+        textures_temp[binding] = { textures_samplers.begin(), textures_samplers.end() };
         for (uint32_t in_flight = 0; in_flight < setting.max_in_flight_frame; in_flight ++) {
             std::vector<vk::DescriptorImageInfo> image_infos(layout_binding.descriptorCount);
             for (uint32_t i = 0; i < layout_binding.descriptorCount; i ++) {
@@ -174,6 +185,61 @@ namespace Match {
             bind_input_attachments(binding, args);
         }
     };
+
+    void DescriptorSet::register_resource_moved_callback() {
+        if (moved_callback_id.has_value()) {
+            return;
+        }
+        moved_callback_id = manager->defragmenter->register_resource_moved_callback([this]() {
+            update_moved_resources();
+        });
+    }
+
+    template <class Type>
+    static bool lock_resources(const std::vector<std::weak_ptr<Type>> &weak_resources, std::vector<std::shared_ptr<Type>> &resources) {
+        for (auto &weak_resource : weak_resources) {
+            auto resource = weak_resource.lock();
+            if (resource.get() == nullptr) {
+                return false;
+            }
+            resources.push_back(std::move(resource));
+        }
+        return true;
+    }
+
+    void DescriptorSet::update_moved_resources() {
+        if (!allocated) {
+            return;
+        }
+        // 绑定的资源已经被销毁时, 这个绑定不会再被使用, 直接跳过
+        for (auto [binding, weak_args] : textures_temp) {
+            std::vector<std::pair<std::shared_ptr<Texture>, std::shared_ptr<Sampler>>> args;
+            for (auto &[weak_texture, weak_sampler] : weak_args) {
+                auto texture = weak_texture.lock();
+                auto sampler = weak_sampler.lock();
+                if (texture.get() == nullptr || sampler.get() == nullptr) {
+                    break;
+                }
+                args.emplace_back(std::move(texture), std::move(sampler));
+            }
+            if (args.size() == weak_args.size()) {
+                bind_textures(binding, args);
+            }
+        }
+        for (auto [binding, weak_args] : storage_buffers_temp) {
+            std::vector<std::shared_ptr<StorageBuffer>> args;
+            if (lock_resources(weak_args, args)) {
+                bind_storage_buffers(binding, args);
+            }
+        }
+        for (auto [binding, weak_args] : storage_images_temp) {
+            std::vector<std::shared_ptr<StorageImage>> args;
+            if (lock_resources(weak_args, args)) {
+                bind_storage_images(binding, args);
+            }
+        }
+    }
+
     DescriptorSet &DescriptorSet::bind_storage_buffers(uint32_t binding, const std::vector<std::shared_ptr<StorageBuffer>> &storage_buffers) {
         auto layout_binding = get_layout_binding(binding);
         if (layout_binding.descriptorType != vk::DescriptorType::eStorageBuffer) {
@@ -181,6 +247,8 @@ namespace Match {
             return *this;
         }
         assert(layout_binding.descriptorCount == storage_buffers.size());
+        register_resource_moved_callback();
+        storage_buffers_temp[binding] = { storage_buffers.begin(), storage_buffers.end() };
         for (uint32_t in_flight = 0; in_flight < setting.max_in_flight_frame; in_flight ++) {
             std::vector<vk::DescriptorBufferInfo> buffer_infos(layout_binding.descriptorCount);
             for (uint32_t i = 0; i < layout_binding.descriptorCount; i ++) {
@@ -210,6 +278,8 @@ namespace Match {
             return *this;
         }
         assert(layout_binding.descriptorCount == storage_images.size());
+        register_resource_moved_callback();
+        storage_images_temp[binding] = { storage_images.begin(), storage_images.end() };
         for (uint32_t in_flight = 0; in_flight < setting.max_in_flight_frame; in_flight ++) {
             std::vector<vk::DescriptorImageInfo> image_infos(layout_binding.descriptorCount);
             for (uint32_t i = 0; i < layout_binding.descriptorCount; i ++) {
@@ -16,8 +16,14 @@ namespace Match {
         image_view = create_image_view(image->image, format, vk::ImageAspectFlagBits::eColor, 1);
     }
 
+    StorageImage::StorageImage(std::unique_ptr<Image> image) : image(std::move(image)) {
+        image_view = create_image_view(this->image->image, this->image->image_create_info.format, vk::ImageAspectFlagBits::eColor, 1);
+    }
+
     StorageImage::~StorageImage() {
-        manager->device->device.destroyImageView(image_view);
+        manager->destroy_later([image_view = image_view]() {
+            manager->device->device.destroyImageView(image_view);
+        });
         image.reset();
     }
 }
@@ -19,7 +19,7 @@ namespace Match {
             mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height))) + 1);
         }
         this->mip_levels = mip_levels;
-        image = std::make_unique<Image>(width, height, vk::Format::eR8G8B8A8Srgb, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst, vk::SampleCountFlagBits::e1, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, mip_levels);
+        image = std::make_unique<Image>(width, height, vk::Format::eR8G8B8A8Srgb, vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst, vk::SampleCountFlagBits::e1, VMA_MEMORY_USAGE_AUTO, 0, mip_levels);
 
         transition_image_layout(image->image, vk::ImageAspectFlagBits::eColor, mip_levels, { vk::ImageLayout::eUndefined, vk::AccessFlagBits::eNone, vk::PipelineStageFlagBits::eTopOfPipe }, { vk::ImageLayout::eTransferDstOptimal, vk::AccessFlagBits::eTransferWrite, vk::PipelineStageFlagBits::eTransfer });
 
@@ -109,10 +109,18 @@ namespace Match {
         manager->command_pool->free_single_use(command_buffer);
 
         image_view = create_image_view(image->image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor, mip_levels);
+        image->set_movable(vk::ImageLayout::eShaderReadOnlyOptimal, [this]() {
+            manager->destroy_later([image_view = image_view]() {
+                manager->device->device.destroyImageView(image_view);
+            });
+            image_view = create_image_view(image->image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor, this->mip_levels);
+        });
     }
 
     DataTexture::~DataTexture() {
-        manager->device->device.destroyImageView(image_view);
+        manager->destroy_later([image_view = image_view]() {
+            manager->device->device.destroyImageView(image_view);
+        });
         image.reset();
     }
 
@@ -149,10 +157,12 @@ namespace Match {
     }
 
     KtxTexture::~KtxTexture() {
-        vk_texture.vkFreeMemory(manager->device->device, vk_texture.deviceMemory, nullptr);
-        vk_texture.vkDestroyImage(manager->device->device, vk_texture.image, nullptr);
+        manager->destroy_later([vk_texture = vk_texture, image_view = image_view]() {
+            manager->device->device.destroyImageView(image_view);
+            vk_texture.vkDestroyImage(manager->device->device, vk_texture.image, nullptr);
+            vk_texture.vkFreeMemory(manager->device->device, vk_texture.deviceMemory, nullptr);
+        });
         ktxTexture_Destroy(texture);
-        manager->device->device.destroyImageView(image_view);
     }
 #endif
 }
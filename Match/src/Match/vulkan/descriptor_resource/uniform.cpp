@@ -4,8 +4,7 @@
 namespace Match {
     UniformBuffer::UniformBuffer(uint64_t size, bool create_for_each_frame_in_flight) : size(size) {
         for (uint32_t i = 0; i < (create_for_each_frame_in_flight ? setting.max_in_flight_frame : 1); i ++) {
-            buffers.emplace_back(size, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-            buffers.back().map();
+            buffers.emplace_back(size, vk::BufferUsageFlagBits::eUniformBuffer, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
         }
     }
 
@@ -13,6 +12,10 @@ namespace Match {
         return get_match_buffer(runtime_setting->current_in_flight).data_ptr;
     }
 
+    void UniformBuffer::flush() {
+        get_match_buffer(runtime_setting->current_in_flight).flush();
+    }
+
     Buffer &UniformBuffer::get_match_buffer(uint32_t in_flight_index) {
         return buffers[in_flight_index % buffers.size()];
     }
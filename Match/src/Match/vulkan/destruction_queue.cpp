@@ -0,0 +1,57 @@
+#include <Match/vulkan/destruction_queue.hpp>
+#include <Match/core/setting.hpp>
+#include "inner.hpp"
+
+namespace Match {
+    DestructionQueue::DestructionQueue() : current_frame(0) {
+    }
+
+    void DestructionQueue::enqueue(const Destroyer &destroyer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        destroyers.push_back(std::make_pair(current_frame, destroyer));
+    }
+
+    void DestructionQueue::submit_frame() {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_frame ++;
+    }
+
+    void DestructionQueue::collect() {
+        // 在等待当前帧的Fence之后调用, current_frame - max_in_flight_frame 之前记录的资源已经不再被GPU使用
+        std::vector<Destroyer> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!destroyers.empty() && destroyers.front().first + setting.max_in_flight_frame <= current_frame) {
+                ready.push_back(std::move(destroyers.front().second));
+                destroyers.pop_front();
+            }
+        }
+        // 销毁时可能会继续向队列中添加资源, 所以在锁外执行
+        for (auto &destroyer : ready) {
+            destroyer();
+        }
+    }
+
+    void DestructionQueue::flush() {
+        while (true) {
+            std::vector<Destroyer> ready;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (destroyers.empty()) {
+                    break;
+                }
+                for (auto &[frame, destroyer] : destroyers) {
+                    ready.push_back(std::move(destroyer));
+                }
+                destroyers.clear();
+            }
+            for (auto &destroyer : ready) {
+                destroyer();
+            }
+        }
+    }
+
+    DestructionQueue::~DestructionQueue() {
+        flush();
+    }
+}
@@ -57,11 +57,12 @@ namespace Match {
         std::set<uint32_t> queue_family_indices = { graphics_family_index, present_family_index, transfer_family_index, compute_family_index };
         std::vector<vk::DeviceQueueCreateInfo> queue_create_infos(queue_family_indices.size());
         uint32_t i = 0;
-        float priorities = 1.0f;
+        float priorities[] = { 1.0f, 1.0f };
         for (auto queue_family_index : queue_family_indices) {
+            uint32_t queue_count = queue_family_index == compute_family_index ? compute_queue_index + 1 : 1;
             queue_create_infos[i].setQueueFamilyIndex(queue_family_index)
-                .setQueueCount(1)
-                .setQueuePriorities(priorities);
+                .setQueueCount(queue_count)
+                .setPQueuePriorities(priorities);
             i ++;
         }
 
@@ -72,6 +73,8 @@ namespace Match {
         features.shaderInt64 = VK_TRUE;
         features.fragmentStoresAndAtomics = VK_TRUE;
         features.multiDrawIndirect = VK_TRUE;
+        // GPU剔除把实例序号写入firstInstance, 间接绘制命令的firstInstance不为0
+        features.drawIndirectFirstInstance = VK_TRUE;
         features.geometryShader = VK_TRUE;
         features.fillModeNonSolid = VK_TRUE;
         features.wideLines = VK_TRUE;
@@ -82,6 +85,10 @@ namespace Match {
         vk12_features.descriptorBindingVariableDescriptorCount = VK_TRUE;
         vk12_features.drawIndirectCount = VK_TRUE;
         vk12_features.samplerFilterMinmax = VK_TRUE;
+        vk12_features.hostQueryReset = VK_TRUE;
+        vk::PhysicalDeviceVulkan13Features vk13_features {};
+        vk13_features.dynamicRendering = VK_TRUE;
+        vk12_features.setPNext(&vk13_features);
         vk::DeviceCreateInfo device_create_info {};
         device_create_info.setPNext(&vk12_features);
 
@@ -156,7 +163,7 @@ namespace Match {
         graphics_queue = device.getQueue(graphics_family_index, 0);
         present_queue = device.getQueue(present_family_index, 0);
         transfer_queue = device.getQueue(transfer_family_index, 0);
-        compute_queue = device.getQueue(compute_family_index, 0);
+        compute_queue = device.getQueue(compute_family_index, compute_queue_index);
 
         if (setting.enable_ray_tracing) {
             vk::PhysicalDeviceProperties2 properties {};
@@ -192,6 +199,11 @@ namespace Match {
             return false;
         }
 
+        if (!features.drawIndirectFirstInstance) {
+            MCH_DEBUG("{} does not support draw indirect first instance -- skipping", std::string(properties.deviceName))
+            return false;
+        }
+
         if (!features.shaderInt64) {
             MCH_DEBUG("{} does not support type int 64 -- warning", std::string(properties.deviceName))
         }
@@ -217,6 +229,31 @@ namespace Match {
             return false;
         }
 
+        // 异步计算优先使用专用的计算队列族, 否则使用图形队列族中的第二个队列
+        compute_queue_index = 0;
+        concurrent_family_indices.clear();
+        if (setting.enable_async_compute) {
+            bool found_compute_family = false;
+            for (uint32_t idx = 0; idx < queue_families_properties.size(); idx ++) {
+                auto flags = queue_families_properties[idx].queueFlags;
+                if ((flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics)) {
+                    compute_family_index = idx;
+                    found_compute_family = true;
+                    break;
+                }
+            }
+            if (found_compute_family) {
+                // 资源会在两个队列族之间共享
+                concurrent_family_indices = { graphics_family_index, compute_family_index };
+                MCH_DEBUG("Use dedicated compute queue family {} for async compute", compute_family_index)
+            } else if (queue_families_properties[graphics_family_index].queueCount > 1) {
+                compute_queue_index = 1;
+                MCH_DEBUG("Use the second queue of graphics queue family for async compute")
+            } else {
+                MCH_WARN("{} has no separate compute queue, async compute will be serialized with graphics", std::string(properties.deviceName))
+            }
+        }
+
         MCH_DEBUG("{} is suitable", std::string(properties.deviceName))
         physical_device = device;
         MCH_INFO("Select Device {}", std::string(properties.deviceName))
@@ -7,14 +7,21 @@
 namespace Match {
     Attachment::Attachment() {}
 
-    Attachment::Attachment(const vk::AttachmentDescription& description, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect) {
-        image = std::make_unique<Image>(runtime_setting->window_size.width, runtime_setting->window_size.height, description.format, usage, description.samples, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+    Attachment::Attachment(const vk::AttachmentDescription& description, vk::ImageUsageFlags usage, vk::ImageAspectFlags aspect, VmaMemoryUsage vma_usage) {
+        image = std::make_unique<Image>(runtime_setting->window_size.width, runtime_setting->window_size.height, description.format, usage, description.samples, vma_usage, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
         if (aspect == (vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil)) {
             aspect = vk::ImageAspectFlagBits::eDepth;
         }
         image_view = create_image_view(image->image, description.format, aspect, 1);
     }
 
+    Attachment::Attachment(std::unique_ptr<Image> image, vk::ImageAspectFlags aspect) : image(std::move(image)) {
+        if (aspect == (vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil)) {
+            aspect = vk::ImageAspectFlagBits::eDepth;
+        }
+        image_view = create_image_view(this->image->image, this->image->image_create_info.format, aspect, 1);
+    }
+
     Attachment::Attachment(Attachment &&rhs) {
         image = std::move(rhs.image);
         image_view = rhs.image_view;
@@ -29,7 +36,9 @@ namespace Match {
 
     Attachment::~Attachment() {
         if (image.get() != nullptr) {
-            manager->device->device.destroyImageView(image_view);
+            manager->destroy_later([image_view = image_view]() {
+                manager->device->device.destroyImageView(image_view);
+            });
             image.reset();
         }
     }
@@ -45,31 +54,41 @@ namespace Match {
     }
 
     FrameBuffer::~FrameBuffer() {
-        manager->device->device.destroyFramebuffer(framebuffer);
+        manager->destroy_later([framebuffer = framebuffer]() {
+            manager->device->device.destroyFramebuffer(framebuffer);
+        });
     }
 
     FrameBufferSet::FrameBufferSet(const Renderer &renderer) {
-        uint32_t attachments_count = renderer.render_pass_builder->final_attachments.size();
+        auto &builder = *renderer.render_pass_builder;
+        uint32_t attachments_count = builder.final_attachments.size();
         std::vector<vk::ImageView> image_views(attachments_count);
         attachments.resize(attachments_count);
-        uint32_t swapchain_image_view_idx;
-
-        for (auto &[name, idx] : renderer.render_pass_builder->attachments_map) {
-            auto &attachment = renderer.render_pass_builder->attachments[idx];
-            if (idx == 0) {
-                if (attachment.description_read.has_value()) {
-                    attachments[idx] = std::move(Attachment(attachment.description_write, attachment.usage, attachment.aspect));
-                    swapchain_image_view_idx = renderer.render_pass_builder->get_attachment_index(SWAPCHAIN_IMAGE_ATTACHMENT, true);
-                } else {
-                    swapchain_image_view_idx = 0;
-                }
+        uint32_t swapchain_image_view_idx = builder.get_attachment_index(SWAPCHAIN_IMAGE_ATTACHMENT, true);
+
+        std::vector<bool> aliased(attachments_count, false);
+        for (auto &group : builder.final_alias_groups) {
+            for (auto idx : group) {
+                aliased[idx] = true;
+            }
+        }
+        for (uint32_t idx = 0; idx < attachments_count; idx ++) {
+            if (idx == swapchain_image_view_idx || aliased[idx]) {
                 continue;
             }
-            attachments[idx] = std::move(Attachment(attachment.description_write, attachment.usage, attachment.aspect));
-            if (attachment.description_read.has_value()) {
-                attachments[renderer.render_pass_builder->get_attachment_index(name, true)] = std::move(Attachment(attachment.description_read.value(), attachment.usage_read, attachment.aspect));
+            auto vma_usage = VMA_MEMORY_USAGE_AUTO;
+            if (builder.lazily_allocated_memory_supported && (builder.final_usages[idx] & vk::ImageUsageFlagBits::eTransientAttachment)) {
+                vma_usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
             }
+            attachments[idx] = std::move(Attachment(builder.final_attachments[idx], builder.final_usages[idx], builder.final_aspects[idx], vma_usage));
         }
+        create_aliased_attachments(builder);
+
+        // 动态渲染直接使用Attachment的ImageView, 不需要创建FrameBuffer
+        if (renderer.mode == RenderingMode::eDynamicRendering) {
+            return;
+        }
+
         for (uint32_t idx = 0; idx < attachments_count; idx ++) {
             image_views[idx] = attachments[idx].image_view;
         }
@@ -80,8 +99,56 @@ namespace Match {
         }
     }
 
+    void FrameBufferSet::create_aliased_attachments(const RenderPassBuilder &builder) {
+        uint64_t aliased_size = 0, allocated_size = 0;
+        for (auto &group : builder.final_alias_groups) {
+            std::vector<std::unique_ptr<Image>> images;
+            vk::MemoryRequirements requirements { 0, 1, ~0u };
+            uint64_t group_size = 0;
+            for (auto idx : group) {
+                auto &description = builder.final_attachments[idx];
+                auto &image = images.emplace_back(std::make_unique<Image>(runtime_setting->window_size.width, runtime_setting->window_size.height, description.format, builder.final_usages[idx], description.samples));
+                auto image_requirements = image->get_memory_requirements();
+                requirements.size = std::max(requirements.size, image_requirements.size);
+                requirements.alignment = std::max(requirements.alignment, image_requirements.alignment);
+                requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+                group_size += image_requirements.size;
+            }
+
+            if (requirements.memoryTypeBits == 0) {
+                MCH_DEBUG("Transient attachments have no common memory type, allocate them separately")
+                for (auto idx : group) {
+                    attachments[idx] = std::move(Attachment(builder.final_attachments[idx], builder.final_usages[idx], builder.final_aspects[idx]));
+                }
+                continue;
+            }
+
+            VmaAllocationCreateInfo alloc_info {};
+            alloc_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+            alloc_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            VmaAllocation allocation;
+            vmaAllocateMemory(manager->vma_allocator, reinterpret_cast<VkMemoryRequirements *>(&requirements), &alloc_info, &allocation, nullptr);
+            aliased_allocations.push_back(allocation);
+            for (uint32_t i = 0; i < group.size(); i ++) {
+                images[i]->bind_memory(allocation);
+                attachments[group[i]] = std::move(Attachment(std::move(images[i]), builder.final_aspects[group[i]]));
+            }
+            aliased_size += group_size;
+            allocated_size += requirements.size;
+        }
+        if (aliased_size != 0) {
+            MCH_DEBUG("Alias transient attachments: {} bytes -> {} bytes, saved {} bytes", aliased_size, allocated_size, aliased_size - allocated_size)
+        }
+    }
+
     FrameBufferSet::~FrameBufferSet() {
         framebuffers.clear();
         attachments.clear();
+        for (auto allocation : aliased_allocations) {
+            manager->destroy_later([allocation]() {
+                vmaFreeMemory(manager->vma_allocator, allocation);
+            });
+        }
+        aliased_allocations.clear();
     }
 }
@@ -49,14 +49,26 @@ namespace Match {
         return *command_pool;
     }
 
+    ThreadPool &APIManager::get_thread_pool() {
+        return *thread_pool;
+    }
+
+    DefragmentationStats APIManager::defragment() {
+        return defragmenter->defragment();
+    }
+
     void APIManager::initialize() {
         MCH_INFO("Initialize Vulkan API")
         create_vk_surface();
         device = std::make_unique<Device>();
         initialize_vma();
+        defragmenter = std::make_unique<Defragmenter>();
+        destruction_queue = std::make_unique<DestructionQueue>();
         swapchain = std::make_unique<Swapchain>();
         command_pool = std::make_unique<CommandPool>(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
         descriptor_pool = std::make_unique<DescriptorPool>();
+        staging_buffer_pool = std::make_unique<StagingBufferPool>();
+        thread_pool = std::make_unique<ThreadPool>();
     }
 
     void APIManager::create_vk_instance() {
@@ -135,23 +147,39 @@ namespace Match {
         vmaCreateAllocator(&create_info, &vma_allocator);
     }
 
-    void APIManager::recreate_swapchin() {
-        vkDeviceWaitIdle(device->device);
-        swapchain.reset();
+    std::unique_ptr<Swapchain> APIManager::recreate_swapchin() {
         int width, height;
         glfwGetWindowSize(window->get_glfw_window(), &width, &height);
         while (width == 0 || height == 0) {
+            // 窗口最小化时阻塞等待事件, 不再轮询
+            glfwWaitEvents();
             glfwGetWindowSize(window->get_glfw_window(), &width, &height);
-            std::this_thread::sleep_for(std::chrono::milliseconds(20));
         }
-        swapchain = std::make_unique<Swapchain>();
+        // 旧的交换链交给调用者, 等使用它的帧完成后再销毁
+        auto old_swapchain = std::move(swapchain);
+        swapchain = std::make_unique<Swapchain>(old_swapchain->swapchain);
+        return old_swapchain;
+    }
+
+    void APIManager::destroy_later(const std::function<void()> &destroyer) {
+        // 销毁队列不存在时(初始化前或已经销毁)直接销毁
+        if (destruction_queue.get() == nullptr) {
+            destroyer();
+            return;
+        }
+        destruction_queue->enqueue(destroyer);
     }
 
     void APIManager::destroy() {
         MCH_INFO("Destroy Vulkan API")
+        device->device.waitIdle();
+        thread_pool.reset();
+        staging_buffer_pool.reset();
+        destruction_queue.reset();
         descriptor_pool.reset();
         command_pool.reset();
         swapchain.reset();
+        defragmenter.reset();
         vmaDestroyAllocator(vma_allocator);
         device.reset();
         this->runtime_setting.reset();
@@ -0,0 +1,474 @@
+#include <Match/vulkan/render_graph.hpp>
+#include <Match/vulkan/utils.hpp>
+#include "inner.hpp"
+#include <queue>
+#include <set>
+
+namespace Match {
+    static vk::PipelineStageFlags get_pass_stage(RenderGraphPassType type) {
+        switch (type) {
+        case RenderGraphPassType::eRaster:
+            return vk::PipelineStageFlagBits::eAllGraphics;
+        case RenderGraphPassType::eCompute:
+            return vk::PipelineStageFlagBits::eComputeShader;
+        case RenderGraphPassType::eRayTracing:
+            return vk::PipelineStageFlagBits::eRayTracingShaderKHR;
+        case RenderGraphPassType::eTransfer:
+            return vk::PipelineStageFlagBits::eTransfer;
+        }
+        return vk::PipelineStageFlagBits::eAllCommands;
+    }
+
+    RenderGraphPass &RenderGraphPass::read(const std::string &resource_name, RenderGraphResourceUsage usage) {
+        references.push_back({ resource_name, usage, false });
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::write(const std::string &resource_name, RenderGraphResourceUsage usage) {
+        references.push_back({ resource_name, usage, true });
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::set_side_effect() {
+        side_effect = true;
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraphPass::execute(const ExecuteCallback &callback) {
+        this->callback = callback;
+        return *this;
+    }
+
+    RenderGraph::RenderGraph(std::weak_ptr<Renderer> renderer) : renderer(renderer) {
+    }
+
+    RenderGraph &RenderGraph::import_image(const std::string &name, std::shared_ptr<StorageImage> image) {
+        auto &resource = resources[name];
+        resource.image = image;
+        resource.format = image->image->image_create_info.format;
+        resource.width = image->image->image_create_info.extent.width;
+        resource.height = image->image->image_create_info.extent.height;
+        return *this;
+    }
+
+    RenderGraph &RenderGraph::import_buffer(const std::string &name, std::shared_ptr<StorageBuffer> buffer) {
+        resources[name].buffer = buffer;
+        return *this;
+    }
+
+    RenderGraph &RenderGraph::create_image(const std::string &name, uint32_t width, uint32_t height, vk::Format format) {
+        auto &resource = resources[name];
+        resource.transient = true;
+        resource.width = width;
+        resource.height = height;
+        resource.format = format;
+        return *this;
+    }
+
+    RenderGraph &RenderGraph::mark_output(const std::string &name) {
+        resources[name].output = true;
+        return *this;
+    }
+
+    RenderGraphPass &RenderGraph::add_pass(const std::string &name, RenderGraphPassType type) {
+        return *passes.emplace_back(std::make_unique<RenderGraphPass>(name, type));
+    }
+
+    void RenderGraph::compile() {
+        for (auto &pass : passes) {
+            for (auto &reference : pass->references) {
+                if (resources.find(reference.name) == resources.end()) {
+                    MCH_ERROR("Render graph pass {} references undeclared resource {}", pass->name, reference.name)
+                    return;
+                }
+            }
+        }
+
+        execution_order = sort_passes();
+        allocate_transient_images();
+        compiled = true;
+    }
+
+    std::vector<uint32_t> RenderGraph::sort_passes() {
+        // 剔除输出没有被使用的Pass: 光栅化Pass、带有副作用的Pass和写入输出资源的Pass会被保留,被保留Pass读取的资源也会成为需要的资源
+        std::vector<bool> alive(passes.size(), false);
+        std::set<std::string> needed_resources;
+        for (auto &[name, resource] : resources) {
+            if (resource.output) {
+                needed_resources.insert(name);
+            }
+        }
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (uint32_t i = 0; i < passes.size(); i ++) {
+                if (alive[i]) {
+                    continue;
+                }
+                auto &pass = passes[i];
+                bool keep = pass->type == RenderGraphPassType::eRaster || pass->side_effect;
+                for (auto &reference : pass->references) {
+                    keep = keep || (reference.write && needed_resources.count(reference.name) != 0);
+                }
+                if (!keep) {
+                    continue;
+                }
+                alive[i] = true;
+                changed = true;
+                for (auto &reference : pass->references) {
+                    needed_resources.insert(reference.name);
+                }
+            }
+        }
+        for (uint32_t i = 0; i < passes.size(); i ++) {
+            if (!alive[i]) {
+                MCH_DEBUG("Render graph culls pass {}", passes[i]->name)
+            }
+        }
+
+        // 按声明顺序建立依赖: 对同一资源的 写后读 读后写 写后写 都需要保证先后顺序
+        // 每个资源记录最后一次写入的Pass和之后读取的Pass, 只和它们建立依赖
+        struct ResourceAccessors {
+            uint32_t writer = -1u;
+            std::vector<uint32_t> readers;
+        };
+        std::map<std::string, ResourceAccessors> accessors;
+        std::vector<std::set<uint32_t>> successors(passes.size());
+        std::vector<uint32_t> in_degrees(passes.size(), 0);
+        auto add_edge = [&](uint32_t from, uint32_t to) {
+            if (from != -1u && from != to && successors[from].insert(to).second) {
+                in_degrees[to] ++;
+            }
+        };
+        for (uint32_t i = 0; i < passes.size(); i ++) {
+            if (!alive[i]) {
+                continue;
+            }
+            for (auto &reference : passes[i]->references) {
+                auto &accessor = accessors[reference.name];
+                add_edge(accessor.writer, i);
+                if (!reference.write) {
+                    accessor.readers.push_back(i);
+                    continue;
+                }
+                for (auto reader : accessor.readers) {
+                    add_edge(reader, i);
+                }
+                accessor.readers.clear();
+                accessor.writer = i;
+            }
+        }
+
+        // Kahn算法,光栅化Pass需要保持RenderPass开启给后续的RenderLayer使用,所以尽量排在最后
+        uint32_t raster_count = 0;
+        auto priority = [&](uint32_t index) {
+            return passes[index]->type == RenderGraphPassType::eRaster ? index + static_cast<uint32_t>(passes.size()) : index;
+        };
+        auto compare = [&](uint32_t a, uint32_t b) { return priority(a) > priority(b); };
+        std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(compare)> ready(compare);
+        for (uint32_t i = 0; i < passes.size(); i ++) {
+            if (alive[i] && in_degrees[i] == 0) {
+                ready.push(i);
+            }
+        }
+        std::vector<uint32_t> order;
+        bool after_raster = false;
+        auto locked_renderer = renderer.lock();
+        while (!ready.empty()) {
+            auto index = ready.top();
+            ready.pop();
+            order.push_back(index);
+            if (passes[index]->type == RenderGraphPassType::eRaster) {
+                raster_count ++;
+                after_raster = true;
+            } else if (after_raster && locked_renderer->mode != RenderingMode::eDynamicRendering) {
+                // 只有动态渲染可以暂停RenderPass, 在光栅化Pass之间录制其他Pass
+                MCH_ERROR("Render graph pass {} runs after a raster pass, which requires dynamic rendering", passes[index]->name)
+            }
+            for (auto successor : successors[index]) {
+                in_degrees[successor] --;
+                if (in_degrees[successor] == 0) {
+                    ready.push(successor);
+                }
+            }
+        }
+        // 每个光栅化Pass按执行顺序对应Renderer的一个Subpass
+        if (raster_count > locked_renderer->render_pass_builder->subpass_builders.size()) {
+            MCH_ERROR("Render graph has {} raster passes, but the renderer only has {} subpasses", raster_count, locked_renderer->render_pass_builder->subpass_builders.size())
+        }
+        return order;
+    }
+
+    void RenderGraph::allocate_transient_images() {
+        for (uint32_t position = 0; position < execution_order.size(); position ++) {
+            for (auto &reference : passes[execution_order[position]]->references) {
+                auto &lifetime = resources.at(reference.name).lifetime;
+                lifetime.first = std::min(lifetime.first, position);
+                lifetime.second = std::max(lifetime.second, position);
+            }
+        }
+
+        // 生命周期不重叠的临时图片分到同一组,共享一块显存
+        std::vector<std::pair<std::string, Resource *>> transients;
+        for (auto &[name, resource] : resources) {
+            if (resource.transient && resource.lifetime.first != -1u) {
+                transients.push_back(std::make_pair(name, &resource));
+            }
+        }
+        std::sort(transients.begin(), transients.end(), [](auto &a, auto &b) { return a.second->lifetime.first < b.second->lifetime.first; });
+
+        struct AliasGroup {
+            uint32_t end;
+            std::vector<std::pair<std::string, std::unique_ptr<Image>>> images;
+            vk::MemoryRequirements requirements { 0, 1, ~0u };
+        };
+        std::vector<AliasGroup> groups;
+        auto usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+        for (auto &[name, resource] : transients) {
+            auto image = std::make_unique<Image>(resource->width, resource->height, resource->format, usage, vk::SampleCountFlagBits::e1);
+            auto image_requirements = image->get_memory_requirements();
+            uint32_t target = static_cast<uint32_t>(groups.size());
+            for (uint32_t i = 0; i < groups.size(); i ++) {
+                if (groups[i].end < resource->lifetime.first && (groups[i].requirements.memoryTypeBits & image_requirements.memoryTypeBits) != 0) {
+                    target = i;
+                    break;
+                }
+            }
+            if (target == groups.size()) {
+                groups.emplace_back();
+            }
+            auto &group = groups[target];
+            group.end = resource->lifetime.second;
+            group.requirements.size = std::max(group.requirements.size, image_requirements.size);
+            group.requirements.alignment = std::max(group.requirements.alignment, image_requirements.alignment);
+            group.requirements.memoryTypeBits &= image_requirements.memoryTypeBits;
+            resource->alias_group = target;
+            group.images.push_back(std::make_pair(name, std::move(image)));
+        }
+
+        uint64_t aliased_size = 0, allocated_size = 0;
+        for (auto &group : groups) {
+            VmaAllocationCreateInfo alloc_info {};
+            alloc_info.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            VmaAllocation allocation;
+            vmaAllocateMemory(manager->vma_allocator, reinterpret_cast<VkMemoryRequirements *>(&group.requirements), &alloc_info, &allocation, nullptr);
+            allocations.push_back(allocation);
+            for (auto &[name, image] : group.images) {
+                aliased_size += image->get_memory_requirements().size;
+                image->bind_memory(allocation);
+                resources.at(name).image = std::make_shared<StorageImage>(std::move(image));
+            }
+            allocated_size += group.requirements.size;
+        }
+        alias_group_states.assign(groups.size(), { {}, {}, {}, {}, {}, vk::ImageLayout::eUndefined });
+        if (aliased_size != 0) {
+            MCH_DEBUG("Render graph aliases transient images: {} bytes -> {} bytes, saved {} bytes", aliased_size, allocated_size, aliased_size - allocated_size)
+        }
+    }
+
+    void RenderGraph::execute() {
+        if (!compiled) {
+            compile();
+        }
+        auto locked_renderer = renderer.lock();
+        auto command_buffer = locked_renderer->get_command_buffer();
+        bool dynamic_rendering = locked_renderer->mode == RenderingMode::eDynamicRendering;
+        // 临时图片的内容不跨帧保留,每帧第一次使用时从Undefined开始
+        std::set<std::string> touched_transients;
+        bool render_pass_begun = false, render_pass_suspended = false;
+        for (auto index : execution_order) {
+            auto &pass = *passes[index];
+            for (auto &reference : pass.references) {
+                auto &resource = resources.at(reference.name);
+                if (resource.transient && touched_transients.insert(reference.name).second) {
+                    // 需要等待同一块内存上一个使用者的读写
+                    resource.state = alias_group_states[resource.alias_group];
+                    resource.state.layout = vk::ImageLayout::eUndefined;
+                }
+            }
+            // RenderPass内不能录制屏障, 也不能录制计算和光线追踪任务
+            bool barriers_needed = need_barriers(pass);
+            if (render_pass_begun && !render_pass_suspended && (pass.type != RenderGraphPassType::eRaster || barriers_needed)) {
+                if (dynamic_rendering) {
+                    locked_renderer->suspend_render_pass();
+                    render_pass_suspended = true;
+                } else {
+                    MCH_ERROR("Render graph pass {} needs barriers inside the render pass, which requires dynamic rendering", pass.name)
+                }
+            }
+            if (!render_pass_begun || render_pass_suspended || !barriers_needed) {
+                record_barriers(command_buffer, pass);
+            }
+            for (auto &reference : pass.references) {
+                auto &resource = resources.at(reference.name);
+                if (resource.transient) {
+                    alias_group_states[resource.alias_group] = resource.state;
+                }
+            }
+            if (pass.type == RenderGraphPassType::eRaster) {
+                if (!render_pass_begun) {
+                    locked_renderer->begin_render_pass();
+                    render_pass_begun = true;
+                } else if (render_pass_suspended) {
+                    locked_renderer->current_subpass += 1;
+                    locked_renderer->resume_render_pass();
+                    render_pass_suspended = false;
+                } else {
+                    locked_renderer->next_subpass();
+                }
+            }
+            if (pass.callback) {
+                pass.callback();
+            }
+        }
+        // RenderPass需要保持开启给后续的RenderLayer使用
+        if (render_pass_suspended) {
+            locked_renderer->resume_render_pass();
+        }
+    }
+
+    RenderGraph::AccessState RenderGraph::get_required_state(const RenderGraphPass &pass, uint32_t reference_index) {
+        auto &reference = pass.references[reference_index];
+        auto &resource = resources.at(reference.name);
+        AccessState required {};
+        required.stage = get_pass_stage(pass.type);
+        required.layout = vk::ImageLayout::eGeneral;
+        switch (reference.usage) {
+        case RenderGraphResourceUsage::eSampled:
+        case RenderGraphResourceUsage::eStorage:
+            required.access = reference.write ? vk::AccessFlagBits::eShaderWrite : vk::AccessFlagBits::eShaderRead;
+            break;
+        case RenderGraphResourceUsage::eTransfer:
+            required.stage = vk::PipelineStageFlagBits::eTransfer;
+            required.access = reference.write ? vk::AccessFlagBits::eTransferWrite : vk::AccessFlagBits::eTransferRead;
+            required.layout = reference.write ? vk::ImageLayout::eTransferDstOptimal : vk::ImageLayout::eTransferSrcOptimal;
+            break;
+        case RenderGraphResourceUsage::eIndirect:
+            required.stage = vk::PipelineStageFlagBits::eDrawIndirect;
+            required.access = vk::AccessFlagBits::eIndirectCommandRead;
+            break;
+        }
+        if (resource.buffer) {
+            required.layout = resource.state.layout;
+        }
+        return required;
+    }
+
+    bool RenderGraph::need_barrier(const Resource &resource, const AccessState &required, bool write) {
+        auto &state = resource.state;
+        if (resource.image && state.layout != required.layout) {
+            return true;
+        }
+        if (write) {
+            return static_cast<bool>(state.write_stage | state.read_stage);
+        }
+        // 读后读也可能需要屏障: 最后一次写入只对之前读取的阶段可见, 新的阶段或访问需要重新等待写入
+        if (!state.write_stage) {
+            return false;
+        }
+        return (state.visible_stage & required.stage) != required.stage || (state.visible_access & required.access) != required.access;
+    }
+
+    bool RenderGraph::need_barriers(const RenderGraphPass &pass) {
+        for (uint32_t i = 0; i < pass.references.size(); i ++) {
+            auto &resource = resources.at(pass.references[i].name);
+            if (need_barrier(resource, get_required_state(pass, i), pass.references[i].write)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void RenderGraph::record_barriers(vk::CommandBuffer command_buffer, const RenderGraphPass &pass) {
+        vk::PipelineStageFlags src_stage {}, dst_stage {};
+        vk::MemoryBarrier memory_barrier {};
+        std::vector<vk::MemoryBarrier> memory_barriers;
+        std::vector<vk::ImageMemoryBarrier> image_barriers;
+
+        for (uint32_t i = 0; i < pass.references.size(); i ++) {
+            auto &reference = pass.references[i];
+            auto &resource = resources.at(reference.name);
+            auto &state = resource.state;
+            auto required = get_required_state(pass, i);
+
+            if (!need_barrier(resource, required, reference.write)) {
+                if (reference.write) {
+                    state = { required.stage, required.access, {}, {}, {}, required.layout };
+                } else {
+                    state.read_stage |= required.stage;
+                }
+                continue;
+            }
+
+            bool layout_changed = resource.image && state.layout != required.layout;
+            // 写入和布局转换还需要等待之前的读取; 布局转换之后的读取也要等待转换所在的阶段
+            auto wait_stage = state.write_stage | state.visible_stage;
+            if (reference.write || layout_changed) {
+                wait_stage |= state.read_stage;
+            }
+            src_stage |= wait_stage;
+            dst_stage |= required.stage;
+            if (resource.image) {
+                image_barriers.push_back(vk::ImageMemoryBarrier()
+                    .setImage(resource.image->image->image)
+                    .setOldLayout(state.layout)
+                    .setNewLayout(required.layout)
+                    .setSrcAccessMask(state.write_access)
+                    .setDstAccessMask(required.access)
+                    .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                    .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                    .setSubresourceRange({ get_format_aspect(resource.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS }));
+            } else {
+                memory_barrier.srcAccessMask |= state.write_access;
+                memory_barrier.dstAccessMask |= required.access;
+            }
+
+            if (reference.write) {
+                state = { required.stage, required.access, {}, {}, {}, required.layout };
+            } else if (layout_changed) {
+                // 布局转换相当于一次写入, 之前对其他阶段的可见性不再有效
+                state.visible_stage = required.stage;
+                state.visible_access = required.access;
+                state.read_stage = required.stage;
+                state.layout = required.layout;
+            } else {
+                state.visible_stage |= required.stage;
+                state.visible_access |= required.access;
+                state.read_stage |= required.stage;
+            }
+        }
+
+        if (!dst_stage) {
+            return;
+        }
+        if (!src_stage) {
+            src_stage = vk::PipelineStageFlagBits::eTopOfPipe;
+        }
+        if (memory_barrier.dstAccessMask) {
+            memory_barriers.push_back(memory_barrier);
+        }
+        command_buffer.pipelineBarrier(src_stage, dst_stage, vk::DependencyFlags {}, memory_barriers, {}, image_barriers);
+    }
+
+    std::shared_ptr<StorageImage> RenderGraph::get_image(const std::string &name) {
+        if (!compiled) {
+            compile();
+        }
+        return resources.at(name).image;
+    }
+
+    vk::ImageLayout RenderGraph::get_image_layout(const std::string &name) {
+        return resources.at(name).state.layout;
+    }
+
+    RenderGraph::~RenderGraph() {
+        resources.clear();
+        passes.clear();
+        for (auto allocation : allocations) {
+            manager->destroy_later([allocation]() {
+                vmaFreeMemory(manager->vma_allocator, allocation);
+            });
+        }
+        allocations.clear();
+    }
+}
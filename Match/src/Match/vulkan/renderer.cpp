@@ -1,9 +1,19 @@
 #include <Match/vulkan/renderer.hpp>
+#include <Match/vulkan/utils.hpp>
+#include <Match/core/utils.hpp>
+#include <Match/constant.hpp>
 #include "inner.hpp"
+#include <chrono>
+#include <algorithm>
 
 namespace Match {
-    Renderer::Renderer(std::shared_ptr<RenderPassBuilder> builder) : render_pass_builder(builder), resized(false), current_in_flight(0) {
-        render_pass = std::make_unique<RenderPass>(builder);
+    Renderer::Renderer(std::shared_ptr<RenderPassBuilder> builder, RenderingMode mode) : mode(mode), render_pass_builder(builder), resized(false), current_in_flight(0), viewport_set(false), scissor_set(false), in_async_compute(false), frame_begun(false) {
+        if (mode == RenderingMode::eRenderPass) {
+            render_pass = std::make_unique<RenderPass>(builder);
+        } else {
+            // 动态渲染不创建RenderPass, 只需要RenderPassBuilder分析出的Attachment信息
+            builder->build();
+        }
         framebuffer_set = std::make_unique<FrameBufferSet>(*this);
 
         image_available_semaphores.resize(setting.max_in_flight_frame);
@@ -24,6 +34,26 @@ namespace Match {
             in_flight_fences[i] = manager->device->device.createFence(fence_create_info);
             in_flight_submit_infos.emplace_back();
         }
+
+        // 异步计算使用计算队列族的CommandPool, 通过信号量把结果交给图形提交
+        compute_command_pool = std::make_unique<CommandPool>(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, manager->device->compute_family_index);
+        compute_command_buffers = compute_command_pool->allocate_command_buffer(setting.max_in_flight_frame);
+        compute_finished_semaphores.resize(setting.max_in_flight_frame);
+        compute_recorded.resize(setting.max_in_flight_frame, false);
+        for (uint32_t i = 0; i < setting.max_in_flight_frame; i ++) {
+            compute_finished_semaphores[i] = manager->device->device.createSemaphore(semaphore_create_info);
+        }
+
+        // 每一帧4个时间戳: 计算开始, 计算结束, 图形开始, 图形结束
+        auto properties = manager->device->physical_device.getProperties();
+        auto queue_families_properties = manager->device->physical_device.getQueueFamilyProperties();
+        timestamp_period = properties.limits.timestampPeriod;
+        compute_timestamp_supported = queue_families_properties[manager->device->compute_family_index].timestampValidBits > 0;
+        vk::QueryPoolCreateInfo query_pool_create_info {};
+        query_pool_create_info.setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(4 * setting.max_in_flight_frame);
+        timestamp_query_pool = manager->device->device.createQueryPool(query_pool_create_info);
+        manager->device->device.resetQueryPool(timestamp_query_pool, 0, 4 * setting.max_in_flight_frame);
     }
 
     void Renderer::set_resize_flag() {
@@ -35,30 +65,47 @@ namespace Match {
     }
 
     void Renderer::update_resources() {
-        manager->recreate_swapchin();
+        auto start = std::chrono::high_resolution_clock::now();
+        // 旧的交换链和Attachment可能还在被未完成的帧使用, 不等待设备空闲, 而是交给销毁队列等这些帧完成后再销毁
         framebuffer_set.reset();
+        std::shared_ptr<Swapchain> old_swapchain = manager->recreate_swapchin();
+        manager->destroy_later([old_swapchain]() {});
         framebuffer_set = std::make_unique<FrameBufferSet>(*this);
-        for (auto &[id, callback] : callbacks) {
-            callback();
+        if (!callbacks.empty()) {
+            // 回调会销毁并重新绑定用户资源, 只需要等待这个Renderer提交的帧完成
+            vk_check(manager->device->device.waitForFences(in_flight_fences, VK_TRUE, UINT64_MAX));
+            for (auto &[id, callback] : callbacks) {
+                callback();
+            }
         }
+        auto duration = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+        MCH_DEBUG("Recreate renderer resources ({}) took {:.3f} ms", mode == RenderingMode::eRenderPass ? "render pass" : "dynamic rendering", duration)
     }
 
     void Renderer::update_renderpass() {
-        render_pass.reset();
-        render_pass = std::make_unique<RenderPass>(render_pass_builder);
+        if (mode == RenderingMode::eRenderPass) {
+            render_pass.reset();
+            render_pass = std::make_unique<RenderPass>(render_pass_builder);
+        } else {
+            render_pass_builder->build();
+        }
         update_resources();
     }
 
     Renderer::~Renderer() {
         current_graphics_shader_program.reset();
         current_ray_tracing_shader_program.reset();
-        wait_for_destroy();
+        // 异步计算等其他队列上的任务也可能在使用这个Renderer的资源, 需要等待整个设备空闲
+        manager->device->device.waitIdle();
         callbacks.clear();
         for (uint32_t i = 0; i < setting.max_in_flight_frame; i ++) {
             manager->device->device.destroySemaphore(image_available_semaphores[i]);
             manager->device->device.destroySemaphore(render_finished_semaphores[i]);
             manager->device->device.destroyFence(in_flight_fences[i]);
+            manager->device->device.destroySemaphore(compute_finished_semaphores[i]);
         }
+        manager->device->device.destroyQueryPool(timestamp_query_pool);
+        compute_command_pool.reset();
         framebuffer_set.reset();
         render_pass.reset();
         render_pass_builder.reset();
@@ -71,28 +118,45 @@ namespace Match {
 
     void Renderer::acquire_next_image() {
         vk_check(manager->device->device.waitForFences({ in_flight_fences[current_in_flight] }, VK_TRUE, UINT64_MAX));
+        manager->destruction_queue->collect();
+        update_async_compute_timing();
 
-        try {
-            auto result = manager->device->device.acquireNextImageKHR(manager->swapchain->swapchain, UINT64_MAX, image_available_semaphores[current_in_flight], VK_NULL_HANDLE, &index);
-            if (result == vk::Result::eErrorOutOfDateKHR) {
-                update_resources();
-                return;
+        // 窗口大小改变后延迟到下一帧开始时再重建, 多次改变只重建一次
+        if (resized) {
+            resized = false;
+            update_resources();
+        }
+        while (true) {
+            try {
+                auto result = manager->device->device.acquireNextImageKHR(manager->swapchain->swapchain, UINT64_MAX, image_available_semaphores[current_in_flight], VK_NULL_HANDLE, &index);
+                if (result != vk::Result::eErrorOutOfDateKHR) {
+                    break;
+                }
+            } catch (vk::OutOfDateKHRError) {
             }
-        } catch (vk::OutOfDateKHRError) {
             update_resources();
-            return;
         }
 
         manager->device->device.resetFences({ in_flight_fences[current_in_flight] });
 
         current_subpass = 0;
+        viewport_set = false;
+        scissor_set = false;
         current_buffer.reset();
 
         vk::CommandBufferBeginInfo begin_info {};
         current_buffer.begin(begin_info);
+        current_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_query_pool, 4 * current_in_flight + 2);
+        frame_begun = true;
     }
 
     void Renderer::begin_render_pass() {
+        if (mode == RenderingMode::eDynamicRendering) {
+            attachment_layouts.assign(render_pass_builder->final_attachments.size(), vk::ImageLayout::eUndefined);
+            current_subpass = 0;
+            begin_rendering(current_subpass);
+            return;
+        }
         std::vector<vk::ClearValue> clear_values;
         clear_values.reserve(render_pass_builder->attachments.size());
         for (const auto &attachment_description : render_pass_builder->attachments) {
@@ -111,21 +175,209 @@ namespace Match {
     }
 
     void Renderer::end_render_pass() {
+        if (mode == RenderingMode::eDynamicRendering) {
+            end_rendering();
+            return;
+        }
         current_buffer.endRenderPass();
     }
 
+    void Renderer::suspend_render_pass() {
+        // 暂停后可以在RenderPass外录制计算任务(例如根据已绘制的深度生成Hi-Z), 再用resume_render_pass继续绘制
+        // 需要在暂停后保留内容的Attachment不能用add_transient_attachment添加
+        if (mode != RenderingMode::eDynamicRendering) {
+            MCH_ERROR("suspend_render_pass is only supported with dynamic rendering")
+            return;
+        }
+        // 暂停时Attachment保持当前布局, 只在真正结束时转换到finalLayout
+        current_buffer.endRendering();
+    }
+
+    void Renderer::resume_render_pass() {
+        if (mode != RenderingMode::eDynamicRendering) {
+            MCH_ERROR("resume_render_pass is only supported with dynamic rendering")
+            return;
+        }
+        // attachment_layouts保留了暂停前的状态, 已经写入过的Attachment会使用eLoad
+        begin_rendering(current_subpass);
+    }
+
+    vk::Image Renderer::get_attachment_image(uint32_t attachment_idx) {
+        if (attachment_idx == render_pass_builder->get_attachment_index(SWAPCHAIN_IMAGE_ATTACHMENT, true)) {
+            return manager->swapchain->images[index];
+        }
+        return framebuffer_set->attachments[attachment_idx].image->image;
+    }
+
+    vk::ImageView Renderer::get_attachment_image_view(uint32_t attachment_idx) {
+        if (attachment_idx == render_pass_builder->get_attachment_index(SWAPCHAIN_IMAGE_ATTACHMENT, true)) {
+            return manager->swapchain->image_views[index];
+        }
+        return framebuffer_set->attachments[attachment_idx].image_view;
+    }
+
+    void Renderer::begin_rendering(uint32_t subpass_idx) {
+        auto &subpass = *render_pass_builder->subpass_builders[subpass_idx];
+        // 动态渲染没有Subpass, InputAttachment在之前的渲染结束后作为采样图像读取
+        // 着色器中需要使用sampler2D代替subpassInput, 并用bind_input_attachment绑定为CombinedImageSampler
+        for (auto &reference : subpass.input_attachments) {
+            if (!(render_pass_builder->final_usages[reference.attachment] & vk::ImageUsageFlagBits::eSampled)) {
+                MCH_ERROR("Subpass \"{}\": Input attachment {} needs sampled usage with dynamic rendering, don't add it as a transient attachment", subpass.name, reference.attachment)
+            }
+        }
+        bool msaa = runtime_setting->is_msaa_enabled() && !subpass.resolve_attachments.empty();
+
+        // 之后的Subpass还会用到的Attachment需要保存内容
+        auto used_after = [&](uint32_t attachment_idx) {
+            for (uint32_t i = subpass_idx + 1; i < render_pass_builder->subpass_builders.size(); i ++) {
+                auto &next = *render_pass_builder->subpass_builders[i];
+                for (uint32_t j = 0; j < next.output_attachments.size(); j ++) {
+                    if (next.output_attachments[j].attachment == attachment_idx || (msaa && next.resolve_attachments[j].attachment == attachment_idx)) {
+                        return true;
+                    }
+                }
+                if (next.depth_attachment.has_value() && next.depth_attachment->attachment == attachment_idx) {
+                    return true;
+                }
+                for (auto &reference : next.input_attachments) {
+                    if (reference.attachment == attachment_idx) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+
+        // 每个Subpass对应一次vkCmdBeginRendering, Subpass之间用屏障代替SubpassDependency
+        std::vector<vk::ImageMemoryBarrier> barriers;
+        auto transition = [&](uint32_t attachment_idx, vk::ImageLayout layout, vk::ImageAspectFlags aspect) {
+            barriers.push_back(vk::ImageMemoryBarrier()
+                .setImage(get_attachment_image(attachment_idx))
+                .setOldLayout(attachment_layouts[attachment_idx])
+                .setNewLayout(layout)
+                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange({ aspect, 0, 1, 0, 1 }));
+            attachment_layouts[attachment_idx] = layout;
+        };
+        auto load_op = [&](uint32_t attachment_idx, vk::AttachmentLoadOp first_load_op) {
+            return attachment_layouts[attachment_idx] == vk::ImageLayout::eUndefined ? first_load_op : vk::AttachmentLoadOp::eLoad;
+        };
+        auto store_op = [&](uint32_t attachment_idx, vk::AttachmentStoreOp last_store_op) {
+            return used_after(attachment_idx) ? vk::AttachmentStoreOp::eStore : last_store_op;
+        };
+
+        std::vector<vk::RenderingAttachmentInfo> color_attachments;
+        for (uint32_t i = 0; i < subpass.output_attachments.size(); i ++) {
+            auto &reference = subpass.output_attachments[i];
+            auto &description = render_pass_builder->final_attachments[reference.attachment];
+            auto &color_attachment = color_attachments.emplace_back();
+            color_attachment.setImageView(get_attachment_image_view(reference.attachment))
+                .setImageLayout(reference.layout)
+                .setLoadOp(load_op(reference.attachment, description.loadOp))
+                .setStoreOp(store_op(reference.attachment, description.storeOp))
+                .setClearValue(render_pass_builder->attachments[reference.attachment].clear_value);
+            if (msaa) {
+                auto &resolve_reference = subpass.resolve_attachments[i];
+                // 整数格式不能取平均值
+                auto resolve_mode = description.format == vk::Format::eR32G32Uint ? vk::ResolveModeFlagBits::eSampleZero : vk::ResolveModeFlagBits::eAverage;
+                color_attachment.setResolveMode(resolve_mode)
+                    .setResolveImageView(get_attachment_image_view(resolve_reference.attachment))
+                    .setResolveImageLayout(resolve_reference.layout);
+                transition(resolve_reference.attachment, resolve_reference.layout, vk::ImageAspectFlagBits::eColor);
+            }
+            transition(reference.attachment, reference.layout, vk::ImageAspectFlagBits::eColor);
+        }
+
+        vk::RenderingAttachmentInfo depth_attachment {}, stencil_attachment {};
+        bool has_depth = subpass.depth_attachment.has_value(), has_stencil = false;
+        if (has_depth) {
+            auto &reference = subpass.depth_attachment.value();
+            auto &description = render_pass_builder->final_attachments[reference.attachment];
+            has_stencil = has_stencil_component(description.format);
+            depth_attachment.setImageView(get_attachment_image_view(reference.attachment))
+                .setImageLayout(reference.layout)
+                .setLoadOp(load_op(reference.attachment, description.loadOp))
+                .setStoreOp(store_op(reference.attachment, description.storeOp))
+                .setClearValue(render_pass_builder->attachments[reference.attachment].clear_value);
+            stencil_attachment = depth_attachment;
+            stencil_attachment.setLoadOp(load_op(reference.attachment, description.stencilLoadOp))
+                .setStoreOp(store_op(reference.attachment, description.stencilStoreOp));
+            transition(reference.attachment, reference.layout, render_pass_builder->final_aspects[reference.attachment]);
+        }
+
+        for (auto &reference : subpass.input_attachments) {
+            transition(reference.attachment, reference.layout, render_pass_builder->final_aspects[reference.attachment]);
+            barriers.back().setDstAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eInputAttachmentRead);
+        }
+
+        auto stages = vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+        auto dst_stages = subpass.input_attachments.empty() ? stages : stages | vk::PipelineStageFlagBits::eFragmentShader;
+        current_buffer.pipelineBarrier(stages, dst_stages, vk::DependencyFlags {}, {}, {}, barriers);
+
+        vk::RenderingInfo rendering_info {};
+        rendering_info.setRenderArea({
+                { 0, 0 },
+                { runtime_setting->get_window_size().width, runtime_setting->get_window_size().height }
+            })
+            .setLayerCount(1)
+            .setColorAttachments(color_attachments);
+        if (has_depth) {
+            rendering_info.setPDepthAttachment(&depth_attachment);
+        }
+        if (has_stencil) {
+            rendering_info.setPStencilAttachment(&stencil_attachment);
+        }
+        current_buffer.beginRendering(rendering_info);
+    }
+
+    void Renderer::end_rendering() {
+        current_buffer.endRendering();
+
+        // 转换到Attachment描述中的finalLayout, 与RenderPass的行为保持一致
+        std::vector<vk::ImageMemoryBarrier> barriers;
+        for (uint32_t attachment_idx = 0; attachment_idx < attachment_layouts.size(); attachment_idx ++) {
+            auto final_layout = render_pass_builder->final_attachments[attachment_idx].finalLayout;
+            if (attachment_layouts[attachment_idx] == vk::ImageLayout::eUndefined || attachment_layouts[attachment_idx] == final_layout) {
+                continue;
+            }
+            barriers.push_back(vk::ImageMemoryBarrier()
+                .setImage(get_attachment_image(attachment_idx))
+                .setOldLayout(attachment_layouts[attachment_idx])
+                .setNewLayout(final_layout)
+                .setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+                .setDstAccessMask(final_layout == vk::ImageLayout::ePresentSrcKHR ? vk::AccessFlagBits::eNone : vk::AccessFlagBits::eShaderRead)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange({ render_pass_builder->final_aspects[attachment_idx], 0, 1, 0, 1 }));
+            attachment_layouts[attachment_idx] = final_layout;
+        }
+        if (barriers.empty()) {
+            return;
+        }
+        current_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags {}, {}, {}, barriers);
+    }
+
     void Renderer::report_submit_info(const vk::SubmitInfo &submit_info) {
         in_flight_submit_infos[current_in_flight].push_back(submit_info);
     }
 
     void Renderer::present(const std::vector<vk::PipelineStageFlags> &wait_stages, const std::vector<vk::Semaphore> &wait_samaphores) {
+        current_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_query_pool, 4 * current_in_flight + 3);
         current_buffer.end();
+        frame_begun = false;
 
         auto &submit_info = in_flight_submit_infos[current_in_flight].emplace_back();
         auto wait_stages_ = wait_stages;
         wait_stages_.push_back(vk::PipelineStageFlagBits::eColorAttachmentOutput);
         auto wait_samaphores_ = wait_samaphores;
         wait_samaphores_.push_back(image_available_semaphores[current_in_flight]);
+        if (compute_recorded[current_in_flight]) {
+            wait_stages_.push_back(compute_wait_stage);
+            wait_samaphores_.push_back(compute_finished_semaphores[current_in_flight]);
+        }
 
         submit_info.setWaitSemaphores(wait_samaphores_)
             .setWaitDstStageMask(wait_stages_)
@@ -140,13 +392,13 @@ namespace Match {
             .setPResults(nullptr);
         try {
             auto result = manager->device->present_queue.presentKHR(present_info);
-            if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || resized) {
-                update_resources();
-                resized = false;
+            if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR) {
+                resized = true;
             }
         } catch (vk::OutOfDateKHRError) {
-            update_resources();
+            resized = true;
         }
+        manager->destruction_queue->submit_frame();
         current_in_flight = (current_in_flight + 1) % setting.max_in_flight_frame;
         runtime_setting->current_in_flight = current_in_flight;
         current_buffer = command_buffers[current_in_flight];
@@ -186,6 +438,35 @@ namespace Match {
         }
     }
 
+    void Renderer::apply_dynamic_states(const GraphicsShaderProgram &shader_program) {
+        auto &options = shader_program.compile_options;
+        // 绑定静态视口的管线会使之前设置的动态视口失效
+        if (!options.dynamic_viewport_scissor) {
+            viewport_set = false;
+            scissor_set = false;
+        } else {
+            // 没有手动设置时使用窗口大小作为默认视口, 与之前固定在管线中的视口一致
+            auto &size = runtime_setting->get_window_size();
+            if (!viewport_set) {
+                vk::Viewport viewport { 0.0f, static_cast<float>(size.height), static_cast<float>(size.width), -static_cast<float>(size.height), 0.0f, 1.0f };
+                current_buffer.setViewport(0, { viewport });
+            }
+            if (!scissor_set) {
+                vk::Rect2D scissor { { 0, 0 }, { size.width, size.height } };
+                current_buffer.setScissor(0, { scissor });
+            }
+        }
+        // 扩展动态状态先恢复为编译时的设置, 之后可以用set_xxx覆盖
+        if (options.extended_dynamic_state) {
+            current_buffer.setCullMode(transform<vk::CullModeFlags>(options.cull_mode));
+            current_buffer.setFrontFace(transform<vk::FrontFace>(options.front_face));
+            current_buffer.setDepthTestEnable(options.depth_test_enable);
+            current_buffer.setDepthWriteEnable(options.depth_write_enable);
+            current_buffer.setDepthCompareOp(options.depth_compere_op);
+            current_buffer.setPrimitiveTopology(transform<vk::PrimitiveTopology>(options.topology));
+        }
+    }
+
     void Renderer::bind_vertex_buffer(const std::shared_ptr<VertexBuffer> &vertex_buffer, uint32_t binding) {
         current_buffer.bindVertexBuffers(binding, { vertex_buffer->buffer->buffer }, { 0 });
     }
@@ -218,6 +499,7 @@ namespace Match {
             max_depth,
         };
         current_buffer.setViewport(0, { viewport });
+        viewport_set = true;
     }
 
     void Renderer::set_scissor(int x, int y, uint32_t width, uint32_t height) {
@@ -226,6 +508,31 @@ namespace Match {
             { width, height }
         };
         current_buffer.setScissor(0, { scissor });
+        scissor_set = true;
+    }
+
+    void Renderer::set_cull_mode(CullMode mode) {
+        current_buffer.setCullMode(transform<vk::CullModeFlags>(mode));
+    }
+
+    void Renderer::set_front_face(FrontFace mode) {
+        current_buffer.setFrontFace(transform<vk::FrontFace>(mode));
+    }
+
+    void Renderer::set_depth_test_enable(bool enable) {
+        current_buffer.setDepthTestEnable(enable);
+    }
+
+    void Renderer::set_depth_write_enable(bool enable) {
+        current_buffer.setDepthWriteEnable(enable);
+    }
+
+    void Renderer::set_depth_compare_op(vk::CompareOp op) {
+        current_buffer.setDepthCompareOp(op);
+    }
+
+    void Renderer::set_primitive_topology(Topology topology) {
+        current_buffer.setPrimitiveTopology(transform<vk::PrimitiveTopology>(topology));
     }
 
     void Renderer::draw_indexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, uint32_t vertex_offset, uint32_t first_instance) {
@@ -244,6 +551,55 @@ namespace Match {
         current_buffer.drawIndexed(model->index_count, instance_count, model->position.index_buffer_offset, model->position.vertex_buffer_offset, first_instance);
     }
 
+    // draw_count为-1时绘制first_draw之后记录的全部命令, 范围越过缓冲时报错
+    static bool resolve_indirect_draw_count(const IndirectBuffer &indirect_buffer, uint32_t &draw_count, uint32_t first_draw) {
+        if (draw_count == uint32_t(-1)) {
+            if (first_draw > indirect_buffer.draw_count) {
+                MCH_ERROR("Indirect first draw {} is beyond the {} recorded draws", first_draw, indirect_buffer.draw_count)
+                return false;
+            }
+            draw_count = indirect_buffer.draw_count - first_draw;
+        } else if (static_cast<uint64_t>(first_draw) + draw_count > indirect_buffer.max_draw_count) {
+            MCH_ERROR("Indirect draws [{}, {}) exceed the buffer capacity {}", first_draw, static_cast<uint64_t>(first_draw) + draw_count, indirect_buffer.max_draw_count)
+            return false;
+        }
+        return draw_count > 0;
+    }
+
+    void Renderer::draw_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t draw_count, uint32_t first_draw) {
+        if (indirect_buffer->type != IndirectCommandType::eDraw) {
+            MCH_ERROR("draw_indirect needs an indirect buffer of vk::DrawIndirectCommand")
+            return;
+        }
+        if (!resolve_indirect_draw_count(*indirect_buffer, draw_count, first_draw)) {
+            return;
+        }
+        current_buffer.drawIndirect(indirect_buffer->get_buffer(current_in_flight), first_draw * indirect_buffer->stride, draw_count, indirect_buffer->stride);
+    }
+
+    void Renderer::draw_indexed_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t draw_count, uint32_t first_draw) {
+        if (indirect_buffer->type != IndirectCommandType::eDrawIndexed) {
+            MCH_ERROR("draw_indexed_indirect needs an indirect buffer of vk::DrawIndexedIndirectCommand")
+            return;
+        }
+        if (!resolve_indirect_draw_count(*indirect_buffer, draw_count, first_draw)) {
+            return;
+        }
+        current_buffer.drawIndexedIndirect(indirect_buffer->get_buffer(current_in_flight), first_draw * indirect_buffer->stride, draw_count, indirect_buffer->stride);
+    }
+
+    void Renderer::draw_indexed_indirect_count(std::shared_ptr<IndirectBuffer> indirect_buffer, std::shared_ptr<StorageBuffer> count_buffer, uint64_t count_offset, uint32_t max_draw_count) {
+        if (indirect_buffer->type != IndirectCommandType::eDrawIndexed) {
+            MCH_ERROR("draw_indexed_indirect_count needs an indirect buffer of vk::DrawIndexedIndirectCommand")
+            return;
+        }
+        if (max_draw_count == uint32_t(-1)) {
+            max_draw_count = indirect_buffer->max_draw_count;
+        }
+        // 实际绘制数量由GPU写入count_buffer, 例如GPU剔除的结果
+        current_buffer.drawIndexedIndirectCount(indirect_buffer->get_buffer(current_in_flight), 0, count_buffer->get_buffer(current_in_flight), count_offset, max_draw_count, indirect_buffer->stride);
+    }
+
     void Renderer::trace_rays(uint32_t width, uint32_t height, uint32_t depth) {
         if (width == uint32_t(-1)) {
             width = runtime_setting->window_size.width;
@@ -258,7 +614,106 @@ namespace Match {
         current_buffer.dispatch(group_count_x, group_count_y, group_count_z);
     }
 
+    void Renderer::dispatch_indirect(std::shared_ptr<IndirectBuffer> indirect_buffer, uint32_t index) {
+        current_buffer.dispatchIndirect(indirect_buffer->get_buffer(current_in_flight), index * indirect_buffer->stride);
+    }
+
+    void Renderer::memory_barrier(vk::PipelineStageFlags src_stages, vk::AccessFlags src_access, vk::PipelineStageFlags dst_stages, vk::AccessFlags dst_access) {
+        vk::MemoryBarrier barrier {};
+        barrier.setSrcAccessMask(src_access)
+            .setDstAccessMask(dst_access);
+        current_buffer.pipelineBarrier(src_stages, dst_stages, vk::DependencyFlags {}, { barrier }, {}, {});
+    }
+
+    void Renderer::compute_to_compute_barrier() {
+        // 前一个计算Pass的写入对后续计算Pass和间接参数读取可见
+        memory_barrier(
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eDrawIndirect, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eIndirectCommandRead
+        );
+    }
+
+    void Renderer::compute_to_graphics_barrier() {
+        memory_barrier(
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eVertexShader | vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead | vk::AccessFlagBits::eShaderRead
+        );
+    }
+
+    void Renderer::begin_async_compute() {
+        // acquire_next_image会等待这一帧的Fence并重置compute_recorded, 之前录制会覆盖还在执行的计算命令, 图形提交也不会等待它
+        if (!frame_begun) {
+            MCH_ERROR("begin_async_compute must be called after acquire_next_image")
+            return;
+        }
+        if (in_async_compute || compute_recorded[current_in_flight]) {
+            MCH_ERROR("Async compute can only be recorded once per frame")
+            return;
+        }
+        in_async_compute = true;
+        current_buffer = compute_command_buffers[current_in_flight];
+        current_buffer.reset();
+        vk::CommandBufferBeginInfo begin_info {};
+        begin_info.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        current_buffer.begin(begin_info);
+        if (compute_timestamp_supported) {
+            current_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_query_pool, 4 * current_in_flight + 0);
+        }
+    }
+
+    void Renderer::end_async_compute(vk::PipelineStageFlags graphics_wait_stage) {
+        if (!in_async_compute) {
+            MCH_ERROR("end_async_compute called without begin_async_compute")
+            return;
+        }
+        if (compute_timestamp_supported) {
+            current_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_query_pool, 4 * current_in_flight + 1);
+        }
+        current_buffer.end();
+
+        // 计算队列不需要等待, 图形提交在graphics_wait_stage等待计算完成, 其之前的阶段可以和计算重叠执行
+        vk::SubmitInfo submit_info {};
+        submit_info.setCommandBuffers(current_buffer)
+            .setSignalSemaphores(compute_finished_semaphores[current_in_flight]);
+        manager->device->compute_queue.submit(submit_info);
+
+        in_async_compute = false;
+        compute_recorded[current_in_flight] = true;
+        compute_wait_stage = graphics_wait_stage;
+        current_buffer = command_buffers[current_in_flight];
+    }
+
+    void Renderer::update_async_compute_timing() {
+        bool recorded = compute_recorded[current_in_flight];
+        compute_recorded[current_in_flight] = false;
+        uint64_t timestamps[4] = {};
+        auto result = vk::Result::eNotReady;
+        if (recorded && compute_timestamp_supported) {
+            result = manager->device->device.getQueryPoolResults(timestamp_query_pool, 4 * current_in_flight, 4, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        }
+        // 这一帧的fence已经完成, 在主机端重置时间戳供下一次使用
+        manager->device->device.resetQueryPool(timestamp_query_pool, 4 * current_in_flight, 4);
+        if (result != vk::Result::eSuccess) {
+            return;
+        }
+        // 所有队列的时间戳使用同一个时钟, 可以直接比较得到重叠时间
+        float ms_per_tick = timestamp_period / 1000000.0f;
+        auto compute_begin = timestamps[0], compute_end = timestamps[1];
+        auto graphics_begin = timestamps[2], graphics_end = timestamps[3];
+        async_compute_timing.compute_time = static_cast<float>(compute_end - compute_begin) * ms_per_tick;
+        async_compute_timing.graphics_time = static_cast<float>(graphics_end - graphics_begin) * ms_per_tick;
+        auto overlap_begin = std::max(compute_begin, graphics_begin);
+        auto overlap_end = std::min(compute_end, graphics_end);
+        async_compute_timing.overlap_time = overlap_end > overlap_begin ? static_cast<float>(overlap_end - overlap_begin) * ms_per_tick : 0.0f;
+    }
+
     void Renderer::next_subpass() {
+        if (mode == RenderingMode::eDynamicRendering) {
+            current_buffer.endRendering();
+            current_subpass += 1;
+            begin_rendering(current_subpass);
+            return;
+        }
         current_buffer.nextSubpass(vk::SubpassContents::eInline);
         current_subpass += 1;
     }
@@ -10,6 +10,8 @@ namespace Match {
     }
 
     RenderPass::~RenderPass() {
-        manager->device->device.destroyRenderPass(render_pass);
+        manager->destroy_later([render_pass = render_pass]() {
+            manager->device->device.destroyRenderPass(render_pass);
+        });
     }
 }
@@ -1,32 +1,79 @@
 #include <Match/vulkan/resource/buffer.hpp>
+#include <Match/vulkan/utils.hpp>
 #include <Match/core/utils.hpp>
 #include "../inner.hpp"
+#include <algorithm>
 
 namespace Match {
-    Buffer::Buffer(uint64_t size, vk::BufferUsageFlags buffer_usage, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags) : size(size), mapped(false), data_ptr(nullptr) {
+    // 启用异步计算且使用专用计算队列族时, 缓冲在两个队列族之间共享, 碎片整理时创建的新缓冲也要保持一致
+    static vk::BufferCreateInfo create_buffer_create_info(uint64_t size, vk::BufferUsageFlags usage) {
         vk::BufferCreateInfo buffer_create_info {};
-        buffer_create_info.setUsage(buffer_usage)
+        buffer_create_info.setUsage(usage)
             .setSize(size);
+        if (!manager->device->concurrent_family_indices.empty()) {
+            buffer_create_info.setSharingMode(vk::SharingMode::eConcurrent)
+                .setQueueFamilyIndices(manager->device->concurrent_family_indices);
+        }
+        return buffer_create_info;
+    }
+
+    static bool is_defragmentable(vk::BufferUsageFlags usage, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags) {
+        if (usage & vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR) {
+            return false;
+        }
+        if (vma_flags & (VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT)) {
+            return false;
+        }
+        return vma_usage == VMA_MEMORY_USAGE_GPU_ONLY || vma_usage == VMA_MEMORY_USAGE_AUTO || vma_usage == VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+    }
+
+    Buffer::Buffer(uint64_t size, vk::BufferUsageFlags buffer_usage, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags) : size(size), mapped(false), persistent_mapped(false), coherent(false), pinned(false), defragmentable(is_defragmentable(buffer_usage, vma_usage, vma_flags)), data_ptr(nullptr), usage(buffer_usage) {
+        if (defragmentable) {
+            usage |= vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+        }
+        auto buffer_create_info = create_buffer_create_info(size, usage);
         VmaAllocationCreateInfo buffer_alloc_info {};
         buffer_alloc_info.flags = vma_flags;
         buffer_alloc_info.usage = vma_usage;
-        vmaCreateBuffer(manager->vma_allocator, reinterpret_cast<VkBufferCreateInfo *>(&buffer_create_info), &buffer_alloc_info, reinterpret_cast<VkBuffer *>(&buffer), &buffer_allocation, nullptr);
+        buffer_alloc_info.pUserData = static_cast<Defragmentable *>(this);
+        VmaAllocationInfo allocation_info {};
+        vmaCreateBuffer(manager->vma_allocator, reinterpret_cast<VkBufferCreateInfo *>(&buffer_create_info), &buffer_alloc_info, reinterpret_cast<VkBuffer *>(&buffer), &buffer_allocation, &allocation_info);
+
+        VkMemoryPropertyFlags memory_properties;
+        vmaGetAllocationMemoryProperties(manager->vma_allocator, buffer_allocation, &memory_properties);
+        coherent = memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if ((vma_flags & VMA_ALLOCATION_CREATE_MAPPED_BIT) && allocation_info.pMappedData != nullptr) {
+            persistent_mapped = true;
+            mapped = true;
+            data_ptr = allocation_info.pMappedData;
+        }
     }
 
     Buffer::Buffer(Buffer &&rhs) {
         size = rhs.size;
         mapped = rhs.mapped;
+        persistent_mapped = rhs.persistent_mapped;
+        coherent = rhs.coherent;
+        pinned = rhs.pinned;
+        defragmentable = rhs.defragmentable;
         data_ptr = rhs.data_ptr;
+        usage = rhs.usage;
         buffer = rhs.buffer;
         buffer_allocation = rhs.buffer_allocation;
         rhs.size = 0;
         rhs.mapped = false;
+        rhs.persistent_mapped = false;
+        rhs.pinned = false;
         rhs.data_ptr = nullptr;
         rhs.buffer = VK_NULL_HANDLE;
         rhs.buffer_allocation = NULL;
+        if (buffer_allocation != NULL) {
+            vmaSetAllocationUserData(manager->vma_allocator, buffer_allocation, static_cast<Defragmentable *>(this));
+        }
     }
 
     void *Buffer::map() {
+        std::lock_guard<std::mutex> lock(map_mutex);
         if (mapped) {
             return data_ptr;
         }
@@ -36,20 +83,74 @@ namespace Match {
     }
 
     bool Buffer::is_mapped() {
+        std::lock_guard<std::mutex> lock(map_mutex);
         return mapped;
     }
 
     void Buffer::unmap() {
-        if (!mapped) {
+        std::lock_guard<std::mutex> lock(map_mutex);
+        if (!mapped || persistent_mapped) {
             return;
         }
         mapped = false;
         vmaUnmapMemory(manager->vma_allocator, buffer_allocation);
     }
 
+    void Buffer::flush(uint64_t offset, uint64_t size) {
+        if (coherent) {
+            return;
+        }
+        vmaFlushAllocation(manager->vma_allocator, buffer_allocation, offset, size);
+    }
+
+    void Buffer::invalidate(uint64_t offset, uint64_t size) {
+        if (coherent) {
+            return;
+        }
+        vmaInvalidateAllocation(manager->vma_allocator, buffer_allocation, offset, size);
+    }
+
+    bool Buffer::is_movable() {
+        std::lock_guard<std::mutex> lock(map_mutex);
+        return defragmentable && !pinned && !mapped;
+    }
+
+    void Buffer::begin_move(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) {
+        moving_buffer = manager->device->device.createBuffer(create_buffer_create_info(size, usage));
+        vmaBindBufferMemory(manager->vma_allocator, dst_allocation, moving_buffer);
+        vk::BufferCopy copy {};
+        copy.setSrcOffset(0)
+            .setDstOffset(0)
+            .setSize(size);
+        command_buffer.copyBuffer(buffer, moving_buffer, copy);
+        if (usage & vk::BufferUsageFlagBits::eShaderDeviceAddress) {
+            manager->defragmenter->report_moved_address(get_buffer_address(buffer), get_buffer_address(moving_buffer), size);
+        }
+    }
+
+    void Buffer::end_move() {
+        manager->device->device.destroyBuffer(buffer);
+        buffer = moving_buffer;
+        moving_buffer = VK_NULL_HANDLE;
+    }
+
     Buffer::~Buffer() {
         unmap();
-        vmaDestroyBuffer(manager->vma_allocator, buffer, buffer_allocation);
+        if (buffer_allocation == NULL) {
+            return;
+        }
+        // 正在被GPU使用的Buffer不能立即销毁, 交给销毁队列在帧完成后销毁
+        vmaSetAllocationUserData(manager->vma_allocator, buffer_allocation, nullptr);
+        manager->destroy_later([buffer = buffer, allocation = buffer_allocation]() {
+            vmaDestroyBuffer(manager->vma_allocator, buffer, allocation);
+        });
+    }
+
+    ReadbackBuffer::ReadbackBuffer(uint64_t size, vk::BufferUsageFlags additional_usage) : Buffer(size, vk::BufferUsageFlagBits::eTransferDst | additional_usage, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT) {}
+
+    const void *ReadbackBuffer::read(uint64_t offset, uint64_t size) {
+        invalidate(offset, size);
+        return static_cast<const uint8_t *>(data_ptr) + offset;
     }
 
     InFlightBuffer::InFlightBuffer(uint64_t size, vk::BufferUsageFlags buffer_usage, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags) {
@@ -71,34 +172,182 @@ namespace Match {
         in_flight_buffers.clear();
     }
 
-    TwoStageBuffer::TwoStageBuffer(uint64_t size, vk::BufferUsageFlags usage, vk::BufferUsageFlags additional_usage) {
-        staging = std::make_unique<Buffer>(size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_CPU_ONLY, 0);
-        buffer = std::make_unique<Buffer>(size, usage | vk::BufferUsageFlagBits::eTransferDst | additional_usage, VMA_MEMORY_USAGE_GPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+    TwoStageBuffer::TwoStageBuffer(uint64_t size, vk::BufferUsageFlags usage, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) : mode(mode), whole_mapped(false), whole_dirty(false), staging_used(0) {
+        if (mode == BufferUploadMode::eDynamic) {
+            staging = std::make_unique<Buffer>(size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        }
+        buffer = std::make_unique<Buffer>(size, usage | vk::BufferUsageFlagBits::eTransferDst | additional_usage, VMA_MEMORY_USAGE_GPU_ONLY, 0);
     }
 
     void *TwoStageBuffer::map() {
+        if (mode == BufferUploadMode::eStatic && !whole_mapped) {
+            flush();
+            if (buffer->size > StagingBufferPool::chunk_size) {
+                MCH_WARN("Map whole static TwoStageBuffer of {} bytes allocates a staging buffer of the same size, use map_range or write instead", buffer->size)
+            }
+            staging = manager->staging_buffer_pool->acquire(buffer->size);
+            whole_dirty = true;
+        }
+        whole_mapped = true;
         return staging->map();
     }
 
+    void *TwoStageBuffer::map_range(uint64_t offset, uint64_t size) {
+        if (mode == BufferUploadMode::eStatic && !whole_mapped) {
+            return reserve_staging(offset, size);
+        }
+        mark_dirty(offset, size);
+        return static_cast<uint8_t *>(staging->map()) + offset;
+    }
+
+    void TwoStageBuffer::write(uint64_t offset, const void *data, uint64_t size, bool flush_now) {
+        if (mode == BufferUploadMode::eStatic && !whole_mapped) {
+            auto *src = static_cast<const uint8_t *>(data);
+            while (size > 0) {
+                auto write_size = std::min(size, StagingBufferPool::chunk_size);
+                memcpy(reserve_staging(offset, write_size), src, write_size);
+                offset += write_size;
+                src += write_size;
+                size -= write_size;
+            }
+            if (flush_now) {
+                flush();
+            }
+            return;
+        }
+
+        memcpy(static_cast<uint8_t *>(staging->map()) + offset, data, size);
+        mark_dirty(offset, size);
+        if (flush_now) {
+            flush();
+        }
+    }
+
+    uint8_t *TwoStageBuffer::reserve_staging(uint64_t offset, uint64_t size) {
+        if (staging != nullptr && staging_used + size > staging->size) {
+            flush();
+        }
+        if (staging == nullptr) {
+            staging = manager->staging_buffer_pool->acquire(std::max(size, std::min(buffer->size, StagingBufferPool::chunk_size)));
+            staging_used = 0;
+        }
+        pending_copies.emplace_back()
+            .setSrcOffset(staging_used)
+            .setDstOffset(offset)
+            .setSize(size);
+        auto *ptr = static_cast<uint8_t *>(staging->map()) + staging_used;
+        staging_used += size;
+        return ptr;
+    }
+
+    void TwoStageBuffer::release_staging() {
+        if (staging == nullptr) {
+            return;
+        }
+        manager->staging_buffer_pool->release(std::move(staging));
+        staging_used = 0;
+    }
+
+    void TwoStageBuffer::mark_dirty(uint64_t offset, uint64_t size) {
+        if (size == 0) {
+            return;
+        }
+        if (mode == BufferUploadMode::eStatic && !whole_mapped) {
+            // map_range和write已经记录了拷贝区间, 没有映射时标记的区间没有对应的数据
+            MCH_ERROR("Static TwoStageBuffer can only mark dirty range while the whole buffer is mapped, use map_range or write instead")
+            return;
+        }
+        dirty_ranges.emplace_back(offset, std::min(offset + size, buffer->size));
+    }
+
     void TwoStageBuffer::flush() {
+        if (mode == BufferUploadMode::eStatic && !whole_mapped) {
+            if (!pending_copies.empty()) {
+                staging->flush(0, staging_used);
+                auto command_buffer = manager->command_pool->allocate_single_use();
+                command_buffer.copyBuffer(staging->buffer, buffer->buffer, pending_copies);
+                manager->command_pool->free_single_use(command_buffer);
+                pending_copies.clear();
+            }
+            release_staging();
+            return;
+        }
+        if (whole_mapped && (mode == BufferUploadMode::eDynamic || whole_dirty)) {
+            dirty_ranges.clear();
+            dirty_ranges.emplace_back(0, buffer->size);
+        }
+        whole_dirty = false;
+        if (dirty_ranges.empty()) {
+            return;
+        }
+
+        std::sort(dirty_ranges.begin(), dirty_ranges.end());
+        std::vector<std::pair<uint64_t, uint64_t>> merged_ranges;
+        merged_ranges.push_back(dirty_ranges.front());
+        for (auto &range : dirty_ranges) {
+            auto &last = merged_ranges.back();
+            if (range.first <= last.second) {
+                last.second = std::max(last.second, range.second);
+            } else {
+                merged_ranges.push_back(range);
+            }
+        }
+        dirty_ranges.clear();
+
+        auto *ptr = static_cast<uint8_t *>(staging->map());
         auto command_buffer = manager->command_pool->allocate_single_use();
-        vk::BufferCopy copy {};
-        copy.setSrcOffset(0)
-            .setDstOffset(0)
-            .setSize(staging->size);
-        command_buffer.copyBuffer(staging->buffer, buffer->buffer, copy);
+        std::vector<vk::BufferCopy> copies;
+        for (auto &[begin, end] : merged_ranges) {
+            auto size = end - begin;
+            staging->flush(begin, size);
+            if (size <= update_buffer_threshold && begin % 4 == 0 && size % 4 == 0) {
+                command_buffer.updateBuffer(buffer->buffer, begin, size, ptr + begin);
+                continue;
+            }
+            copies.emplace_back()
+                .setSrcOffset(begin)
+                .setDstOffset(begin)
+                .setSize(size);
+        }
+        if (!copies.empty()) {
+            command_buffer.copyBuffer(staging->buffer, buffer->buffer, copies);
+        }
         manager->command_pool->free_single_use(command_buffer);
     }
 
     void TwoStageBuffer::unmap() {
-        staging->unmap();
+        if (mode == BufferUploadMode::eStatic) {
+            // 映射后已经flush过时只拷贝之后标记的区间, 不会再拷贝一遍整个缓冲
+            flush();
+            whole_mapped = false;
+            release_staging();
+            return;
+        }
+        whole_mapped = false;
     }
 
     TwoStageBuffer::~TwoStageBuffer() {
+        if (mode == BufferUploadMode::eStatic && manager->staging_buffer_pool != nullptr) {
+            release_staging();
+        }
         staging.reset();
         buffer.reset();
     }
 
-    VertexBuffer::VertexBuffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage) : TwoStageBuffer(vertex_size * count, vk::BufferUsageFlagBits::eVertexBuffer, additional_usage) {}
-    IndexBuffer::IndexBuffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage) : type(transform<vk::IndexType>(type)), TwoStageBuffer(transform<uint32_t>(type) * count, vk::BufferUsageFlagBits::eIndexBuffer, additional_usage) {}
+    VertexBuffer::VertexBuffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) : TwoStageBuffer(vertex_size * count, vk::BufferUsageFlagBits::eVertexBuffer, additional_usage, mode) {}
+    IndexBuffer::IndexBuffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) : type(transform<vk::IndexType>(type)), TwoStageBuffer(transform<uint32_t>(type) * count, vk::BufferUsageFlagBits::eIndexBuffer, additional_usage, mode) {}
+
+    static uint32_t get_indirect_command_stride(IndirectCommandType type) {
+        switch (type) {
+        case IndirectCommandType::eDraw:
+            return sizeof(vk::DrawIndirectCommand);
+        case IndirectCommandType::eDrawIndexed:
+            return sizeof(vk::DrawIndexedIndirectCommand);
+        case IndirectCommandType::eDispatch:
+            return sizeof(vk::DispatchIndirectCommand);
+        }
+        return 0;
+    }
+
+    IndirectBuffer::IndirectBuffer(IndirectCommandType type, uint32_t max_draw_count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) : TwoStageBuffer(get_indirect_command_stride(type) * std::max(max_draw_count, 1u), vk::BufferUsageFlagBits::eIndirectBuffer, additional_usage, mode), type(type), stride(get_indirect_command_stride(type)), max_draw_count(max_draw_count), draw_count(0) {}
 }
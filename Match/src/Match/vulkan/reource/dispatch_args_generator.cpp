@@ -0,0 +1,77 @@
+#include <Match/vulkan/resource/dispatch_args_generator.hpp>
+#include "../inner.hpp"
+
+namespace Match {
+    static const char *dispatch_args_generator_shader = R"(#version 450
+layout (local_size_x = 1) in;
+
+layout (set = 0, binding = 0) readonly buffer CountBuffer {
+    uint counts[];
+};
+
+layout (set = 0, binding = 1) writeonly buffer ArgsBuffer {
+    uint args[];
+};
+
+layout (push_constant) uniform Constants {
+    uint count_index;
+    uint args_index;
+    uint group_size;
+};
+
+void main() {
+    uint count = counts[count_index];
+    args[args_index * 3 + 0] = (count + group_size - 1) / group_size;
+    args[args_index * 3 + 1] = 1;
+    args[args_index * 3 + 2] = 1;
+}
+)";
+
+    DispatchArgsGenerator::DispatchArgsGenerator(std::shared_ptr<StorageBuffer> count_buffer, std::shared_ptr<IndirectBuffer> args_buffer, uint32_t group_size) : group_size(group_size) {
+        if (args_buffer->type != IndirectCommandType::eDispatch) {
+            MCH_ERROR("DispatchArgsGenerator requires an indirect buffer created with IndirectCommandType::eDispatch")
+        }
+
+        std::string code = dispatch_args_generator_shader;
+        std::vector<char> code_vector(code.begin(), code.end());
+        code_vector.push_back('\0');
+        auto shader = std::make_shared<Shader>("dispatch args generator", code_vector, ShaderStage::eCompute);
+
+        descriptor_set = std::make_shared<DescriptorSet>(std::nullopt);
+        descriptor_set->add_descriptors({
+            { ShaderStage::eCompute, 0, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 1, DescriptorType::eStorageBuffer },
+        }).allocate()
+            .bind_storage_buffer(0, count_buffer)
+            .bind_storage_buffer(1, args_buffer);
+
+        push_constants = std::make_shared<PushConstants>(ShaderStage::eCompute, std::vector<PushConstantInfo> {
+            { "count_index", ConstantType::eUint32 },
+            { "args_index", ConstantType::eUint32 },
+            { "group_size", ConstantType::eUint32 },
+        });
+
+        shader_program = std::make_shared<ComputeShaderProgram>();
+        shader_program->attach_compute_shader(shader)
+            .attach_descriptor_set(descriptor_set)
+            .attach_push_constants(push_constants)
+            .compile();
+    }
+
+    void DispatchArgsGenerator::generate(Renderer &renderer, uint32_t count_index, uint32_t args_index) {
+        // 等待生产者写入数量, 生成参数后再供后续的dispatch_indirect读取
+        renderer.compute_to_compute_barrier();
+        push_constants->push_constant("count_index", count_index);
+        push_constants->push_constant("args_index", args_index);
+        push_constants->push_constant("group_size", group_size);
+        renderer.bind_shader_program(shader_program);
+        renderer.dispatch(1);
+        renderer.compute_to_compute_barrier();
+    }
+
+    DispatchArgsGenerator::~DispatchArgsGenerator() {
+        shader_program.reset();
+        push_constants.reset();
+        descriptor_set.reset();
+    }
+}
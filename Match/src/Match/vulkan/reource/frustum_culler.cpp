@@ -0,0 +1,168 @@
+#include <Match/vulkan/resource/frustum_culler.hpp>
+#include <chrono>
+#include "simd.hpp"
+
+namespace Match {
+    FrustumCuller::FrustumCuller() : object_count(0), bounds_dirty(false) {
+    }
+
+    void FrustumCuller::resize(uint32_t capacity) {
+        // 容量按分组对齐, 最后一个分组末尾的空物体只参与计算, 不会写入结果
+        capacity = (capacity + group_size - 1) / group_size * group_size;
+        for (auto *soa : { &local_center, &local_extent, &world_center, &world_extent }) {
+            soa->x.resize(capacity, 0);
+            soa->y.resize(capacity, 0);
+            soa->z.resize(capacity, 0);
+        }
+        for (auto &transform : transforms) {
+            transform.resize(capacity, 0);
+        }
+        group_dirty.resize(capacity / group_size, 0);
+    }
+
+    uint32_t FrustumCuller::add_object(const glm::vec3 &pos_min, const glm::vec3 &pos_max, const glm::mat4 &transform) {
+        uint32_t object_index = object_count;
+        if (object_index >= local_center.x.size()) {
+            resize(std::max<uint32_t>(group_size, local_center.x.size() * 2));
+        }
+        object_count ++;
+        auto center = (pos_min + pos_max) * 0.5f;
+        auto extent = (pos_max - pos_min) * 0.5f;
+        local_center.x[object_index] = center.x;
+        local_center.y[object_index] = center.y;
+        local_center.z[object_index] = center.z;
+        local_extent.x[object_index] = extent.x;
+        local_extent.y[object_index] = extent.y;
+        local_extent.z[object_index] = extent.z;
+        set_transform(object_index, transform);
+        return object_index;
+    }
+
+    uint32_t FrustumCuller::add_object(std::shared_ptr<const Mesh> mesh, const glm::mat4 &transform) {
+        return add_object(mesh->pos_min, mesh->pos_max, transform);
+    }
+
+    uint32_t FrustumCuller::add_object(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform) {
+        return add_object(primitive->pos_min, primitive->pos_max, transform);
+    }
+
+    std::vector<uint32_t> FrustumCuller::add_model(std::shared_ptr<const Model> model, const glm::mat4 &transform) {
+        std::vector<uint32_t> object_indices;
+        object_indices.reserve(model->meshes.size());
+        for (auto &[name, mesh] : model->meshes) {
+            object_indices.push_back(add_object(mesh, transform));
+        }
+        return object_indices;
+    }
+
+    void FrustumCuller::set_transform(uint32_t object_index, const glm::mat4 &transform) {
+        for (uint32_t row = 0; row < 3; row ++) {
+            for (uint32_t column = 0; column < 4; column ++) {
+                transforms[row * 4 + column][object_index] = transform[column][row];
+            }
+        }
+        group_dirty[object_index / group_size] = 1;
+        bounds_dirty = true;
+    }
+
+    void FrustumCuller::update_bounds() {
+        stats.updated_count = 0;
+        if (!bounds_dirty) {
+            stats.update_time = 0;
+            return;
+        }
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint32_t group = 0; group < group_dirty.size(); group ++) {
+            if (group_dirty[group] == 0) {
+                continue;
+            }
+            group_dirty[group] = 0;
+            stats.updated_count += group_size;
+            for (uint32_t offset = group * group_size; offset < (group + 1) * group_size; offset += simd_width) {
+                SimdFloat center[3] = { simd_load(&local_center.x[offset]), simd_load(&local_center.y[offset]), simd_load(&local_center.z[offset]) };
+                SimdFloat extent[3] = { simd_load(&local_extent.x[offset]), simd_load(&local_extent.y[offset]), simd_load(&local_extent.z[offset]) };
+                SimdFloat result_center[3], result_extent[3];
+                // 中心点直接变换, 半长取矩阵元素的绝对值变换, 得到包住旋转后包围盒的AABB
+                for (uint32_t row = 0; row < 3; row ++) {
+                    auto m0 = simd_load(&transforms[row * 4 + 0][offset]);
+                    auto m1 = simd_load(&transforms[row * 4 + 1][offset]);
+                    auto m2 = simd_load(&transforms[row * 4 + 2][offset]);
+                    auto m3 = simd_load(&transforms[row * 4 + 3][offset]);
+                    result_center[row] = simd_add(simd_add(simd_mul(m0, center[0]), simd_mul(m1, center[1])), simd_add(simd_mul(m2, center[2]), m3));
+                    result_extent[row] = simd_add(simd_add(simd_mul(simd_abs(m0), extent[0]), simd_mul(simd_abs(m1), extent[1])), simd_mul(simd_abs(m2), extent[2]));
+                }
+                simd_store(&world_center.x[offset], result_center[0]);
+                simd_store(&world_center.y[offset], result_center[1]);
+                simd_store(&world_center.z[offset], result_center[2]);
+                simd_store(&world_extent.x[offset], result_extent[0]);
+                simd_store(&world_extent.y[offset], result_extent[1]);
+                simd_store(&world_extent.z[offset], result_extent[2]);
+            }
+        }
+        stats.updated_count = std::min(stats.updated_count, object_count);
+        bounds_dirty = false;
+        stats.update_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void FrustumCuller::cull(const glm::mat4 &view_project) {
+        update_bounds();
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // 从裁剪空间提取视锥的6个平面, 深度范围为[0, 1]
+        auto m = glm::transpose(view_project);
+        glm::vec4 planes[6] = {
+            m[3] + m[0], m[3] - m[0],
+            m[3] + m[1], m[3] - m[1],
+            m[2], m[3] - m[2],
+        };
+        SimdFloat plane_normal[6][3], plane_abs_normal[6][3], plane_distance[6];
+        for (uint32_t i = 0; i < 6; i ++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+            for (uint32_t axis = 0; axis < 3; axis ++) {
+                plane_normal[i][axis] = simd_set(planes[i][axis]);
+                plane_abs_normal[i][axis] = simd_set(std::abs(planes[i][axis]));
+            }
+            plane_distance[i] = simd_set(planes[i].w);
+        }
+
+        visibility.resize(object_count);
+        visible_objects.clear();
+        auto zero = simd_set(0);
+        for (uint32_t offset = 0; offset < object_count; offset += simd_width) {
+            SimdFloat center[3] = { simd_load(&world_center.x[offset]), simd_load(&world_center.y[offset]), simd_load(&world_center.z[offset]) };
+            SimdFloat extent[3] = { simd_load(&world_extent.x[offset]), simd_load(&world_extent.y[offset]), simd_load(&world_extent.z[offset]) };
+            // 包围盒在任意一个平面的外侧就不可见
+            auto inside = simd_ge(zero, zero);
+            for (uint32_t i = 0; i < 6; i ++) {
+                auto distance = simd_add(
+                    simd_add(simd_mul(plane_normal[i][0], center[0]), simd_mul(plane_normal[i][1], center[1])),
+                    simd_add(simd_mul(plane_normal[i][2], center[2]), plane_distance[i])
+                );
+                auto radius = simd_add(
+                    simd_add(simd_mul(plane_abs_normal[i][0], extent[0]), simd_mul(plane_abs_normal[i][1], extent[1])),
+                    simd_mul(plane_abs_normal[i][2], extent[2])
+                );
+                inside = simd_and(inside, simd_ge(simd_add(distance, radius), zero));
+            }
+            uint32_t mask = simd_mask_bits(inside);
+            uint32_t lane_count = std::min(simd_width, object_count - offset);
+            for (uint32_t lane = 0; lane < lane_count; lane ++) {
+                uint8_t visible = (mask >> lane) & 1;
+                visibility[offset + lane] = visible;
+                if (visible) {
+                    visible_objects.push_back(offset + lane);
+                }
+            }
+        }
+
+        stats.object_count = object_count;
+        stats.visible_count = visible_objects.size();
+        stats.culled_count = object_count - stats.visible_count;
+        stats.cull_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    FrustumCuller::~FrustumCuller() {
+        visible_objects.clear();
+        visibility.clear();
+    }
+}
@@ -0,0 +1,297 @@
+#include <Match/vulkan/resource/gltf_animator.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "simd.hpp"
+#include "../inner.hpp"
+
+namespace Match {
+    namespace {
+        using Clock = std::chrono::high_resolution_clock;
+
+        // 循环播放
+        inline float wrap_time(float time, float duration) {
+            return duration > 0 ? std::fmod(std::fmod(time, duration) + duration, duration) : 0;
+        }
+    }
+
+    GLTFAnimator::GLTFAnimator(std::shared_ptr<GLTFScene> scene, uint32_t animation_index, uint32_t thread_count) : scene(scene), start_time(0), duration(0), track_count(0), weight_count(0) {
+        uint32_t pool_thread_count = manager->thread_pool->get_thread_count();
+        this->thread_count = thread_count == 0 ? pool_thread_count : std::min(thread_count, pool_thread_count);
+        thread_scratches.resize(this->thread_count);
+
+        node_count = scene->get_node_count();
+        weight_offsets.resize(node_count);
+        for (uint32_t i = 0; i < node_count; i ++) {
+            weight_offsets[i] = weight_count;
+            weight_count += scene->node_weights[i].size();
+        }
+
+        if (animation_index >= scene->animations.size()) {
+            MCH_ERROR("Animation {} out of range {}", animation_index, scene->animations.size())
+            return;
+        }
+        auto &animation = scene->animations[animation_index];
+        start_time = animation.start_time;
+        duration = animation.end_time - animation.start_time;
+
+        // 所有采样器的关键帧连续存放, 多条轨道可以共享同一个采样器
+        std::vector<uint32_t> sampler_key_offsets, sampler_value_offsets;
+        for (auto &sampler : animation.samplers) {
+            sampler_key_offsets.push_back(key_times.size());
+            sampler_value_offsets.push_back(key_values.size());
+            key_times.insert(key_times.end(), sampler.inputs.begin(), sampler.inputs.end());
+            key_values.insert(key_values.end(), sampler.outputs.begin(), sampler.outputs.end());
+        }
+        auto add_track = [&](std::vector<Track> &tracks, const GLTFAnimationChannel &channel, uint32_t component_offset) {
+            auto &sampler = animation.samplers[channel.sampler];
+            tracks.push_back({
+                .node = channel.node,
+                .path = channel.path,
+                .interpolation = sampler.interpolation,
+                .key_offset = sampler_key_offsets[channel.sampler],
+                .key_count = static_cast<uint32_t>(sampler.inputs.size()),
+                .value_offset = sampler_value_offsets[channel.sampler],
+                .stride = sampler.component_count,
+                .component_offset = component_offset,
+                .cache_index = track_count ++,
+            });
+        };
+        for (auto &channel : animation.channels) {
+            auto &sampler = animation.samplers[channel.sampler];
+            if (sampler.inputs.empty() || sampler.component_count == 0) {
+                continue;
+            }
+            switch (channel.path) {
+            case GLTFAnimationPath::eTranslation:
+            case GLTFAnimationPath::eScale:
+                if (sampler.component_count >= 3) {
+                    add_track(vec3_tracks, channel, 0);
+                }
+                break;
+            case GLTFAnimationPath::eRotation:
+                if (sampler.component_count >= 4) {
+                    add_track(quat_tracks, channel, 0);
+                }
+                break;
+            case GLTFAnimationPath::eWeights:
+                for (uint32_t i = 0; i < std::min<uint32_t>(sampler.component_count, scene->node_weights[channel.node].size()); i ++) {
+                    add_track(scalar_tracks, channel, i);
+                }
+                break;
+            }
+        }
+        stats.track_count = track_count;
+        MCH_DEBUG("GLTF animator {}: {} tracks, {} threads, {} kernels", animation.name, track_count, this->thread_count, simd_name)
+    }
+
+    uint32_t GLTFAnimator::add_instance(float time) {
+        uint32_t instance_index = times.size();
+        times.push_back(wrap_time(time, duration));
+        cached_keys.resize(cached_keys.size() + track_count, 0);
+        // 没有动画的节点保持静止姿态
+        translations.insert(translations.end(), scene->node_translations.begin(), scene->node_translations.end());
+        rotations.insert(rotations.end(), scene->node_rotations.begin(), scene->node_rotations.end());
+        scales.insert(scales.end(), scene->node_scales.begin(), scene->node_scales.end());
+        for (auto &node_weights : scene->node_weights) {
+            weights.insert(weights.end(), node_weights.begin(), node_weights.end());
+        }
+        stats.instance_count = times.size();
+        return instance_index;
+    }
+
+    void GLTFAnimator::set_time(uint32_t instance_index, float time) {
+        times[instance_index] = wrap_time(time, duration);
+    }
+
+    void GLTFAnimator::advance(float delta_time) {
+        for (auto &time : times) {
+            time = wrap_time(time + delta_time, duration);
+        }
+    }
+
+    uint32_t GLTFAnimator::find_key(const Track &track, float time, uint32_t &cached_key) const {
+        const float *key_time = &key_times[track.key_offset];
+        uint32_t key = cached_key;
+        if (key >= track.key_count || key_time[key] > time) {
+            // 时间倒退(如循环播放)时重新二分查找
+            key = std::upper_bound(key_time, key_time + track.key_count, time) - key_time;
+            key = key == 0 ? 0 : key - 1;
+        } else {
+            while (key + 1 < track.key_count && key_time[key + 1] <= time) {
+                key ++;
+            }
+        }
+        cached_key = key;
+        return key;
+    }
+
+    template <uint32_t component_count>
+    void GLTFAnimator::evaluate_tracks(const std::vector<Track> &tracks, uint32_t instance_begin, uint32_t instance_end, EvaluateScratch &scratch) {
+        uint32_t lane_count = (instance_end - instance_begin) * tracks.size();
+        if (lane_count == 0) {
+            return;
+        }
+        uint32_t padded_lane_count = (lane_count + simd_width - 1) / simd_width * simd_width;
+        for (uint32_t i = 0; i < 4; i ++) {
+            scratch.coefficients[i].resize(padded_lane_count);
+            std::fill(scratch.coefficients[i].begin() + lane_count, scratch.coefficients[i].end(), 0.0f);
+            for (uint32_t component = 0; component < component_count; component ++) {
+                scratch.values[i][component].resize(padded_lane_count, 0);
+            }
+        }
+        for (uint32_t component = 0; component < component_count; component ++) {
+            scratch.results[component].resize(padded_lane_count);
+        }
+
+        // 每个通道为4个关键帧元素的加权和: 阶跃和线性插值只使用前后两个值, 三次样条为Hermite基函数
+        uint32_t lane = 0;
+        for (uint32_t instance = instance_begin; instance < instance_end; instance ++) {
+            float time = start_time + times[instance];
+            uint32_t *instance_cached_keys = &cached_keys[instance * track_count];
+            for (auto &track : tracks) {
+                const float *key_time = &key_times[track.key_offset];
+                uint32_t prev = find_key(track, time, instance_cached_keys[track.cache_index]);
+                uint32_t next = std::min(prev + 1, track.key_count - 1);
+                float delta = key_time[next] - key_time[prev];
+                float t = delta > 0 ? std::clamp((time - key_time[prev]) / delta, 0.0f, 1.0f) : 0.0f;
+
+                // 三次样条的每个关键帧依次为入切线, 值, 出切线
+                bool cubic_spline = track.interpolation == GLTFInterpolation::eCubicSpline;
+                auto element = [&](uint32_t key, uint32_t element_index) {
+                    return &key_values[track.value_offset + (key * (cubic_spline ? 3 : 1) + element_index) * track.stride + track.component_offset];
+                };
+                const float *sources[4];
+                float coefficients[4];
+                if (cubic_spline) {
+                    float t2 = t * t, t3 = t2 * t;
+                    sources[0] = element(prev, 1);
+                    sources[1] = element(prev, 2);
+                    sources[2] = element(next, 1);
+                    sources[3] = element(next, 0);
+                    coefficients[0] = 2 * t3 - 3 * t2 + 1;
+                    coefficients[1] = (t3 - 2 * t2 + t) * delta;
+                    coefficients[2] = -2 * t3 + 3 * t2;
+                    coefficients[3] = (t3 - t2) * delta;
+                } else {
+                    if (track.interpolation == GLTFInterpolation::eStep) {
+                        t = 0;
+                    }
+                    sources[0] = sources[1] = element(prev, 0);
+                    sources[2] = sources[3] = element(next, 0);
+                    coefficients[0] = 1 - t;
+                    coefficients[1] = 0;
+                    coefficients[2] = t;
+                    coefficients[3] = 0;
+                    if constexpr (component_count == 4) {
+                        // 四元数沿最短路径插值, 归一化后即为nlerp
+                        float dot = sources[0][0] * sources[2][0] + sources[0][1] * sources[2][1] + sources[0][2] * sources[2][2] + sources[0][3] * sources[2][3];
+                        if (dot < 0) {
+                            coefficients[2] = -t;
+                        }
+                    }
+                }
+                for (uint32_t i = 0; i < 4; i ++) {
+                    scratch.coefficients[i][lane] = coefficients[i];
+                    for (uint32_t component = 0; component < component_count; component ++) {
+                        scratch.values[i][component][lane] = sources[i][component];
+                    }
+                }
+                lane ++;
+            }
+        }
+
+        for (uint32_t offset = 0; offset < padded_lane_count; offset += simd_width) {
+            SimdFloat coefficient[4] = {
+                simd_load(&scratch.coefficients[0][offset]), simd_load(&scratch.coefficients[1][offset]),
+                simd_load(&scratch.coefficients[2][offset]), simd_load(&scratch.coefficients[3][offset]),
+            };
+            SimdFloat result[component_count];
+            for (uint32_t component = 0; component < component_count; component ++) {
+                result[component] = simd_add(
+                    simd_add(simd_mul(coefficient[0], simd_load(&scratch.values[0][component][offset])), simd_mul(coefficient[1], simd_load(&scratch.values[1][component][offset]))),
+                    simd_add(simd_mul(coefficient[2], simd_load(&scratch.values[2][component][offset])), simd_mul(coefficient[3], simd_load(&scratch.values[3][component][offset])))
+                );
+            }
+            if constexpr (component_count == 4) {
+                auto length_squared = simd_add(simd_add(simd_mul(result[0], result[0]), simd_mul(result[1], result[1])), simd_add(simd_mul(result[2], result[2]), simd_mul(result[3], result[3])));
+                // 对齐补齐的通道长度为0, 不会写回
+                auto inverse_length = simd_div(simd_set(1), simd_sqrt(simd_max(length_squared, simd_set(1e-12f))));
+                for (uint32_t component = 0; component < 4; component ++) {
+                    result[component] = simd_mul(result[component], inverse_length);
+                }
+            }
+            for (uint32_t component = 0; component < component_count; component ++) {
+                simd_store(&scratch.results[component][offset], result[component]);
+            }
+        }
+
+        lane = 0;
+        for (uint32_t instance = instance_begin; instance < instance_end; instance ++) {
+            for (auto &track : tracks) {
+                if constexpr (component_count == 3) {
+                    glm::vec3 value(scratch.results[0][lane], scratch.results[1][lane], scratch.results[2][lane]);
+                    if (track.path == GLTFAnimationPath::eTranslation) {
+                        translations[instance * node_count + track.node] = value;
+                    } else {
+                        scales[instance * node_count + track.node] = value;
+                    }
+                } else if constexpr (component_count == 4) {
+                    // glTF中四元数按xyzw存储
+                    rotations[instance * node_count + track.node] = glm::quat(scratch.results[3][lane], scratch.results[0][lane], scratch.results[1][lane], scratch.results[2][lane]);
+                } else {
+                    weights[instance * weight_count + weight_offsets[track.node] + track.component_offset] = scratch.results[0][lane];
+                }
+                lane ++;
+            }
+        }
+    }
+
+    void GLTFAnimator::evaluate_instances(uint32_t instance_begin, uint32_t instance_end, EvaluateScratch &scratch) {
+        evaluate_tracks<3>(vec3_tracks, instance_begin, instance_end, scratch);
+        evaluate_tracks<4>(quat_tracks, instance_begin, instance_end, scratch);
+        evaluate_tracks<1>(scalar_tracks, instance_begin, instance_end, scratch);
+    }
+
+    void GLTFAnimator::evaluate() {
+        auto start = Clock::now();
+        uint32_t instance_count = times.size();
+        uint32_t task_count = (instance_count + instance_batch_size - 1) / instance_batch_size;
+        // 线程序号小于thread_count, 每个线程使用自己的临时数据
+        manager->thread_pool->parallel_for(task_count, [&](uint32_t task_idx, uint32_t thread_idx) {
+            uint32_t instance_begin = task_idx * instance_batch_size;
+            evaluate_instances(instance_begin, std::min(instance_begin + instance_batch_size, instance_count), thread_scratches[thread_idx]);
+        }, thread_count);
+        stats.instance_count = instance_count;
+        stats.lane_count = instance_count * (vec3_tracks.size() + quat_tracks.size() + scalar_tracks.size());
+        stats.evaluate_time = std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - start).count();
+    }
+
+    void GLTFAnimator::apply_to_scene(uint32_t instance_index) {
+        for (auto &track : vec3_tracks) {
+            if (track.path == GLTFAnimationPath::eTranslation) {
+                scene->set_node_translation(track.node, get_translation(instance_index, track.node));
+            } else {
+                scene->set_node_scale(track.node, get_scale(instance_index, track.node));
+            }
+        }
+        for (auto &track : quat_tracks) {
+            scene->set_node_rotation(track.node, get_rotation(instance_index, track.node));
+        }
+        for (auto &track : scalar_tracks) {
+            scene->node_weights[track.node][track.component_offset] = get_weights(instance_index, track.node)[track.component_offset];
+        }
+    }
+
+    const char *GLTFAnimator::get_simd_name() {
+        return simd_name;
+    }
+
+    GLTFAnimator::~GLTFAnimator() {
+        thread_scratches.clear();
+        key_values.clear();
+        key_times.clear();
+        scene.reset();
+    }
+}
@@ -1,10 +1,135 @@
 #include <Match/vulkan/resource/gltf_scene.hpp>
 #include <Match/vulkan/descriptor_resource/spec_texture.hpp>
 #include <Match/vulkan/descriptor_resource/descriptor_set.hpp>
+#include <Match/vulkan/utils.hpp>
+#include <Match/core/setting.hpp>
+#include <Match/core/utils.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include "../inner.hpp"
 
 namespace Match {
-    GLTFScene::GLTFScene(const std::string &filename, const std::vector<std::string> &load_attributes) {
+    using Clock = std::chrono::high_resolution_clock;
+
+    static float elapsed_milliseconds(Clock::time_point start) {
+        return std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - start).count();
+    }
+
+    // accessor中每个元素的字节数
+    static uint32_t get_element_size(const tinygltf::Accessor &accessor) {
+        uint32_t size = 0;
+        switch (accessor.componentType) {
+        case TINYGLTF_COMPONENT_TYPE_DOUBLE:
+            size = sizeof(double);
+            break;
+        case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        case TINYGLTF_COMPONENT_TYPE_INT:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+            size = sizeof(uint32_t);
+            break;
+        case TINYGLTF_COMPONENT_TYPE_SHORT:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+            size = sizeof(uint16_t);
+            break;
+        case TINYGLTF_COMPONENT_TYPE_BYTE:
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+            size = sizeof(uint8_t);
+            break;
+        }
+        switch(accessor.type) {
+        case TINYGLTF_TYPE_SCALAR:
+            break;
+        case TINYGLTF_TYPE_VEC2:
+            size *= 2;
+            break;
+        case TINYGLTF_TYPE_VEC3:
+            size *= 3;
+            break;
+        case TINYGLTF_TYPE_VEC4:
+            size *= 4;
+            break;
+        case TINYGLTF_TYPE_MAT2:
+            size *= 4;
+            break;
+        case TINYGLTF_TYPE_MAT3:
+            size *= 9;
+            break;
+        case TINYGLTF_TYPE_MAT4:
+            size *= 16;
+            break;
+        default:
+            MCH_WARN("Unsupported accessor.type {} {} {}", accessor.type, __FILE__, __LINE__)
+        }
+        return size;
+    }
+    template <class Type>
+    static float read_component(const uint8_t *ptr) {
+        Type value;
+        memcpy(&value, ptr, sizeof(Type));
+        return static_cast<float>(value);
+    }
+
+    // 读取accessor的所有元素, 按componentType和normalized转换为float, 支持交错存储的bufferView
+    static std::vector<float> read_accessor_floats(const GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Accessor &accessor) {
+        uint32_t component_count = tinygltf::GetNumComponentsInType(accessor.type);
+        std::vector<float> result(accessor.count * component_count, 0);
+        if (accessor.sparse.isSparse) {
+            MCH_WARN("Unsupported Sparse Accessor")
+        }
+        if (accessor.bufferView < 0) {
+            return result;
+        }
+        const auto &buffer_view = gltf_model.bufferViews[accessor.bufferView];
+        uint32_t component_size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        uint32_t stride = accessor.ByteStride(buffer_view);
+        const auto *data = scene.get_accessor_data(gltf_model, accessor);
+        for (size_t i = 0; i < accessor.count; i ++) {
+            for (uint32_t component = 0; component < component_count; component ++) {
+                const auto *ptr = data + i * stride + component * component_size;
+                float value = 0;
+                switch (accessor.componentType) {
+                case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                    value = read_component<float>(ptr);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                    value = read_component<uint32_t>(ptr);
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                    value = read_component<uint16_t>(ptr);
+                    value = accessor.normalized ? value / 65535.0f : value;
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_SHORT:
+                    value = read_component<int16_t>(ptr);
+                    value = accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                    value = read_component<uint8_t>(ptr);
+                    value = accessor.normalized ? value / 255.0f : value;
+                    break;
+                case TINYGLTF_COMPONENT_TYPE_BYTE:
+                    value = read_component<int8_t>(ptr);
+                    value = accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+                    break;
+                default:
+                    MCH_WARN("Unsupported accessor.componentType {}", accessor.componentType)
+                }
+                result[i * component_count + component] = value;
+            }
+        }
+        return result;
+    }
+
+    GLTFScene::GLTFScene(const std::string &filename, const std::vector<std::string> &load_attributes, uint32_t thread_count, GLTFBufferLocation buffer_location) : buffer_location(buffer_location) {
+        // 在共享线程池中执行, 线程数不超过线程池的线程数
+        uint32_t pool_thread_count = manager->thread_pool->get_thread_count();
+        thread_count = thread_count == 0 ? pool_thread_count : std::min(thread_count, pool_thread_count);
+        load_stats.thread_count = thread_count;
+        auto start = Clock::now();
+
         tinygltf::TinyGLTF loader;
         tinygltf::Model gltf_model;
         std::string err, warn;
@@ -12,12 +137,34 @@ namespace Match {
         size_t pos = filename.find_last_of('/');
         path = filename.substr(0, pos);
 
+        // 解析时只保存图片编码后的数据, 之后在多个线程中解码
+        std::vector<std::vector<uint8_t>> encoded_images;
+        loader.SetImageLoader([](tinygltf::Image *image, const int image_index, std::string *err, std::string *warn, int req_width, int req_height, const unsigned char *bytes, int size, void *user_data) {
+            auto &encoded_images = *static_cast<std::vector<std::vector<uint8_t>> *>(user_data);
+            if (image_index < 0) {
+                return true;
+            }
+            if (encoded_images.size() <= static_cast<size_t>(image_index)) {
+                encoded_images.resize(image_index + 1);
+            }
+            encoded_images[image_index].assign(bytes, bytes + size);
+            return true;
+        }, &encoded_images);
+
         auto filetype = filename.substr(filename.find_last_of('.') + 1);
         bool ret = false;
+        // 映射的GLB文件在构造结束前一直有效, 图元和动画数据直接从中读取
+        std::unique_ptr<MappedFile> mapped_file;
+        std::map<uint32_t, std::pair<const uint8_t *, uint64_t>> mapped_images;
         if (filetype == "gltf") {
             ret = loader.LoadASCIIFromFile(&gltf_model, &err, &warn, filename);
         } else if (filetype == "glb") {
-            ret = loader.LoadBinaryFromFile(&gltf_model, &err, &warn, filename);
+            mapped_file = std::make_unique<MappedFile>(filename);
+            if (mapped_file->is_mapped()) {
+                ret = load_mapped_glb(loader, gltf_model, err, warn, *mapped_file, mapped_images);
+            } else {
+                ret = loader.LoadBinaryFromFile(&gltf_model, &err, &warn, filename);
+            }
         } else {
             MCH_ERROR("Unknown GLTF Filetype {}", filename)
         }
@@ -36,53 +183,532 @@ namespace Match {
         for (auto &extension : gltf_model.extensionsRequired) {
             MCH_INFO("GLTFScene Required {} extension", extension)
         }
+        if (buffer_datas.empty()) {
+            for (auto &buffer : gltf_model.buffers) {
+                buffer_datas.push_back(buffer.data.data());
+            }
+        }
+        load_stats.parse_time = elapsed_milliseconds(start);
 
-        load_images(gltf_model);
+        auto image_start = Clock::now();
+        encoded_images.resize(gltf_model.images.size());
+        std::vector<std::pair<const uint8_t *, uint64_t>> image_datas;
+        for (uint32_t i = 0; i < gltf_model.images.size(); i ++) {
+            auto mapped_image_iter = mapped_images.find(i);
+            if (mapped_image_iter != mapped_images.end()) {
+                image_datas.push_back(mapped_image_iter->second);
+            } else {
+                image_datas.emplace_back(encoded_images[i].data(), encoded_images[i].size());
+            }
+        }
+        load_images(gltf_model, image_datas, thread_count);
+        encoded_images.clear();
+        load_stats.image_time = elapsed_milliseconds(image_start);
         load_materials(gltf_model);
-        material_buffer = std::make_shared<Buffer>(materials.size() * sizeof(GLTFMaterial), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-        memcpy(material_buffer->map(), materials.data(), material_buffer->size);
-        material_buffer->unmap();
+        material_buffer = create_storage_buffer(materials.size() * sizeof(GLTFMaterial));
+        update_materials();
 
+        auto primitive_start = Clock::now();
         for (auto &gltf_mesh : gltf_model.meshes) {
-            meshes.push_back(std::make_shared<GLTFMesh>(*this, gltf_model, gltf_mesh, load_attributes));
-        }
-
-        for (auto &[attribute_name, data] : attribute_datas) {
-            attribute_buffer[attribute_name] = std::make_shared<Buffer>(data.size(), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-            memcpy(attribute_buffer[attribute_name]->map(), data.data(), data.size());
-            attribute_buffer[attribute_name]->unmap();
+            meshes.push_back(std::make_shared<GLTFMesh>(*this, gltf_model, gltf_mesh));
         }
+        load_primitive_datas(gltf_model, load_attributes, thread_count);
+        load_stats.primitive_time = elapsed_milliseconds(primitive_start);
 
         auto gltf_default_scene = gltf_model.scenes[std::max(0, gltf_model.defaultScene)];
 
+        node_index_map.resize(gltf_model.nodes.size(), -1);
         for (uint32_t gltf_node_index : gltf_default_scene.nodes) {
-            auto node = std::make_shared<GLTFNode>(*this, gltf_model, gltf_node_index, nullptr);
-            all_node_references.push_back(node.get());
-            nodes.push_back(std::move(node));
+            nodes.push_back(std::make_shared<GLTFNode>(*this, gltf_model, gltf_node_index, nullptr));
         }
-    }
 
-    void GLTFScene::enumerate_primitives(std::function<void(GLTFNode *, std::shared_ptr<GLTFPrimitive>)> func) {
         for (auto *node : all_node_references) {
             if (node->mesh.get() == nullptr) {
                 continue;
             }
             for (auto &primitive : node->mesh->primitives) {
-                func(node, primitive);
+                primitive_references.push_back({ node, primitive, nullptr });
             }
         }
+        load_mesh_instances(gltf_model);
+
+        load_skins(gltf_model);
+        load_animations(gltf_model);
+        create_deformed_primitives();
+        update_instance_transforms();
+        buffer_datas.clear();
+
+        load_stats.total_time = elapsed_milliseconds(start);
+        MCH_INFO("Load GLTFScene {} with {} threads: parse {:.2f} ms, {} images {:.2f} ms, {} primitives {:.2f} ms, total {:.2f} ms", filename, thread_count, load_stats.parse_time, load_stats.image_count, load_stats.image_time, load_stats.primitive_count, load_stats.primitive_time, load_stats.total_time)
     }
 
-    void GLTFScene::load_images(const tinygltf::Model &gltf_model) {
-        for (auto &gltf_image : gltf_model.images) {
-            if (gltf_image.uri.empty()) {
-                MCH_WARN("Unsupported Image Format")
+    void GLTFScene::load_primitive_datas(const tinygltf::Model &gltf_model, const std::vector<std::string> &load_attributes, uint32_t thread_count) {
+        // 第一遍: 按图元顺序计算每个图元在各个数组中的偏移
+        uint32_t vertex_count = 0, index_count = 0, skin_vertex_count = 0, morph_delta_count = 0;
+        std::vector<uint64_t> attribute_sizes(load_attributes.size(), 0);
+        for (auto &task : primitive_load_tasks) {
+            auto *primitive = task.primitive;
+            auto &gltf_primitive = *task.gltf_primitive;
+            primitive->primitive_instance_data.first_vertex = vertex_count;
+            primitive->primitive_instance_data.first_index = index_count;
+            vertex_count += primitive->vertex_count;
+            index_count += primitive->index_count;
+            if (gltf_primitive.attributes.find("JOINTS_0") != gltf_primitive.attributes.end() && gltf_primitive.attributes.find("WEIGHTS_0") != gltf_primitive.attributes.end()) {
+                primitive->skin_vertex_offset = skin_vertex_count;
+                skin_vertex_count += primitive->vertex_count;
+            }
+            primitive->morph_delta_offset = morph_delta_count;
+            morph_delta_count += primitive->morph_target_count * primitive->vertex_count;
+            task.attribute_offsets.resize(load_attributes.size());
+            for (uint32_t i = 0; i < load_attributes.size(); i ++) {
+                task.attribute_offsets[i] = attribute_sizes[i];
+                auto attribute_iter = gltf_primitive.attributes.find(load_attributes[i]);
+                if (attribute_iter == gltf_primitive.attributes.end()) {
+                    MCH_ERROR("Attribute {} Not Found", load_attributes[i])
+                    continue;
+                }
+                const auto &accessor = gltf_model.accessors[attribute_iter->second];
+                attribute_sizes[i] += accessor.count * get_element_size(accessor);
+            }
+        }
+
+        // 第二遍: 预先分配好所有数组, 各个图元并行写入自己的区间
+        positions.resize(vertex_count);
+        indices.resize(index_count);
+        skin_joints.resize(skin_vertex_count);
+        skin_weights.resize(skin_vertex_count);
+        morph_deltas.resize(morph_delta_count, glm::vec3(0));
+        // 属性直接写入映射的缓冲中, 不在内存中保留副本
+        std::vector<uint8_t *> attribute_ptrs;
+        for (uint32_t i = 0; i < load_attributes.size(); i ++) {
+            auto buffer = create_storage_buffer(attribute_sizes[i]);
+            attribute_buffer[load_attributes[i]] = buffer;
+            attribute_ptrs.push_back(static_cast<uint8_t *>(map_storage_buffer(buffer)));
+        }
+        manager->thread_pool->parallel_for(primitive_load_tasks.size(), [&](uint32_t task_idx, uint32_t) {
+            auto &task = primitive_load_tasks[task_idx];
+            task.primitive->load_data(gltf_model, *task.gltf_primitive, load_attributes, attribute_ptrs, task.attribute_offsets);
+        }, thread_count);
+        // eDeviceLocal时在这里将暂存缓冲一次性拷贝到显存
+        for (auto &attribute_name : load_attributes) {
+            unmap_storage_buffer(attribute_buffer.at(attribute_name));
+        }
+
+        load_stats.primitive_count = primitive_load_tasks.size();
+        load_stats.vertex_count = vertex_count;
+        load_stats.index_count = index_count;
+        primitive_load_tasks.clear();
+    }
+
+    void GLTFScene::enumerate_primitives(std::function<void(GLTFNode *, std::shared_ptr<GLTFPrimitive>)> func) {
+        for (auto &reference : primitive_references) {
+            func(reference.node, reference.primitive);
+        }
+    }
+
+    void GLTFScene::enumerate_deformed_primitives(std::function<void(GLTFNode *, std::shared_ptr<GLTFDeformedPrimitive>)> func) {
+        for (auto &deformed_primitive : deformed_primitives) {
+            func(deformed_primitive->node, deformed_primitive);
+        }
+    }
+
+    void GLTFScene::enumerate_ray_tracing_models(std::function<void(GLTFNode *, std::shared_ptr<GLTFPrimitive>, std::shared_ptr<RayTracingModel>)> func) {
+        for (auto &reference : primitive_references) {
+            if (reference.deformed_primitive.get() != nullptr) {
+                func(reference.node, reference.primitive, reference.deformed_primitive);
+            } else {
+                func(reference.node, reference.primitive, reference.primitive);
+            }
+        }
+    }
+
+    void GLTFScene::load_skins(const tinygltf::Model &gltf_model) {
+        for (auto &gltf_skin : gltf_model.skins) {
+            auto &skin = skins.emplace_back();
+            skin.name = gltf_skin.name;
+            for (auto gltf_joint : gltf_skin.joints) {
+                if (node_index_map[gltf_joint] < 0) {
+                    MCH_WARN("Skin {} joint {} is not in the default scene", skin.name, gltf_joint)
+                    skin.joints.push_back(0);
+                    continue;
+                }
+                skin.joints.push_back(node_index_map[gltf_joint]);
+            }
+            skin.inverse_bind_matrices.resize(skin.joints.size(), glm::mat4(1));
+            if (gltf_skin.inverseBindMatrices > -1) {
+                auto matrices = read_accessor_floats(*this, gltf_model, gltf_model.accessors[gltf_skin.inverseBindMatrices]);
+                for (uint32_t i = 0; i < skin.joints.size() && (i + 1) * 16 <= matrices.size(); i ++) {
+                    skin.inverse_bind_matrices[i] = glm::make_mat4(&matrices[i * 16]);
+                }
+            }
+        }
+    }
+
+    void GLTFScene::load_animations(const tinygltf::Model &gltf_model) {
+        for (auto &gltf_animation : gltf_model.animations) {
+            auto &animation = animations.emplace_back();
+            animation.name = gltf_animation.name;
+            animation.start_time = std::numeric_limits<float>::max();
+            animation.end_time = std::numeric_limits<float>::lowest();
+            for (auto &gltf_sampler : gltf_animation.samplers) {
+                auto &sampler = animation.samplers.emplace_back();
+                if (gltf_sampler.interpolation == "STEP") {
+                    sampler.interpolation = GLTFInterpolation::eStep;
+                } else if (gltf_sampler.interpolation == "CUBICSPLINE") {
+                    sampler.interpolation = GLTFInterpolation::eCubicSpline;
+                }
+                sampler.inputs = read_accessor_floats(*this, gltf_model, gltf_model.accessors[gltf_sampler.input]);
+                sampler.outputs = read_accessor_floats(*this, gltf_model, gltf_model.accessors[gltf_sampler.output]);
+                // weights通道的每个关键帧包含所有变形目标的权重, 不能直接使用accessor的类型
+                uint32_t element_count = sampler.inputs.size() * (sampler.interpolation == GLTFInterpolation::eCubicSpline ? 3 : 1);
+                sampler.component_count = element_count == 0 ? 0 : sampler.outputs.size() / element_count;
+                if (!sampler.inputs.empty()) {
+                    animation.start_time = std::min(animation.start_time, sampler.inputs.front());
+                    animation.end_time = std::max(animation.end_time, sampler.inputs.back());
+                }
+            }
+            if (animation.start_time > animation.end_time) {
+                animation.start_time = animation.end_time = 0;
+            }
+            for (auto &gltf_channel : gltf_animation.channels) {
+                if (gltf_channel.target_node < 0 || node_index_map[gltf_channel.target_node] < 0) {
+                    continue;
+                }
+                auto &channel = animation.channels.emplace_back();
+                channel.sampler = gltf_channel.sampler;
+                channel.node = node_index_map[gltf_channel.target_node];
+                if (gltf_channel.target_path == "translation") {
+                    channel.path = GLTFAnimationPath::eTranslation;
+                } else if (gltf_channel.target_path == "rotation") {
+                    channel.path = GLTFAnimationPath::eRotation;
+                } else if (gltf_channel.target_path == "scale") {
+                    channel.path = GLTFAnimationPath::eScale;
+                } else if (gltf_channel.target_path == "weights") {
+                    channel.path = GLTFAnimationPath::eWeights;
+                } else {
+                    MCH_WARN("Unsupported Animation Path {}", gltf_channel.target_path)
+                    animation.channels.pop_back();
+                }
+            }
+            MCH_DEBUG("Load Animation {}: {} channels, {} - {}s", animation.name, animation.channels.size(), animation.start_time, animation.end_time)
+        }
+    }
+
+    void GLTFScene::create_deformed_primitives() {
+        for (auto &reference : primitive_references) {
+            auto *node = reference.node;
+            auto &primitive = reference.primitive;
+            bool skinned = node->skin > -1 && primitive->skin_vertex_offset > -1;
+            if (!skinned && primitive->morph_target_count == 0) {
+                continue;
+            }
+            if (node->get_instance_count() > 1) {
+                MCH_WARN("Node {} with {} instances is deformed once, all instances share the same pose", node->name, node->get_instance_count())
+            }
+            auto deformed_primitive = std::make_shared<GLTFDeformedPrimitive>(node, primitive, deformed_vertex_count);
+            deformed_vertex_count += primitive->vertex_count;
+            if (skinned) {
+                deformed_primitive->joint_matrix_offset = deformed_joint_count;
+                deformed_primitive->joint_count = skins[node->skin].joints.size();
+                deformed_joint_count += deformed_primitive->joint_count;
+            }
+            deformed_primitive->morph_weight_offset = deformed_morph_weight_count;
+            deformed_morph_weight_count += primitive->morph_target_count;
+            reference.deformed_primitive = deformed_primitive;
+            deformed_primitives.push_back(std::move(deformed_primitive));
+        }
+        if (deformed_primitives.empty()) {
+            return;
+        }
+
+        // 初始内容为静止姿态
+        std::vector<glm::vec3> rest_positions;
+        rest_positions.reserve(deformed_vertex_count);
+        for (auto &deformed_primitive : deformed_primitives) {
+            auto begin = positions.begin() + deformed_primitive->primitive->primitive_instance_data.first_vertex;
+            rest_positions.insert(rest_positions.end(), begin, begin + deformed_primitive->primitive->vertex_count);
+        }
+        vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        if (setting.enable_ray_tracing) {
+            usage |= vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress;
+        }
+        deformed_vertex_buffer = std::make_shared<VertexBuffer>(sizeof(glm::vec3), deformed_vertex_count, usage, BufferUploadMode::eStatic);
+        deformed_vertex_buffer->upload_data_from_vector(rest_positions);
+        // 光线追踪通过设备地址读取变形后的顶点, 碎片整理移动缓冲后重新映射地址
+        if (setting.enable_ray_tracing) {
+            deformed_vertex_address = get_buffer_address(deformed_vertex_buffer->buffer->buffer);
+            moved_callback_id = manager->defragmenter->register_resource_moved_callback([this]() {
+                deformed_vertex_address = manager->defragmenter->remap_address(deformed_vertex_address);
+            });
+        }
+        MCH_DEBUG("Create {} deformed primitives: {} vertices, {} joints, {} morph weights", deformed_primitives.size(), deformed_vertex_count, deformed_joint_count, deformed_morph_weight_count)
+    }
+
+    void GLTFScene::set_node_translation(uint32_t node_index, const glm::vec3 &translation) {
+        node_translations[node_index] = translation;
+        node_dirty[node_index] = 1;
+        world_matrices_dirty = true;
+    }
+
+    void GLTFScene::set_node_rotation(uint32_t node_index, const glm::quat &rotation) {
+        node_rotations[node_index] = rotation;
+        node_dirty[node_index] = 1;
+        world_matrices_dirty = true;
+    }
+
+    void GLTFScene::set_node_scale(uint32_t node_index, const glm::vec3 &scale) {
+        node_scales[node_index] = scale;
+        node_dirty[node_index] = 1;
+        world_matrices_dirty = true;
+    }
+
+    uint32_t GLTFScene::update_world_matrices() {
+        if (!world_matrices_dirty) {
+            return 0;
+        }
+        uint32_t updated_count = 0;
+        uint32_t node_index = 0;
+        while (node_index < all_node_references.size()) {
+            if (node_dirty[node_index] == 0) {
+                node_index ++;
                 continue;
             }
+            // 父节点总在前面, 已经是最新的, 整个子树按顺序重新计算一遍
+            uint32_t subtree_end = node_subtree_ends[node_index];
+            for (uint32_t i = node_index; i < subtree_end; i ++) {
+                if (node_dirty[i] != 0) {
+                    local_matrices[i] = glm::translate(glm::mat4(1), node_translations[i]) * glm::mat4(node_rotations[i]) * glm::scale(glm::mat4(1), node_scales[i]) * node_matrices[i];
+                    node_dirty[i] = 0;
+                }
+                world_matrices[i] = node_parents[i] < 0 ? local_matrices[i] : world_matrices[node_parents[i]] * local_matrices[i];
+            }
+            updated_count += subtree_end - node_index;
+            node_index = subtree_end;
+        }
+        world_matrices_dirty = false;
+        instance_transforms_dirty = true;
+        return updated_count;
+    }
 
-            std::string::size_type pos;
-            if ((pos = gltf_image.uri.find_last_of('.')) != std::string::npos) {
-                if (gltf_image.uri.substr(pos + 1) == "ktx") {
+    const glm::mat4 &GLTFScene::get_world_matrix(uint32_t node_index) {
+        update_world_matrices();
+        return world_matrices[node_index];
+    }
+
+    void GLTFScene::update_instance_transforms() {
+        update_world_matrices();
+        if (!instance_transforms_dirty || instance_matrices.empty()) {
+            return;
+        }
+        auto *ptr = static_cast<glm::mat4 *>(instance_transform_buffer->map());
+        for (uint32_t i = 0; i < instance_matrices.size(); i ++) {
+            ptr[i] = world_matrices[instance_nodes[i]] * instance_matrices[i];
+        }
+        instance_transform_buffer->flush();
+        instance_transform_buffer->unmap();
+        instance_transforms_dirty = false;
+    }
+
+    void GLTFScene::load_mesh_instances(const tinygltf::Model &gltf_model) {
+        std::vector<int32_t> gltf_node_indices(all_node_references.size(), -1);
+        for (uint32_t gltf_node_index = 0; gltf_node_index < node_index_map.size(); gltf_node_index ++) {
+            if (node_index_map[gltf_node_index] >= 0) {
+                gltf_node_indices[node_index_map[gltf_node_index]] = gltf_node_index;
+            }
+        }
+        uint32_t instanced_node_count = 0;
+        for (auto *node : all_node_references) {
+            if (node->mesh.get() == nullptr) {
+                continue;
+            }
+            node->first_instance = instance_matrices.size();
+            node->instance_count = 1;
+            const auto &gltf_node = gltf_model.nodes[gltf_node_indices[node->index]];
+            auto extension_iter = gltf_node.extensions.find("EXT_mesh_gpu_instancing");
+            if (extension_iter == gltf_node.extensions.end() || !extension_iter->second.Has("attributes")) {
+                instance_matrices.emplace_back(1);
+                instance_nodes.push_back(node->index);
+                continue;
+            }
+            // 依次为TRANSLATION, ROTATION, SCALE, ROTATION可以是归一化的整数
+            const char *attribute_names[3] = { "TRANSLATION", "ROTATION", "SCALE" };
+            std::vector<float> attributes[3];
+            uint32_t instance_count = std::numeric_limits<uint32_t>::max();
+            const auto &gltf_attributes = extension_iter->second.Get("attributes");
+            for (uint32_t i = 0; i < 3; i ++) {
+                if (!gltf_attributes.Has(attribute_names[i])) {
+                    continue;
+                }
+                const auto &accessor = gltf_model.accessors[gltf_attributes.Get(attribute_names[i]).GetNumberAsInt()];
+                attributes[i] = read_accessor_floats(*this, gltf_model, accessor);
+                instance_count = std::min<uint32_t>(instance_count, accessor.count);
+            }
+            if (instance_count == std::numeric_limits<uint32_t>::max()) {
+                instance_count = 1;
+            }
+            node->instance_count = instance_count;
+            instanced_node_count ++;
+            for (uint32_t i = 0; i < instance_count; i ++) {
+                auto &matrix = instance_matrices.emplace_back(1);
+                if (!attributes[0].empty()) {
+                    matrix = glm::translate(matrix, glm::make_vec3(&attributes[0][i * 3]));
+                }
+                if (!attributes[1].empty()) {
+                    matrix *= glm::mat4(glm::normalize(glm::quat(attributes[1][i * 4 + 3], attributes[1][i * 4], attributes[1][i * 4 + 1], attributes[1][i * 4 + 2])));
+                }
+                if (!attributes[2].empty()) {
+                    matrix = glm::scale(matrix, glm::make_vec3(&attributes[2][i * 3]));
+                }
+                instance_nodes.push_back(node->index);
+            }
+        }
+        if (instance_matrices.empty()) {
+            return;
+        }
+        instance_transform_buffer = std::make_shared<VertexBuffer>(sizeof(glm::mat4), instance_matrices.size(), vk::BufferUsageFlagBits::eStorageBuffer);
+        instance_transforms_dirty = true;
+        if (instanced_node_count > 0) {
+            MCH_INFO("Load {} EXT_mesh_gpu_instancing instances from {} nodes", instance_matrices.size(), instanced_node_count)
+        }
+    }
+
+    bool GLTFScene::load_mapped_glb(tinygltf::TinyGLTF &loader, tinygltf::Model &gltf_model, std::string &err, std::string &warn, const MappedFile &mapped_file, std::map<uint32_t, std::pair<const uint8_t *, uint64_t>> &mapped_images) {
+        // GLB: 12字节文件头, JSON块, 可选的BIN块, 每个块前有8字节的长度和类型
+        const uint8_t *data = mapped_file.get_data();
+        uint64_t size = mapped_file.get_size();
+        auto read_uint32 = [&](uint64_t offset) {
+            uint32_t value;
+            memcpy(&value, data + offset, sizeof(uint32_t));
+            return value;
+        };
+        if (size < 20 || read_uint32(0) != 0x46546C67 || read_uint32(4) != 2 || read_uint32(8) > size) {
+            err = "Invalid GLB header";
+            return false;
+        }
+        uint64_t length = read_uint32(8);
+        uint64_t json_length = read_uint32(12);
+        if (read_uint32(16) != 0x4E4F534A || 20 + json_length > length) {
+            err = "Invalid GLB JSON chunk";
+            return false;
+        }
+        const char *json_data = reinterpret_cast<const char *>(data + 20);
+        const uint8_t *binary_data = nullptr;
+        uint64_t binary_length = 0;
+        uint64_t binary_chunk_offset = 20 + json_length;
+        if (binary_chunk_offset + 8 <= length && read_uint32(binary_chunk_offset + 4) == 0x004E4942) {
+            binary_length = read_uint32(binary_chunk_offset);
+            binary_data = data + binary_chunk_offset + 8;
+            if (binary_chunk_offset + 8 + binary_length > length) {
+                err = "Invalid GLB BIN chunk";
+                return false;
+            }
+        }
+
+        auto json = nlohmann::json::parse(json_data, json_data + json_length, nullptr, false);
+        if (json.is_discarded()) {
+            err = "Invalid GLB JSON";
+            return false;
+        }
+
+        // BIN块对应第一个没有uri的buffer, 替换为1字节的data uri, tinygltf只会复制这1字节
+        bool binary_buffer = binary_data != nullptr && json.contains("buffers") && !json["buffers"].empty() && !json["buffers"][0].contains("uri");
+        if (binary_buffer) {
+            if (json["buffers"][0].value("byteLength", uint64_t(0)) > binary_length) {
+                err = "Invalid GLB buffer byteLength";
+                return false;
+            }
+            // 替换后tinygltf只能看到1字节的buffer, 无法再检查bufferView的范围, 在这里检查所有指向BIN块的bufferView
+            uint64_t buffer_view_count = json.contains("bufferViews") ? json["bufferViews"].size() : 0;
+            for (uint64_t i = 0; i < buffer_view_count; i ++) {
+                const auto &buffer_view = json["bufferViews"][i];
+                if (buffer_view.value("buffer", 0) != 0) {
+                    continue;
+                }
+                uint64_t byte_offset = buffer_view.value("byteOffset", uint64_t(0));
+                uint64_t byte_length = buffer_view.value("byteLength", uint64_t(0));
+                if (byte_offset > binary_length || byte_length > binary_length - byte_offset) {
+                    err = "Invalid GLB bufferView " + std::to_string(i) + ": out of BIN chunk range";
+                    return false;
+                }
+            }
+            json["buffers"][0] = nlohmann::json::object({ { "byteLength", 1 }, { "uri", "data:application/octet-stream;base64,AA==" } });
+            // tinygltf会从buffer中读取bufferView中的图片, 将这些图片指向1字节的占位bufferView, 编码后的数据之后直接从映射中读取
+            if (json.contains("images")) {
+                int32_t placeholder_buffer_view = -1;
+                auto &images = json["images"];
+                for (uint32_t i = 0; i < images.size(); i ++) {
+                    if (!images[i].contains("bufferView")) {
+                        continue;
+                    }
+                    uint32_t buffer_view_index = images[i]["bufferView"].get<uint32_t>();
+                    if (buffer_view_index >= buffer_view_count) {
+                        err = "Invalid GLB image " + std::to_string(i) + ": bufferView out of range";
+                        return false;
+                    }
+                    const auto &buffer_view = json["bufferViews"][buffer_view_index];
+                    if (buffer_view.value("buffer", 0) != 0) {
+                        continue;
+                    }
+                    mapped_images[i] = { binary_data + buffer_view.value("byteOffset", uint64_t(0)), buffer_view.value("byteLength", uint64_t(0)) };
+                    if (placeholder_buffer_view < 0) {
+                        placeholder_buffer_view = json["bufferViews"].size();
+                        json["bufferViews"].push_back(nlohmann::json::object({ { "buffer", 0 }, { "byteOffset", 0 }, { "byteLength", 1 } }));
+                    }
+                    images[i]["bufferView"] = placeholder_buffer_view;
+                }
+            }
+        }
+
+        auto json_string = json.dump();
+        if (!loader.LoadASCIIFromString(&gltf_model, &err, &warn, json_string.c_str(), json_string.size(), path)) {
+            return false;
+        }
+        for (auto &buffer : gltf_model.buffers) {
+            buffer_datas.push_back(buffer.data.data());
+        }
+        if (binary_buffer) {
+            buffer_datas[0] = binary_data;
+        }
+        MCH_DEBUG("Map GLB: {} bytes JSON, {} bytes BIN, {} images in BIN", json_length, binary_length, mapped_images.size())
+        return true;
+    }
+
+    void GLTFScene::load_images(const tinygltf::Model &gltf_model, const std::vector<std::pair<const uint8_t *, uint64_t>> &encoded_images, uint32_t thread_count) {
+        struct DecodedImage {
+            stbi_uc *pixels = nullptr;
+            int width = 0;
+            int height = 0;
+            bool ktx = false;
+        };
+        // 解码在多个线程中进行, 创建纹理需要提交命令, 按顺序在当前线程中进行
+        // 每批只解码与线程数相同的图片, 创建纹理后立即释放, 内存中最多保留一批解码后的像素
+        uint32_t worker_count = std::min(thread_count == 0 ? manager->thread_pool->get_thread_count() : thread_count, manager->thread_pool->get_thread_count());
+        uint32_t batch_size = std::max(worker_count, 1u);
+        std::vector<DecodedImage> decoded_images(batch_size);
+        for (uint32_t batch_start = 0; batch_start < gltf_model.images.size(); batch_start += batch_size) {
+            uint32_t batch_count = std::min<uint32_t>(batch_size, gltf_model.images.size() - batch_start);
+            manager->thread_pool->parallel_for(batch_count, [&](uint32_t batch_idx, uint32_t) {
+                uint32_t image_idx = batch_start + batch_idx;
+                auto &gltf_image = gltf_model.images[image_idx];
+                auto &decoded_image = decoded_images[batch_idx];
+                decoded_image = {};
+                std::string::size_type pos;
+                if ((pos = gltf_image.uri.find_last_of('.')) != std::string::npos && gltf_image.uri.substr(pos + 1) == "ktx") {
+                    decoded_image.ktx = true;
+                    return;
+                }
+                auto [encoded_data, encoded_size] = encoded_images[image_idx];
+                if (encoded_size == 0) {
+                    return;
+                }
+                int channels = 0;
+                decoded_image.pixels = stbi_load_from_memory(encoded_data, encoded_size, &decoded_image.width, &decoded_image.height, &channels, STBI_rgb_alpha);
+            }, thread_count);
+
+            for (uint32_t batch_idx = 0; batch_idx < batch_count; batch_idx ++) {
+                auto &gltf_image = gltf_model.images[batch_start + batch_idx];
+                auto &decoded_image = decoded_images[batch_idx];
+                if (decoded_image.ktx) {
 #if defined (MATCH_WITH_KTX)
                     textures.push_back(std::make_shared<Match::KtxTexture>(path + "/" + gltf_image.uri));
 #else
@@ -90,34 +716,56 @@ namespace Match {
 #endif
                     continue;
                 }
-            }
-
-            std::vector<uint8_t> rgba;
-            const uint8_t *rgba_readonly = nullptr;
-            if (gltf_image.component == 3) {
-                rgba.resize(gltf_image.width * gltf_image.height * 4);
-                auto *rgb = gltf_image.image.data();
-                auto *ptr = rgba.data();
-                for (uint32_t i = 0; i < gltf_image.width * gltf_image.height; i ++) {
-                    ptr[0] = rgb[0];
-                    ptr[1] = rgb[1];
-                    ptr[2] = rgb[2];
-                    ptr[3] = 0;
-                    ptr += 4;
-                    rgb += 3;
+                if (decoded_image.pixels == nullptr) {
+                    MCH_WARN("Unsupported Image Format {}", gltf_image.uri)
+                    continue;
                 }
-                rgba_readonly = rgba.data();
-                MCH_DEBUG("Convert RGB -> RGBA {} x {}", gltf_image.width, gltf_image.height)
-            } else {
-                assert(gltf_image.component == 4);
-                rgba_readonly = gltf_image.image.data();
-                MCH_DEBUG("Load RGBA {} x {}", gltf_image.width, gltf_image.height)
+                MCH_DEBUG("Load RGBA {} x {}", decoded_image.width, decoded_image.height)
+                textures.push_back(std::make_shared<Match::DataTexture>(decoded_image.pixels, decoded_image.width, decoded_image.height, 0));
+                stbi_image_free(decoded_image.pixels);
+                decoded_image.pixels = nullptr;
             }
-            textures.push_back(std::make_shared<Match::DataTexture>(rgba_readonly, gltf_image.width, gltf_image.height, 0));
         }
+        load_stats.image_count = textures.size();
         sampler = std::make_shared<Sampler>(SamplerOptions {});
     }
 
+    std::shared_ptr<StorageBuffer> GLTFScene::create_storage_buffer(uint64_t size) {
+        // 不能创建大小为0的缓冲
+        size = std::max<uint64_t>(size, 4);
+        if (buffer_location == GLTFBufferLocation::eDeviceLocal) {
+            return std::make_shared<TwoStageBuffer>(size, vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        }
+        return std::make_shared<Buffer>(size, vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+    }
+
+    void *GLTFScene::map_storage_buffer(std::shared_ptr<StorageBuffer> buffer) {
+        if (buffer_location == GLTFBufferLocation::eDeviceLocal) {
+            return std::static_pointer_cast<TwoStageBuffer>(buffer)->map();
+        }
+        return std::static_pointer_cast<Buffer>(buffer)->map();
+    }
+
+    void GLTFScene::unmap_storage_buffer(std::shared_ptr<StorageBuffer> buffer) {
+        if (buffer_location == GLTFBufferLocation::eDeviceLocal) {
+            std::static_pointer_cast<TwoStageBuffer>(buffer)->unmap();
+            return;
+        }
+        std::static_pointer_cast<Buffer>(buffer)->unmap();
+    }
+
+    void GLTFScene::update_materials() {
+        if (materials.empty()) {
+            return;
+        }
+        if (buffer_location == GLTFBufferLocation::eDeviceLocal) {
+            std::static_pointer_cast<TwoStageBuffer>(material_buffer)->upload_data_from_vector(materials);
+            return;
+        }
+        memcpy(map_storage_buffer(material_buffer), materials.data(), materials.size() * sizeof(GLTFMaterial));
+        unmap_storage_buffer(material_buffer);
+    }
+
     void GLTFScene::load_materials(const tinygltf::Model &gltf_model) {
         for (auto &gltf_material : gltf_model.materials) {
             auto &material = materials.emplace_back();
@@ -141,6 +789,18 @@ namespace Match {
     }
 
     GLTFScene::~GLTFScene() {
+        if (moved_callback_id.has_value() && manager->defragmenter.get() != nullptr) {
+            manager->defragmenter->remove_resource_moved_callback(moved_callback_id.value());
+        }
+        instance_transform_buffer.reset();
+        instance_matrices.clear();
+        instance_nodes.clear();
+        deformed_vertex_buffer.reset();
+        deformed_primitives.clear();
+        animations.clear();
+        skins.clear();
+        primitive_references.clear();
+        all_node_references.clear();
         nodes.clear();
         meshes.clear();
         positions.clear();
@@ -153,7 +813,7 @@ namespace Match {
         index_buffer.reset();
     }
 
-    GLTFNode::GLTFNode(GLTFScene &scene, const tinygltf::Model &gltf_model, uint32_t gltf_node_index, GLTFNode *parent) : parent(parent) {
+    GLTFNode::GLTFNode(GLTFScene &scene, const tinygltf::Model &gltf_model, uint32_t gltf_node_index, GLTFNode *parent) : scene(scene), parent(parent) {
         auto &gltf_node = gltf_model.nodes[gltf_node_index];
 
         name = gltf_node.name;
@@ -161,6 +821,18 @@ namespace Match {
         if (gltf_node.mesh > -1) {
             mesh = scene.meshes[gltf_node.mesh];
         }
+        skin = gltf_node.skin;
+
+        // 先序遍历, 先记录自己再创建子节点
+        index = scene.all_node_references.size();
+        scene.node_index_map[gltf_node_index] = index;
+        scene.all_node_references.push_back(this);
+        scene.node_parents.push_back(parent == nullptr ? -1 : static_cast<int32_t>(parent->index));
+        scene.node_subtree_ends.push_back(index + 1);
+        auto &rotation = scene.node_rotations.emplace_back(0, 0, 0, 0);
+        auto &scale = scene.node_scales.emplace_back(1);
+        auto &translation = scene.node_translations.emplace_back(0);
+        auto &matrix = scene.node_matrices.emplace_back(1);
         if (gltf_node.rotation.size() == 4) {
             auto t_rotation = glm::make_quat(gltf_node.rotation.data());
             rotation.x = t_rotation.w;
@@ -177,32 +849,56 @@ namespace Match {
         if (gltf_node.matrix.size() == 16) {
             matrix = glm::make_mat4(gltf_node.matrix.data());
         }
+        auto &weights = scene.node_weights.emplace_back(gltf_node.weights.begin(), gltf_node.weights.end());
+        if (mesh.get() != nullptr) {
+            uint32_t morph_target_count = 0;
+            for (auto &primitive : mesh->primitives) {
+                morph_target_count = std::max(morph_target_count, primitive->morph_target_count);
+            }
+            if (weights.empty()) {
+                weights = mesh->weights;
+            }
+            weights.resize(morph_target_count, 0);
+        }
+        scene.local_matrices.emplace_back(1);
+        scene.world_matrices.emplace_back(1);
+        scene.node_dirty.push_back(1);
+        scene.world_matrices_dirty = true;
 
         for (uint32_t gltf_child_index : gltf_node.children) {
-            auto node = std::make_shared<GLTFNode>(scene, gltf_model, gltf_child_index, this);
-            scene.all_node_references.push_back(node.get());
-            children.push_back(std::move(node));
+            children.push_back(std::make_shared<GLTFNode>(scene, gltf_model, gltf_child_index, this));
         }
+        scene.node_subtree_ends[index] = scene.all_node_references.size();
     }
 
     glm::mat4 GLTFNode::get_local_matrix() {
-        return glm::translate(glm::mat4(1), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1), scale) * matrix;
+        scene.update_world_matrices();
+        return scene.local_matrices[index];
     }
 
     glm::mat4 GLTFNode::get_world_matrix() {
-        if (parent != nullptr) {
-            return parent->get_world_matrix() * get_local_matrix();
-        } else {
-            return get_local_matrix();
-        }
+        return scene.get_world_matrix(index);
+    }
+
+    void GLTFNode::set_translation(const glm::vec3 &translation) {
+        scene.set_node_translation(index, translation);
+    }
+
+    void GLTFNode::set_rotation(const glm::quat &rotation) {
+        scene.set_node_rotation(index, rotation);
+    }
+
+    void GLTFNode::set_scale(const glm::vec3 &scale) {
+        scene.set_node_scale(index, scale);
     }
 
     GLTFNode::~GLTFNode() {
         children.clear();
     }
 
-    GLTFMesh::GLTFMesh(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Mesh &gltf_mesh, const std::vector<std::string> &load_attributes) {
+    GLTFMesh::GLTFMesh(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Mesh &gltf_mesh) {
         name = gltf_mesh.name;
+        weights.assign(gltf_mesh.weights.begin(), gltf_mesh.weights.end());
         MCH_DEBUG("Load Mesh {}", name)
         for (auto &gltf_primitive : gltf_mesh.primitives) {
             if (gltf_primitive.mode != TINYGLTF_MODE_TRIANGLES) {
@@ -213,7 +909,8 @@ namespace Match {
                 MCH_WARN("Unsupported Primitive Indices {}", gltf_primitive.indices)
                 continue;
             }
-            primitives.push_back(std::make_unique<GLTFPrimitive>(scene, gltf_model, gltf_primitive, load_attributes));
+            auto &primitive = primitives.emplace_back(std::make_shared<GLTFPrimitive>(scene, gltf_model, gltf_primitive));
+            scene.primitive_load_tasks.push_back({ primitive.get(), &gltf_primitive, {} });
         }
     }
 
@@ -221,108 +918,92 @@ namespace Match {
         primitives.clear();
     }
 
-    GLTFPrimitive::GLTFPrimitive(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive, const std::vector<std::string> &load_attributes) : scene(scene) {
-        primitive_instance_data.first_index = scene.indices.size();
-        primitive_instance_data.first_vertex = scene.positions.size();
+    GLTFPrimitive::GLTFPrimitive(GLTFScene &scene, const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive) : scene(scene) {
         primitive_instance_data.material_index = gltf_primitive.material;
 
-        auto no_operator = [](const tinygltf::Accessor &) {};
-        auto get_data_pointer = [&](const std::string &name, auto other_operator) {
-            if (gltf_primitive.attributes.find(name) == gltf_primitive.attributes.end()) {
-                MCH_ERROR("Attribute {} Not Found", name)
-                return static_cast<const void *>(nullptr);
-            }
-            const auto &accessor = gltf_model.accessors[gltf_primitive.attributes.find(name)->second];
-            const auto &buffer_view = gltf_model.bufferViews[accessor.bufferView];
-            other_operator(accessor);
-            return reinterpret_cast<const void *>(gltf_model.buffers[buffer_view.buffer].data.data() + accessor.byteOffset + buffer_view.byteOffset);
-        };
-
-        auto *position_ptr = static_cast<const float *>(get_data_pointer("POSITION", [&](auto &accessor) {
+        auto position_iter = gltf_primitive.attributes.find("POSITION");
+        if (position_iter == gltf_primitive.attributes.end()) {
+            MCH_ERROR("Attribute {} Not Found", "POSITION")
+        } else {
+            const auto &accessor = gltf_model.accessors[position_iter->second];
             vertex_count = accessor.count;
             pos_min = glm::make_vec3(accessor.minValues.data());
             pos_max = glm::make_vec3(accessor.maxValues.data());
-        }));
-        for (uint32_t i = 0; i < vertex_count; i++) {
-            scene.positions.push_back(glm::make_vec3(&position_ptr[i * 3]));
         }
-        for (auto &attribute_name : load_attributes) {
-            uint32_t count = 0;
-            uint32_t stride = 0;
-            auto *ptr = static_cast<const uint8_t *>(get_data_pointer(attribute_name, [&](auto &accessor) {
-                count = accessor.count;
-                switch (accessor.componentType) {
-                case TINYGLTF_COMPONENT_TYPE_DOUBLE:
-                    stride = sizeof(double);
-                    break;
-                case TINYGLTF_COMPONENT_TYPE_FLOAT:
-                case TINYGLTF_COMPONENT_TYPE_INT:
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                    stride = sizeof(uint32_t);
-                    break;
-                case TINYGLTF_COMPONENT_TYPE_SHORT:
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                    stride = sizeof(uint16_t);
-                    break;
-                case TINYGLTF_COMPONENT_TYPE_BYTE:
-                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                    stride = sizeof(uint8_t);
-                    break;
-                }
-                switch(accessor.type) {
-                case TINYGLTF_TYPE_VEC2:
-                    stride *= 2;
-                    break;
-                case TINYGLTF_TYPE_VEC3:
-                    stride *= 3;
-                    break;
-                case TINYGLTF_TYPE_VEC4:
-                    stride *= 4;
-                    break;
-                case TINYGLTF_TYPE_MAT2:
-                    stride *= 4;
-                    break;
-                case TINYGLTF_TYPE_MAT3:
-                    stride *= 9;
-                    break;
-                case TINYGLTF_TYPE_MAT4:
-                    stride *= 16;
-                    break;
-                default:
-                    MCH_WARN("Unsupported accessor.type {} {} {}", accessor.type, __FILE__, __LINE__)
-                }
-            }));
-            if (scene.attribute_datas.find(attribute_name) == scene.attribute_datas.end()) {
-                scene.attribute_datas[attribute_name] = {};
+        morph_target_count = gltf_primitive.targets.size();
+        index_count = gltf_model.accessors[gltf_primitive.indices].count;
+    }
+
+    void GLTFPrimitive::load_data(const tinygltf::Model &gltf_model, const tinygltf::Primitive &gltf_primitive, const std::vector<std::string> &load_attributes, const std::vector<uint8_t *> &attribute_ptrs, const std::vector<uint64_t> &attribute_offsets) {
+        auto get_data_pointer = [&](const tinygltf::Accessor &accessor) {
+            return scene.get_accessor_data(gltf_model, accessor);
+        };
+
+        auto position_iter = gltf_primitive.attributes.find("POSITION");
+        if (position_iter != gltf_primitive.attributes.end()) {
+            const auto &accessor = gltf_model.accessors[position_iter->second];
+            uint32_t stride = accessor.ByteStride(gltf_model.bufferViews[accessor.bufferView]);
+            const auto *position_ptr = get_data_pointer(accessor);
+            auto *dst = &scene.positions[primitive_instance_data.first_vertex];
+            for (uint32_t i = 0; i < vertex_count; i ++) {
+                memcpy(&dst[i], position_ptr + i * stride, sizeof(glm::vec3));
+            }
+        }
+
+        if (skin_vertex_offset > -1) {
+            auto joints = read_accessor_floats(scene, gltf_model, gltf_model.accessors[gltf_primitive.attributes.at("JOINTS_0")]);
+            auto weights = read_accessor_floats(scene, gltf_model, gltf_model.accessors[gltf_primitive.attributes.at("WEIGHTS_0")]);
+            joints.resize(vertex_count * 4, 0);
+            weights.resize(vertex_count * 4, 0);
+            for (uint32_t i = 0; i < vertex_count; i ++) {
+                scene.skin_joints[skin_vertex_offset + i] = glm::uvec4(joints[i * 4], joints[i * 4 + 1], joints[i * 4 + 2], joints[i * 4 + 3]);
+                // 量化后的权重之和可能不为1
+                auto weight = glm::make_vec4(&weights[i * 4]);
+                float weight_sum = weight.x + weight.y + weight.z + weight.w;
+                scene.skin_weights[skin_vertex_offset + i] = weight_sum > 0 ? weight / weight_sum : glm::vec4(1, 0, 0, 0);
+            }
+        }
+        // 没有位置偏移的变形目标保持为0
+        for (uint32_t target = 0; target < morph_target_count; target ++) {
+            auto target_position_iter = gltf_primitive.targets[target].find("POSITION");
+            if (target_position_iter == gltf_primitive.targets[target].end()) {
+                continue;
+            }
+            auto deltas = read_accessor_floats(scene, gltf_model, gltf_model.accessors[target_position_iter->second]);
+            deltas.resize(vertex_count * 3, 0);
+            auto *dst = &scene.morph_deltas[morph_delta_offset + target * vertex_count];
+            for (uint32_t i = 0; i < vertex_count; i ++) {
+                dst[i] = glm::make_vec3(&deltas[i * 3]);
+            }
+        }
+
+        for (uint32_t i = 0; i < load_attributes.size(); i ++) {
+            auto attribute_iter = gltf_primitive.attributes.find(load_attributes[i]);
+            if (attribute_iter == gltf_primitive.attributes.end()) {
+                continue;
             }
-            auto &data = scene.attribute_datas[attribute_name];
-            auto start = data.size();
-            data.resize(start + count * stride);
-            MCH_DEBUG("{}: count {}, stride {}", attribute_name, count, stride)
-            memcpy(data.data() + start, ptr, count * stride);
+            const auto &accessor = gltf_model.accessors[attribute_iter->second];
+            uint32_t size = get_element_size(accessor);
+            memcpy(attribute_ptrs[i] + attribute_offsets[i], get_data_pointer(accessor), accessor.count * size);
         }
 
         const auto &index_accessor = gltf_model.accessors[gltf_primitive.indices];
-        const auto &index_buffer_view = gltf_model.bufferViews[index_accessor.bufferView];
-        index_count = index_accessor.count;
-        auto *index_ptr = static_cast<const uint8_t *>(gltf_model.buffers[index_buffer_view.buffer].data.data() + index_accessor.byteOffset + index_buffer_view.byteOffset);
+        const auto *index_ptr = get_data_pointer(index_accessor);
+        auto *dst = &scene.indices[primitive_instance_data.first_index];
         switch (index_accessor.componentType) {
         case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-            for (uint32_t i = 0; i < index_count; i ++) {
-                scene.indices.push_back(*(reinterpret_cast<const uint32_t *>(index_ptr)));
-                index_ptr += 4;
-            }
+            memcpy(dst, index_ptr, index_count * sizeof(uint32_t));
             break;
         case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
             for (uint32_t i = 0; i < index_count; i ++) {
-                scene.indices.push_back(*(reinterpret_cast<const uint16_t *>(index_ptr)));
-                index_ptr += 2;
+                uint16_t index;
+                memcpy(&index, index_ptr + i * sizeof(uint16_t), sizeof(uint16_t));
+                dst[i] = index;
             }
             break;
         case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
             for (uint32_t i = 0; i < index_count; i ++) {
-                scene.indices.push_back(*(reinterpret_cast<const uint8_t *>(index_ptr)));
-                index_ptr += 1;
+                dst[i] = index_ptr[i];
             }
             break;
         }
@@ -330,4 +1011,11 @@ namespace Match {
 
     GLTFPrimitive::~GLTFPrimitive() {
     }
+
+    GLTFDeformedPrimitive::GLTFDeformedPrimitive(GLTFNode *node, std::shared_ptr<GLTFPrimitive> primitive, uint32_t deformed_vertex_offset) : node(node), primitive(primitive), deformed_vertex_offset(deformed_vertex_offset) {
+    }
+
+    GLTFDeformedPrimitive::~GLTFDeformedPrimitive() {
+        primitive.reset();
+    }
 }
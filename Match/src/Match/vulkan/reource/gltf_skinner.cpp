@@ -0,0 +1,298 @@
+#include <Match/vulkan/resource/gltf_skinner.hpp>
+#include <Match/vulkan/resource/model_acceleration_structure.hpp>
+#include <Match/vulkan/utils.hpp>
+#include "../inner.hpp"
+#include <chrono>
+
+namespace Match {
+    static const char *skinning_shader = R"(
+#version 450
+
+layout (local_size_x = 64) in;
+
+layout (set = 0, binding = 0) readonly buffer PositionBuffer {
+    float positions[];
+};
+
+layout (set = 0, binding = 1) readonly buffer JointBuffer {
+    uvec4 joints[];
+};
+
+layout (set = 0, binding = 2) readonly buffer WeightBuffer {
+    vec4 weights[];
+};
+
+layout (set = 0, binding = 3) readonly buffer MorphDeltaBuffer {
+    float morph_deltas[];
+};
+
+layout (set = 0, binding = 4) readonly buffer JointMatrixBuffer {
+    mat4 joint_matrices[];
+};
+
+layout (set = 0, binding = 5) readonly buffer MorphWeightBuffer {
+    float morph_weights[];
+};
+
+layout (set = 0, binding = 6) writeonly buffer DeformedBuffer {
+    float deformed_positions[];
+};
+
+layout (push_constant) uniform Constants {
+    uint vertex_count;
+    uint first_vertex;
+    uint deformed_vertex_offset;
+    int skin_vertex_offset;
+    uint joint_matrix_offset;
+    uint morph_delta_offset;
+    uint morph_target_count;
+    uint morph_weight_offset;
+};
+
+vec3 read_vec3(uint idx) {
+    return vec3(positions[idx * 3], positions[idx * 3 + 1], positions[idx * 3 + 2]);
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= vertex_count) {
+        return;
+    }
+    vec3 position = read_vec3(first_vertex + idx);
+
+    // 先叠加变形目标, 再做蒙皮
+    for (uint target = 0; target < morph_target_count; target ++) {
+        float weight = morph_weights[morph_weight_offset + target];
+        if (weight != 0) {
+            uint delta = (morph_delta_offset + target * vertex_count + idx) * 3;
+            position += weight * vec3(morph_deltas[delta], morph_deltas[delta + 1], morph_deltas[delta + 2]);
+        }
+    }
+
+    if (skin_vertex_offset >= 0) {
+        uvec4 joint = joints[skin_vertex_offset + idx] + joint_matrix_offset;
+        vec4 weight = weights[skin_vertex_offset + idx];
+        mat4 skin_matrix =
+            weight.x * joint_matrices[joint.x] +
+            weight.y * joint_matrices[joint.y] +
+            weight.z * joint_matrices[joint.z] +
+            weight.w * joint_matrices[joint.w];
+        position = (skin_matrix * vec4(position, 1)).xyz;
+    }
+
+    uint dst = (deformed_vertex_offset + idx) * 3;
+    deformed_positions[dst] = position.x;
+    deformed_positions[dst + 1] = position.y;
+    deformed_positions[dst + 2] = position.z;
+}
+)";
+
+    GLTFSkinner::GLTFSkinner(std::shared_ptr<GLTFScene> scene) : scene(scene) {
+        stats.deformed_primitive_count = scene->deformed_primitives.size();
+        stats.deformed_vertex_count = scene->deformed_vertex_count;
+        stats.joint_count = scene->deformed_joint_count;
+        if (scene->deformed_primitives.empty()) {
+            MCH_WARN("GLTFScene has no skinned or morphed primitive")
+            return;
+        }
+
+        // 存储缓冲不能为空
+        auto storage_size = [](uint64_t size) { return std::max<uint64_t>(size, 16); };
+        position_buffer = std::make_shared<TwoStageBuffer>(storage_size(scene->positions.size() * sizeof(glm::vec3)), vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        position_buffer->upload_data_from_vector(scene->positions);
+        joint_buffer = std::make_shared<TwoStageBuffer>(storage_size(scene->skin_joints.size() * sizeof(glm::uvec4)), vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        joint_buffer->upload_data_from_vector(scene->skin_joints);
+        weight_buffer = std::make_shared<TwoStageBuffer>(storage_size(scene->skin_weights.size() * sizeof(glm::vec4)), vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        weight_buffer->upload_data_from_vector(scene->skin_weights);
+        morph_delta_buffer = std::make_shared<TwoStageBuffer>(storage_size(scene->morph_deltas.size() * sizeof(glm::vec3)), vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        morph_delta_buffer->upload_data_from_vector(scene->morph_deltas);
+        // 关节矩阵和变形目标权重每帧更新, 每个飞行帧一份
+        joint_matrix_buffer = std::make_shared<InFlightBuffer>(storage_size(scene->deformed_joint_count * sizeof(glm::mat4)), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        morph_weight_buffer = std::make_shared<InFlightBuffer>(storage_size(scene->deformed_morph_weight_count * sizeof(float)), vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        descriptor_set = std::make_shared<DescriptorSet>(std::nullopt);
+        descriptor_set->add_descriptors({
+            { ShaderStage::eCompute, 0, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 1, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 2, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 3, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 4, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 5, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 6, DescriptorType::eStorageBuffer },
+        }).allocate()
+            .bind_storage_buffer(0, position_buffer)
+            .bind_storage_buffer(1, joint_buffer)
+            .bind_storage_buffer(2, weight_buffer)
+            .bind_storage_buffer(3, morph_delta_buffer)
+            .bind_storage_buffer(4, joint_matrix_buffer)
+            .bind_storage_buffer(5, morph_weight_buffer)
+            .bind_storage_buffer(6, scene->deformed_vertex_buffer);
+
+        push_constants = std::make_shared<PushConstants>(ShaderStage::eCompute, std::vector<PushConstantInfo> {
+            { "vertex_count", ConstantType::eUint32 },
+            { "first_vertex", ConstantType::eUint32 },
+            { "deformed_vertex_offset", ConstantType::eUint32 },
+            { "skin_vertex_offset", ConstantType::eInt32 },
+            { "joint_matrix_offset", ConstantType::eUint32 },
+            { "morph_delta_offset", ConstantType::eUint32 },
+            { "morph_target_count", ConstantType::eUint32 },
+            { "morph_weight_offset", ConstantType::eUint32 },
+        });
+
+        std::string code = skinning_shader;
+        std::vector<char> code_vector(code.begin(), code.end());
+        code_vector.push_back('\0');
+        auto shader = std::make_shared<Shader>("gltf skinning", code_vector, ShaderStage::eCompute);
+        shader_program = std::make_shared<ComputeShaderProgram>();
+        shader_program->attach_compute_shader(shader)
+            .attach_descriptor_set(descriptor_set)
+            .attach_push_constants(push_constants)
+            .compile();
+    }
+
+    void GLTFSkinner::upload_deform_data() {
+        auto start = std::chrono::high_resolution_clock::now();
+        scene->update_world_matrices();
+        auto *joint_matrices = static_cast<glm::mat4 *>(joint_matrix_buffer->map());
+        auto *morph_weights = static_cast<float *>(morph_weight_buffer->map());
+        scene->enumerate_deformed_primitives([&](GLTFNode *node, std::shared_ptr<GLTFDeformedPrimitive> deformed_primitive) {
+            if (deformed_primitive->joint_count > 0) {
+                auto &skin = scene->skins[node->skin];
+                // 变形后的顶点在节点的局部空间中, 绘制和光线追踪实例仍然使用节点的世界矩阵
+                auto inverse_node_matrix = glm::inverse(scene->get_world_matrix(node->index));
+                for (uint32_t i = 0; i < deformed_primitive->joint_count; i ++) {
+                    joint_matrices[deformed_primitive->joint_matrix_offset + i] = inverse_node_matrix * scene->get_world_matrix(skin.joints[i]) * skin.inverse_bind_matrices[i];
+                }
+            }
+            auto &weights = scene->node_weights[node->index];
+            for (uint32_t i = 0; i < deformed_primitive->primitive->morph_target_count; i ++) {
+                morph_weights[deformed_primitive->morph_weight_offset + i] = i < weights.size() ? weights[i] : 0;
+            }
+        });
+        auto in_flight = runtime_setting->current_in_flight;
+        joint_matrix_buffer->in_flight_buffers[in_flight]->flush();
+        morph_weight_buffer->in_flight_buffers[in_flight]->flush();
+        stats.upload_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    void GLTFSkinner::skin(Renderer &renderer) {
+        if (scene->deformed_primitives.empty()) {
+            return;
+        }
+        upload_deform_data();
+
+        // 上一帧的绘制和BLAS更新读取完变形顶点后再写入
+        vk::PipelineStageFlags read_stages = vk::PipelineStageFlagBits::eVertexInput;
+        if (setting.enable_ray_tracing) {
+            read_stages |= vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR;
+        }
+        renderer.memory_barrier(
+            read_stages, vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eShaderRead,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite
+        );
+        scene->enumerate_deformed_primitives([&](GLTFNode *node, std::shared_ptr<GLTFDeformedPrimitive> deformed_primitive) {
+            auto &primitive = deformed_primitive->primitive;
+            push_constants->push_constant("vertex_count", primitive->vertex_count);
+            push_constants->push_constant("first_vertex", primitive->primitive_instance_data.first_vertex);
+            push_constants->push_constant("deformed_vertex_offset", deformed_primitive->deformed_vertex_offset);
+            push_constants->push_constant("skin_vertex_offset", deformed_primitive->joint_count > 0 ? primitive->skin_vertex_offset : -1);
+            push_constants->push_constant("joint_matrix_offset", deformed_primitive->joint_matrix_offset);
+            push_constants->push_constant("morph_delta_offset", primitive->morph_delta_offset);
+            push_constants->push_constant("morph_target_count", primitive->morph_target_count);
+            push_constants->push_constant("morph_weight_offset", deformed_primitive->morph_weight_offset);
+            renderer.bind_shader_program(shader_program);
+            renderer.dispatch((primitive->vertex_count + group_size - 1) / group_size);
+        });
+        renderer.compute_to_graphics_barrier();
+
+        refit_acceleration_structures(renderer);
+    }
+
+    void GLTFSkinner::refit_acceleration_structures(Renderer &renderer) {
+        stats.refit_count = 0;
+        if (!setting.enable_ray_tracing || scene->index_buffer.get() == nullptr || !scene->deformed_primitives.front()->acceleration_structure.has_value()) {
+            return;
+        }
+
+        uint32_t count = scene->deformed_primitives.size();
+        auto vertex_address = scene->get_deformed_vertex_address();
+        auto index_address = get_buffer_address(scene->index_buffer->buffer);
+        std::vector<vk::AccelerationStructureGeometryKHR> geometries;
+        std::vector<vk::AccelerationStructureBuildGeometryInfoKHR> builds;
+        std::vector<vk::AccelerationStructureBuildRangeInfoKHR> ranges;
+        geometries.reserve(count);
+        builds.reserve(count);
+        ranges.reserve(count);
+        // 与AccelerationStructureBuilder中构建变形图元时的参数一致
+        for (auto &deformed_primitive : scene->deformed_primitives) {
+            auto &primitive = deformed_primitive->primitive;
+            vk::AccelerationStructureGeometryTrianglesDataKHR triangles {};
+            triangles.setVertexFormat(vk::Format::eR32G32B32Sfloat)
+                .setVertexStride(sizeof(glm::vec3))
+                .setVertexData(vertex_address)
+                .setMaxVertex(primitive->vertex_count - 1)
+                .setIndexType(vk::IndexType::eUint32)
+                .setIndexData(index_address);
+            geometries.emplace_back()
+                .setGeometry(triangles)
+                .setGeometryType(vk::GeometryTypeKHR::eTriangles)
+                .setFlags(vk::GeometryFlagBitsKHR::eOpaque);
+            ranges.emplace_back()
+                .setFirstVertex(deformed_primitive->deformed_vertex_offset)
+                .setPrimitiveOffset(primitive->primitive_instance_data.first_index * sizeof(uint32_t))
+                .setPrimitiveCount(primitive->index_count / 3)
+                .setTransformOffset(0);
+            auto acceleration_structure = deformed_primitive->acceleration_structure.value()->bottom_level_acceleration_structure;
+            builds.emplace_back()
+                .setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
+                .setMode(vk::BuildAccelerationStructureModeKHR::eUpdate)
+                .setFlags(vk::BuildAccelerationStructureFlagBitsKHR::eAllowCompaction | vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate)
+                .setGeometries(geometries.back())
+                .setSrcAccelerationStructure(acceleration_structure)
+                .setDstAccelerationStructure(acceleration_structure);
+        }
+
+        if (scratch_buffer.get() == nullptr) {
+            uint64_t scratch_size = 0;
+            for (uint32_t i = 0; i < count; i ++) {
+                auto size = manager->device->device.getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, builds[i], ranges[i].primitiveCount, manager->dispatcher);
+                scratch_offsets.push_back(scratch_size);
+                scratch_size += AccelerationStructureArena::align(size.updateScratchSize);
+            }
+            scratch_buffer = std::make_unique<Buffer>(scratch_size, vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eStorageBuffer, VMA_MEMORY_USAGE_GPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+        }
+        auto scratch_address = get_buffer_address(scratch_buffer->buffer);
+        std::vector<const vk::AccelerationStructureBuildRangeInfoKHR *> range_ptrs;
+        range_ptrs.reserve(count);
+        for (uint32_t i = 0; i < count; i ++) {
+            builds[i].setScratchData(scratch_address + scratch_offsets[i]);
+            range_ptrs.push_back(&ranges[i]);
+        }
+
+        // 变形顶点写入完成, 且上一帧对BLAS的更新和读取完成后再更新
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eAccelerationStructureWriteKHR | vk::AccessFlagBits::eAccelerationStructureReadKHR,
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eAccelerationStructureReadKHR | vk::AccessFlagBits::eAccelerationStructureWriteKHR
+        );
+        renderer.get_command_buffer().buildAccelerationStructuresKHR(builds, range_ptrs, manager->dispatcher);
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::AccessFlagBits::eAccelerationStructureReadKHR
+        );
+        stats.refit_count = count;
+    }
+
+    GLTFSkinner::~GLTFSkinner() {
+        scratch_buffer.reset();
+        shader_program.reset();
+        push_constants.reset();
+        descriptor_set.reset();
+        morph_weight_buffer.reset();
+        joint_matrix_buffer.reset();
+        morph_delta_buffer.reset();
+        weight_buffer.reset();
+        joint_buffer.reset();
+        position_buffer.reset();
+        scene.reset();
+    }
+}
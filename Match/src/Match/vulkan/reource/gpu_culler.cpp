@@ -0,0 +1,454 @@
+#include <Match/vulkan/resource/gpu_culler.hpp>
+#include "../inner.hpp"
+
+namespace Match {
+    static const char *culling_shader = R"(
+layout (local_size_x = 64) in;
+
+struct DrawInfo {
+    vec3 pos_min;
+    uint index_count;
+    vec3 pos_max;
+    uint first_index;
+    int vertex_offset;
+    uint padding[3];
+};
+
+struct InstanceInfo {
+    mat4 transform;
+    uint draw_index;
+    uint instance_id;
+    uint padding[2];
+};
+
+layout (set = 0, binding = 0) readonly buffer DrawBuffer {
+    DrawInfo draws[];
+};
+
+layout (set = 0, binding = 1) readonly buffer InstanceBuffer {
+    InstanceInfo instances[];
+};
+
+layout (set = 0, binding = 2) writeonly buffer CommandBuffer {
+    uint commands[];
+};
+
+layout (set = 0, binding = 3) buffer CountBuffer {
+    uint draw_count;
+    uint late_draw_count;
+    uint occluded_count;
+};
+
+#if OCCLUSION_CULLING
+layout (set = 0, binding = 4) writeonly buffer LateCommandBuffer {
+    uint late_commands[];
+};
+
+layout (set = 0, binding = 5) buffer VisibilityBuffer {
+    uint visibility[];
+};
+
+layout (set = 0, binding = 6) uniform sampler2D depth_pyramid;
+#endif
+
+layout (push_constant) uniform Constants {
+    mat4 view_project;
+    vec2 pyramid_size;
+    uint instance_count;
+    uint phase;
+};
+
+bool frustum_visible(vec3 center, vec3 extent) {
+    // 从裁剪空间提取视锥的6个平面, 只判断符号不需要归一化, 深度范围是[0, 1], 近平面为z >= 0
+    mat4 m = transpose(view_project);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+    for (int i = 0; i < 6; i ++) {
+        if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), extent) < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#if OCCLUSION_CULLING
+bool occlusion_visible(vec3 world_min, vec3 world_max) {
+    vec2 uv_min = vec2(1), uv_max = vec2(0);
+    float min_depth = 1;
+    for (int i = 0; i < 8; i ++) {
+        vec3 corner = mix(world_min, world_max, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+        vec4 clip = view_project * vec4(corner, 1);
+        // 与近平面相交时无法投影, 保守地认为可见
+        if (clip.w <= 0) {
+            return true;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        // Renderer默认的视口是y翻转的
+        vec2 uv = vec2(ndc.x * 0.5 + 0.5, 0.5 - ndc.y * 0.5);
+        uv_min = min(uv_min, uv);
+        uv_max = max(uv_max, uv);
+        min_depth = min(min_depth, ndc.z);
+    }
+    uv_min = clamp(uv_min, vec2(0), vec2(1));
+    uv_max = clamp(uv_max, vec2(0), vec2(1));
+    vec2 size = (uv_max - uv_min) * pyramid_size;
+    float level = ceil(log2(max(max(size.x, size.y), 1)));
+    float depth = textureLod(depth_pyramid, (uv_min + uv_max) * 0.5, level).x;
+    return min_depth <= depth;
+}
+#endif
+
+void write_command(uint slot, DrawInfo draw, uint instance_id, bool late) {
+#if OCCLUSION_CULLING
+    if (late) {
+        late_commands[slot * 5 + 0] = draw.index_count;
+        late_commands[slot * 5 + 1] = 1;
+        late_commands[slot * 5 + 2] = draw.first_index;
+        late_commands[slot * 5 + 3] = uint(draw.vertex_offset);
+        late_commands[slot * 5 + 4] = instance_id;
+        return;
+    }
+#endif
+    commands[slot * 5 + 0] = draw.index_count;
+    commands[slot * 5 + 1] = 1;
+    commands[slot * 5 + 2] = draw.first_index;
+    commands[slot * 5 + 3] = uint(draw.vertex_offset);
+    commands[slot * 5 + 4] = instance_id;
+}
+
+void main() {
+    uint idx = gl_GlobalInvocationID.x;
+    if (idx >= instance_count) {
+        return;
+    }
+    InstanceInfo instance = instances[idx];
+    DrawInfo draw = draws[instance.draw_index];
+
+    // 将局部包围盒变换为世界空间的包围盒
+    vec3 center = (draw.pos_min + draw.pos_max) * 0.5;
+    vec3 extent = (draw.pos_max - draw.pos_min) * 0.5;
+    vec3 world_center = (instance.transform * vec4(center, 1)).xyz;
+    mat3 abs_matrix = mat3(abs(instance.transform[0].xyz), abs(instance.transform[1].xyz), abs(instance.transform[2].xyz));
+    vec3 world_extent = abs_matrix * extent;
+    bool visible = frustum_visible(world_center, world_extent);
+
+#if OCCLUSION_CULLING
+    // 第1阶段: 只绘制上一帧可见的实例
+    if (phase == 1) {
+        if (visible && visibility[idx] == 1) {
+            write_command(atomicAdd(draw_count, 1), draw, instance.instance_id, false);
+        }
+        return;
+    }
+    // 第2阶段: 用第1阶段的深度测试所有实例, 绘制新出现的实例并更新可见性
+    if (visible) {
+        visible = occlusion_visible(world_center - world_extent, world_center + world_extent);
+        if (!visible) {
+            atomicAdd(occluded_count, 1);
+        }
+    }
+    if (visible && visibility[idx] == 0) {
+        write_command(atomicAdd(late_draw_count, 1), draw, instance.instance_id, true);
+    }
+    visibility[idx] = visible ? 1 : 0;
+#else
+    if (visible) {
+        write_command(atomicAdd(draw_count, 1), draw, instance.instance_id, false);
+    }
+#endif
+}
+)";
+
+    GPUCuller::GPUCuller(uint32_t max_draw_count, uint32_t max_instance_count) : max_draw_count(max_draw_count), max_instance_count(max_instance_count), draws_dirty(false), instances_dirty(false) {
+        draws.reserve(max_draw_count);
+        instances.reserve(max_instance_count);
+        draw_buffer = std::make_shared<TwoStageBuffer>(sizeof(CullingDrawInfo) * max_draw_count, vk::BufferUsageFlagBits::eStorageBuffer);
+        // 实例数据每帧都可能改变, 每个飞行帧使用自己的暂存缓冲, 拷贝录制在帧的命令缓冲中
+        instance_buffer = std::make_shared<TwoStageBuffer>(sizeof(CullingInstanceInfo) * max_instance_count, vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        instance_staging_buffer = std::make_unique<InFlightBuffer>(sizeof(CullingInstanceInfo) * max_instance_count, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+        indirect_buffer = std::make_shared<IndirectBuffer>(IndirectCommandType::eDrawIndexed, max_instance_count, vk::BufferUsageFlagBits::eStorageBuffer);
+        // 0: 第1阶段绘制数量, 1: 第2阶段绘制数量, 2: 被遮挡的数量
+        count_buffer = std::make_shared<Buffer>(3 * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_GPU_ONLY, 0);
+        count_readback_buffer = std::make_unique<ReadbackBuffer>(3 * sizeof(uint32_t) * setting.max_in_flight_frame);
+
+        descriptor_set = std::make_shared<DescriptorSet>(std::nullopt);
+        descriptor_set->add_descriptors({
+            { ShaderStage::eCompute, 0, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 1, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 2, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 3, DescriptorType::eStorageBuffer },
+        }).allocate()
+            .bind_storage_buffer(0, draw_buffer)
+            .bind_storage_buffer(1, instance_buffer)
+            .bind_storage_buffer(2, indirect_buffer)
+            .bind_storage_buffer(3, count_buffer);
+
+        push_constants = std::make_shared<PushConstants>(ShaderStage::eCompute, std::vector<PushConstantInfo> {
+            { "view_project_0", ConstantType::eFloat4 },
+            { "view_project_1", ConstantType::eFloat4 },
+            { "view_project_2", ConstantType::eFloat4 },
+            { "view_project_3", ConstantType::eFloat4 },
+            { "pyramid_size", ConstantType::eFloat2 },
+            { "instance_count", ConstantType::eUint32 },
+            { "phase", ConstantType::eUint32 },
+        });
+        shader_program = create_culling_program(false, descriptor_set);
+
+        // 每一帧4个时间戳: 第1阶段开始, 第1阶段结束, 第2阶段开始, 第2阶段结束
+        timestamp_period = manager->device->physical_device.getProperties().limits.timestampPeriod;
+        vk::QueryPoolCreateInfo query_pool_create_info {};
+        query_pool_create_info.setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(4 * setting.max_in_flight_frame);
+        timestamp_query_pool = manager->device->device.createQueryPool(query_pool_create_info);
+        manager->device->device.resetQueryPool(timestamp_query_pool, 0, 4 * setting.max_in_flight_frame);
+        stats_recorded.resize(setting.max_in_flight_frame, false);
+    }
+
+    std::shared_ptr<ComputeShaderProgram> GPUCuller::create_culling_program(bool occlusion_culling, std::shared_ptr<DescriptorSet> descriptor_set) {
+        std::string code = std::string("#version 450\n#define OCCLUSION_CULLING ") + (occlusion_culling ? "1" : "0") + "\n" + culling_shader;
+        std::vector<char> code_vector(code.begin(), code.end());
+        code_vector.push_back('\0');
+        auto shader = std::make_shared<Shader>(occlusion_culling ? "occlusion culling" : "frustum culling", code_vector, ShaderStage::eCompute);
+
+        auto program = std::make_shared<ComputeShaderProgram>();
+        program->attach_compute_shader(shader)
+            .attach_descriptor_set(descriptor_set)
+            .attach_push_constants(push_constants)
+            .compile();
+        return program;
+    }
+
+    void GPUCuller::enable_occlusion_culling(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name) {
+        occlusion_renderer = renderer;
+        hi_z_pyramid = std::make_shared<HiZPyramid>(renderer, depth_attachment_name);
+        hi_z_sampler = std::make_shared<Sampler>(SamplerOptions {
+            .mag_filter = SamplerFilter::eLinear,
+            .min_filter = SamplerFilter::eLinear,
+            .address_mode_u = SamplerAddressMode::eClampToEdge,
+            .address_mode_v = SamplerAddressMode::eClampToEdge,
+            .address_mode_w = SamplerAddressMode::eClampToEdge,
+            .mipmap_mode = SamplerFilter::eNearest,
+            .mip_levels = 16,
+            .reduction_mode = SamplerReductionMode::eMax,
+        });
+        late_indirect_buffer = std::make_shared<IndirectBuffer>(IndirectCommandType::eDrawIndexed, max_instance_count, vk::BufferUsageFlagBits::eStorageBuffer);
+        // 第一帧所有实例都不可见, 由第2阶段绘制
+        visibility_buffer = std::make_shared<TwoStageBuffer>(sizeof(uint32_t) * max_instance_count, vk::BufferUsageFlagBits::eStorageBuffer);
+        visibility_buffer->upload_data_from_vector(std::vector<uint32_t>(max_instance_count, 0));
+
+        occlusion_descriptor_set = std::make_shared<DescriptorSet>(std::nullopt);
+        occlusion_descriptor_set->add_descriptors({
+            { ShaderStage::eCompute, 0, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 1, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 2, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 3, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 4, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 5, DescriptorType::eStorageBuffer },
+            { ShaderStage::eCompute, 6, DescriptorType::eTexture },
+        }).allocate()
+            .bind_storage_buffer(0, draw_buffer)
+            .bind_storage_buffer(1, instance_buffer)
+            .bind_storage_buffer(2, indirect_buffer)
+            .bind_storage_buffer(3, count_buffer)
+            .bind_storage_buffer(4, late_indirect_buffer)
+            .bind_storage_buffer(5, visibility_buffer)
+            .bind_texture(6, hi_z_pyramid, hi_z_sampler);
+        occlusion_shader_program = create_culling_program(true, occlusion_descriptor_set);
+
+        // 金字塔在窗口大小改变后重建, 需要重新绑定
+        callback_id = renderer.lock()->register_resource_recreate_callback([this]() {
+            occlusion_descriptor_set->bind_texture(6, hi_z_pyramid, hi_z_sampler);
+        });
+    }
+
+    uint32_t GPUCuller::add_draw(const CullingDrawInfo &draw_info) {
+        if (draws.size() >= max_draw_count) {
+            MCH_ERROR("GPUCuller draw count exceeds {}", max_draw_count)
+            return 0;
+        }
+        draws.push_back(draw_info);
+        draws_dirty = true;
+        return draws.size() - 1;
+    }
+
+    uint32_t GPUCuller::add_mesh(std::shared_ptr<const Mesh> mesh) {
+        return add_draw({ mesh->pos_min, mesh->get_index_count(), mesh->pos_max, mesh->position.index_buffer_offset, static_cast<int32_t>(mesh->position.vertex_buffer_offset), {} });
+    }
+
+    std::vector<uint32_t> GPUCuller::add_model(std::shared_ptr<const Model> model) {
+        std::vector<uint32_t> draw_indices;
+        draw_indices.reserve(model->meshes.size());
+        for (auto &[name, mesh] : model->meshes) {
+            draw_indices.push_back(add_mesh(mesh));
+        }
+        return draw_indices;
+    }
+
+    uint32_t GPUCuller::add_primitive(std::shared_ptr<GLTFPrimitive> primitive) {
+        return add_draw({ primitive->pos_min, primitive->index_count, primitive->pos_max, primitive->primitive_instance_data.first_index, static_cast<int32_t>(primitive->primitive_instance_data.first_vertex), {} });
+    }
+
+    uint32_t GPUCuller::add_instance(uint32_t draw_index, const glm::mat4 &transform, uint32_t instance_id) {
+        if (instances.size() >= max_instance_count) {
+            MCH_ERROR("GPUCuller instance count exceeds {}", max_instance_count)
+            return 0;
+        }
+        if (instance_id == uint32_t(-1)) {
+            instance_id = instances.size();
+        }
+        instances.push_back({ transform, draw_index, instance_id, {} });
+        instances_dirty = true;
+        return instances.size() - 1;
+    }
+
+    void GPUCuller::set_instance_transform(uint32_t instance_index, const glm::mat4 &transform) {
+        instances[instance_index].transform = transform;
+        instances_dirty = true;
+    }
+
+    void GPUCuller::upload(vk::CommandBuffer command_buffer) {
+        // 绘制信息只在添加模型时改变
+        if (draws_dirty) {
+            draw_buffer->upload_data_from_vector(draws);
+            draws_dirty = false;
+        }
+        if (instances_dirty && !instances.empty()) {
+            // 这一帧的Fence已经完成, 当前飞行帧的暂存缓冲不再被GPU读取
+            auto &staging = *instance_staging_buffer->in_flight_buffers[runtime_setting->current_in_flight];
+            uint64_t size = instances.size() * sizeof(CullingInstanceInfo);
+            memcpy(staging.map(), instances.data(), size);
+            staging.flush(0, size);
+            command_buffer.copyBuffer(staging.buffer, instance_buffer->buffer->buffer, vk::BufferCopy { 0, 0, size });
+            instances_dirty = false;
+        }
+    }
+
+    void GPUCuller::update_stats() {
+        // 读取max_in_flight_frame帧之前的结果, 这一帧的fence已经完成, 不需要等待
+        auto in_flight = runtime_setting->current_in_flight;
+        if (stats_recorded[in_flight]) {
+            stats_recorded[in_flight] = false;
+            auto *counts = static_cast<const uint32_t *>(count_readback_buffer->read(3 * in_flight * sizeof(uint32_t), 3 * sizeof(uint32_t)));
+            stats.visible_count = counts[0] + counts[1];
+            stats.occluded_count = counts[2];
+            stats.culled_count = stats.instance_count - std::min(stats.visible_count, stats.instance_count);
+            uint64_t timestamps[4] = {};
+            uint32_t query_count = is_occlusion_culling_enabled() ? 4 : 2;
+            if (manager->device->device.getQueryPoolResults(timestamp_query_pool, 4 * in_flight, query_count, sizeof(timestamps), timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64) == vk::Result::eSuccess) {
+                uint64_t ticks = timestamps[1] - timestamps[0];
+                if (query_count == 4) {
+                    ticks += timestamps[3] - timestamps[2];
+                }
+                stats.gpu_time = static_cast<float>(ticks) * timestamp_period / 1000000.0f;
+            }
+        }
+        manager->device->device.resetQueryPool(timestamp_query_pool, 4 * in_flight, 4);
+    }
+
+    void GPUCuller::dispatch_culling(Renderer &renderer, std::shared_ptr<ComputeShaderProgram> program, uint32_t phase) {
+        push_constants->push_constant("phase", phase);
+        renderer.bind_shader_program(program);
+        renderer.dispatch((instances.size() + group_size - 1) / group_size);
+    }
+
+    void GPUCuller::cull(Renderer &renderer, const glm::mat4 &view_project) {
+        update_stats();
+        stats.instance_count = instances.size();
+
+        for (uint32_t i = 0; i < 4; i ++) {
+            auto column = view_project[i];
+            push_constants->push_constant("view_project_" + std::to_string(i), &column);
+        }
+        glm::vec2 pyramid_size = is_occlusion_culling_enabled() ? glm::vec2(hi_z_pyramid->get_width(), hi_z_pyramid->get_height()) : glm::vec2(0);
+        push_constants->push_constant("pyramid_size", &pyramid_size);
+        push_constants->push_constant("instance_count", static_cast<uint32_t>(instances.size()));
+
+        auto in_flight = runtime_setting->current_in_flight;
+        auto command_buffer = renderer.get_command_buffer();
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_query_pool, 4 * in_flight);
+
+        // 上一帧的间接绘制和剔除完成后再清空计数和更新实例数据
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eTransfer | vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite
+        );
+        command_buffer.fillBuffer(count_buffer->buffer, 0, 3 * sizeof(uint32_t), 0);
+        upload(command_buffer);
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite
+        );
+
+        if (is_occlusion_culling_enabled()) {
+            dispatch_culling(renderer, occlusion_shader_program, 1);
+            renderer.compute_to_graphics_barrier();
+        } else {
+            dispatch_culling(renderer, shader_program, 0);
+            renderer.compute_to_graphics_barrier();
+            renderer.memory_barrier(
+                vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+                vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead
+            );
+            command_buffer.copyBuffer(count_buffer->buffer, count_readback_buffer->buffer, vk::BufferCopy { 0, 3 * in_flight * sizeof(uint32_t), 3 * sizeof(uint32_t) });
+            renderer.memory_barrier(
+                vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+                vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead
+            );
+            stats_recorded[in_flight] = true;
+        }
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_query_pool, 4 * in_flight + 1);
+    }
+
+    void GPUCuller::draw(Renderer &renderer) {
+        renderer.draw_indexed_indirect_count(indirect_buffer, count_buffer, 0, instances.size());
+    }
+
+    void GPUCuller::cull_late(Renderer &renderer) {
+        if (!is_occlusion_culling_enabled()) {
+            MCH_ERROR("cull_late requires enable_occlusion_culling")
+            return;
+        }
+        auto in_flight = runtime_setting->current_in_flight;
+        auto command_buffer = renderer.get_command_buffer();
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestamp_query_pool, 4 * in_flight + 2);
+
+        hi_z_pyramid->build(renderer);
+        dispatch_culling(renderer, occlusion_shader_program, 2);
+        renderer.compute_to_graphics_barrier();
+
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead
+        );
+        command_buffer.copyBuffer(count_buffer->buffer, count_readback_buffer->buffer, vk::BufferCopy { 0, 3 * in_flight * sizeof(uint32_t), 3 * sizeof(uint32_t) });
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite,
+            vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead
+        );
+        command_buffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestamp_query_pool, 4 * in_flight + 3);
+        stats_recorded[in_flight] = true;
+    }
+
+    void GPUCuller::draw_late(Renderer &renderer) {
+        if (!is_occlusion_culling_enabled()) {
+            return;
+        }
+        renderer.draw_indexed_indirect_count(late_indirect_buffer, count_buffer, sizeof(uint32_t), instances.size());
+    }
+
+    GPUCuller::~GPUCuller() {
+        if (callback_id.has_value()) {
+            if (auto renderer = occlusion_renderer.lock()) {
+                renderer->remove_resource_recreate_callback(callback_id.value());
+            }
+        }
+        manager->destroy_later([query_pool = timestamp_query_pool]() {
+            manager->device->device.destroyQueryPool(query_pool);
+        });
+        occlusion_shader_program.reset();
+        occlusion_descriptor_set.reset();
+        hi_z_pyramid.reset();
+        shader_program.reset();
+        push_constants.reset();
+        descriptor_set.reset();
+    }
+}
@@ -0,0 +1,224 @@
+#include <Match/vulkan/resource/hi_z_pyramid.hpp>
+#include <Match/vulkan/resource/shader.hpp>
+#include <Match/vulkan/utils.hpp>
+#include "../inner.hpp"
+
+namespace Match {
+    static const char *hi_z_reduce_shader = R"(#version 450
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (set = 0, binding = 0) uniform sampler2D src_image;
+layout (set = 0, binding = 1, r32f) uniform writeonly image2D dst_image;
+
+layout (push_constant) uniform Constants {
+    vec2 dst_size;
+};
+
+void main() {
+    uvec2 pos = gl_GlobalInvocationID.xy;
+    if (pos.x >= uint(dst_size.x) || pos.y >= uint(dst_size.y)) {
+        return;
+    }
+    // 采样器使用Max模式, 一次采样得到2x2范围内的最大深度
+    float depth = texture(src_image, (vec2(pos) + 0.5) / dst_size).x;
+    imageStore(dst_image, ivec2(pos), vec4(depth));
+}
+)";
+
+    static uint32_t previous_power_of_two(uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    HiZPyramid::HiZPyramid(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name) : renderer(renderer), width(0), height(0), mip_levels(0) {
+        auto locked_renderer = renderer.lock();
+        depth_attachment_idx = locked_renderer->render_pass_builder->get_attachment_index(depth_attachment_name, false);
+        if (!(locked_renderer->render_pass_builder->final_usages[depth_attachment_idx] & vk::ImageUsageFlagBits::eSampled)) {
+            MCH_ERROR("Depth attachment {} must be created with eSampled usage to build Hi-Z", depth_attachment_name)
+        }
+        if (locked_renderer->render_pass_builder->final_attachments[depth_attachment_idx].samples != vk::SampleCountFlagBits::e1) {
+            MCH_ERROR("Hi-Z does not support multisampled depth attachment {}", depth_attachment_name)
+        }
+
+        reduce_sampler = std::make_shared<Sampler>(SamplerOptions {
+            .mag_filter = SamplerFilter::eLinear,
+            .min_filter = SamplerFilter::eLinear,
+            .address_mode_u = SamplerAddressMode::eClampToEdge,
+            .address_mode_v = SamplerAddressMode::eClampToEdge,
+            .address_mode_w = SamplerAddressMode::eClampToEdge,
+            .mipmap_mode = SamplerFilter::eNearest,
+            .reduction_mode = SamplerReductionMode::eMax,
+        });
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            { 0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute },
+            { 1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute },
+        };
+        vk::DescriptorSetLayoutCreateInfo descriptor_layout_create_info {};
+        descriptor_layout_create_info.setBindings(bindings);
+        descriptor_layout = manager->device->device.createDescriptorSetLayout(descriptor_layout_create_info);
+
+        vk::PushConstantRange range { vk::ShaderStageFlagBits::eCompute, 0, sizeof(glm::vec2) };
+        vk::PipelineLayoutCreateInfo pipeline_layout_create_info {};
+        pipeline_layout_create_info.setSetLayouts(descriptor_layout)
+            .setPushConstantRanges(range);
+        pipeline_layout = manager->device->device.createPipelineLayout(pipeline_layout_create_info);
+
+        std::string code = hi_z_reduce_shader;
+        std::vector<char> code_vector(code.begin(), code.end());
+        code_vector.push_back('\0');
+        auto shader = std::make_unique<Shader>("hi-z reduce", code_vector, ShaderStage::eCompute);
+        vk::ComputePipelineCreateInfo pipeline_create_info {};
+        pipeline_create_info.setLayout(pipeline_layout)
+            .setStage(vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eCompute, shader->module.value(), "main"));
+        pipeline = manager->device->device.createComputePipeline(nullptr, pipeline_create_info).value;
+
+        create_pyramid();
+        // 窗口大小改变后深度Attachment会被重建
+        callback_id = locked_renderer->register_resource_recreate_callback([this]() {
+            destroy_pyramid();
+            create_pyramid();
+        });
+    }
+
+    void HiZPyramid::create_pyramid() {
+        auto size = runtime_setting->get_window_size();
+        width = previous_power_of_two(size.width);
+        height = previous_power_of_two(size.height);
+        mip_levels = 1;
+        while ((std::max(width, height) >> mip_levels) > 0) {
+            mip_levels ++;
+        }
+
+        image = std::make_unique<Image>(width, height, vk::Format::eR32Sfloat, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled, vk::SampleCountFlagBits::e1, VMA_MEMORY_USAGE_GPU_ONLY, 0, mip_levels);
+        image_view = create_image_view(image->image, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor, mip_levels);
+        mip_views.resize(mip_levels);
+        for (uint32_t level = 0; level < mip_levels; level ++) {
+            vk::ImageViewCreateInfo view_create_info {};
+            view_create_info.setImage(image->image)
+                .setFormat(vk::Format::eR32Sfloat)
+                .setViewType(vk::ImageViewType::e2D)
+                .setSubresourceRange({ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 });
+            mip_views[level] = manager->device->device.createImageView(view_create_info);
+        }
+        transition_image_layout(image->image, vk::ImageAspectFlagBits::eColor, mip_levels, { vk::ImageLayout::eUndefined, vk::AccessFlagBits::eNone, vk::PipelineStageFlagBits::eTopOfPipe }, { vk::ImageLayout::eGeneral, vk::AccessFlagBits::eShaderRead, vk::PipelineStageFlagBits::eComputeShader });
+
+        std::vector<vk::DescriptorPoolSize> pool_sizes = {
+            { vk::DescriptorType::eCombinedImageSampler, mip_levels },
+            { vk::DescriptorType::eStorageImage, mip_levels },
+        };
+        vk::DescriptorPoolCreateInfo pool_create_info {};
+        pool_create_info.setMaxSets(mip_levels)
+            .setPoolSizes(pool_sizes);
+        descriptor_pool = manager->device->device.createDescriptorPool(pool_create_info);
+        std::vector<vk::DescriptorSetLayout> layouts(mip_levels, descriptor_layout);
+        vk::DescriptorSetAllocateInfo allocate_info {};
+        allocate_info.setDescriptorPool(descriptor_pool)
+            .setSetLayouts(layouts);
+        descriptor_sets = manager->device->device.allocateDescriptorSets(allocate_info);
+
+        // 第0级从深度Attachment生成, 之后的每一级从上一级生成
+        auto locked_renderer = renderer.lock();
+        auto depth_view = locked_renderer->framebuffer_set->attachments[depth_attachment_idx].image_view;
+        for (uint32_t level = 0; level < mip_levels; level ++) {
+            vk::DescriptorImageInfo src_info {}, dst_info {};
+            src_info.setSampler(reduce_sampler->sampler);
+            if (level == 0) {
+                src_info.setImageView(depth_view)
+                    .setImageLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+            } else {
+                src_info.setImageView(mip_views[level - 1])
+                    .setImageLayout(vk::ImageLayout::eGeneral);
+            }
+            dst_info.setImageView(mip_views[level])
+                .setImageLayout(vk::ImageLayout::eGeneral);
+            std::vector<vk::WriteDescriptorSet> writes(2);
+            writes[0].setDstSet(descriptor_sets[level])
+                .setDstBinding(0)
+                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                .setImageInfo(src_info);
+            writes[1].setDstSet(descriptor_sets[level])
+                .setDstBinding(1)
+                .setDescriptorType(vk::DescriptorType::eStorageImage)
+                .setImageInfo(dst_info);
+            manager->device->device.updateDescriptorSets(writes, {});
+        }
+    }
+
+    void HiZPyramid::destroy_pyramid() {
+        manager->destroy_later([pool = descriptor_pool, views = mip_views, view = image_view]() {
+            manager->device->device.destroyDescriptorPool(pool);
+            for (auto mip_view : views) {
+                manager->device->device.destroyImageView(mip_view);
+            }
+            manager->device->device.destroyImageView(view);
+        });
+        descriptor_sets.clear();
+        mip_views.clear();
+        image.reset();
+    }
+
+    void HiZPyramid::build(Renderer &renderer) {
+        auto command_buffer = renderer.get_command_buffer();
+        auto depth_image = renderer.get_attachment_image(depth_attachment_idx);
+        auto depth_aspect = renderer.render_pass_builder->final_aspects[depth_attachment_idx];
+        auto depth_layout = renderer.mode == RenderingMode::eDynamicRendering ? renderer.attachment_layouts[depth_attachment_idx] : renderer.render_pass_builder->final_attachments[depth_attachment_idx].finalLayout;
+
+        vk::ImageMemoryBarrier depth_barrier {};
+        depth_barrier.setImage(depth_image)
+            .setOldLayout(depth_layout)
+            .setNewLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+            .setSrcAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+            .setSubresourceRange({ depth_aspect, 0, 1, 0, 1 });
+        // 上一次使用金字塔的剔除完成后才能覆盖
+        vk::MemoryBarrier memory_barrier {};
+        memory_barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags {}, { memory_barrier }, {}, { depth_barrier });
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        for (uint32_t level = 0; level < mip_levels; level ++) {
+            glm::vec2 dst_size = { std::max(width >> level, 1u), std::max(height >> level, 1u) };
+            command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipeline_layout, 0, { descriptor_sets[level] }, {});
+            command_buffer.pushConstants(pipeline_layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(glm::vec2), &dst_size);
+            command_buffer.dispatch((static_cast<uint32_t>(dst_size.x) + 7) / 8, (static_cast<uint32_t>(dst_size.y) + 7) / 8, 1);
+
+            vk::ImageMemoryBarrier level_barrier {};
+            level_barrier.setImage(image->image)
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setSrcAccessMask(vk::AccessFlagBits::eShaderWrite)
+                .setDstAccessMask(vk::AccessFlagBits::eShaderRead)
+                .setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED)
+                .setSubresourceRange({ vk::ImageAspectFlagBits::eColor, level, 1, 0, 1 });
+            command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader, vk::DependencyFlags {}, {}, {}, { level_barrier });
+        }
+
+        // 深度Attachment恢复到原来的布局, 之后可以继续绘制
+        depth_barrier.setOldLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+            .setNewLayout(depth_layout)
+            .setSrcAccessMask(vk::AccessFlagBits::eShaderRead)
+            .setDstAccessMask(vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests, vk::DependencyFlags {}, {}, {}, { depth_barrier });
+    }
+
+    HiZPyramid::~HiZPyramid() {
+        if (auto locked_renderer = renderer.lock()) {
+            locked_renderer->remove_resource_recreate_callback(callback_id);
+        }
+        destroy_pyramid();
+        manager->destroy_later([pipeline = pipeline, pipeline_layout = pipeline_layout, descriptor_layout = descriptor_layout, sampler = reduce_sampler]() {
+            manager->device->device.destroyPipeline(pipeline);
+            manager->device->device.destroyPipelineLayout(pipeline_layout);
+            manager->device->device.destroyDescriptorSetLayout(descriptor_layout);
+        });
+        reduce_sampler.reset();
+    }
+}
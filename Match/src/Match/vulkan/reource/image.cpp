@@ -1,9 +1,24 @@
 #include <Match/vulkan/resource/image.hpp>
+#include <Match/vulkan/utils.hpp>
 #include "../inner.hpp"
 
 namespace Match {
-    Image::Image(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags, uint32_t mip_levels) {
-        vk::ImageCreateInfo image_create_info {};
+    Image::Image(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples, VmaMemoryUsage vma_usage, VmaAllocationCreateFlags vma_flags, uint32_t mip_levels) : pinned(false), owns_allocation(true) {
+        fill_image_create_info(width, height, format, usage, samples, mip_levels);
+        VmaAllocationCreateInfo alloc_info {};
+        alloc_info.usage = vma_usage;
+        alloc_info.flags = vma_flags;
+        alloc_info.pUserData = static_cast<Defragmentable *>(this);
+        auto res = vmaCreateImage(manager->vma_allocator, reinterpret_cast<VkImageCreateInfo *>(&image_create_info), &alloc_info, reinterpret_cast<VkImage *>(&image), &allocation, nullptr);
+
+    }
+
+    Image::Image(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples) : pinned(false), owns_allocation(false), allocation(nullptr) {
+        fill_image_create_info(width, height, format, usage, samples, 1);
+        image = manager->device->device.createImage(image_create_info);
+    }
+
+    void Image::fill_image_create_info(uint32_t width, uint32_t height, vk::Format format, vk::ImageUsageFlags usage, vk::SampleCountFlagBits samples, uint32_t mip_levels) {
         image_create_info.setImageType(vk::ImageType::e2D)
             .setExtent({
                 width,
@@ -17,14 +32,98 @@ namespace Match {
             .setUsage(usage)
             .setSamples(samples)
             .setInitialLayout(vk::ImageLayout::eUndefined);
-        VmaAllocationCreateInfo alloc_info {};
-        alloc_info.usage = vma_usage;
-        alloc_info.flags = vma_flags;
-        auto res = vmaCreateImage(manager->vma_allocator, reinterpret_cast<VkImageCreateInfo *>(&image_create_info), &alloc_info, reinterpret_cast<VkImage *>(&image), &allocation, nullptr);
+        if (!manager->device->concurrent_family_indices.empty()) {
+            image_create_info.setSharingMode(vk::SharingMode::eConcurrent)
+                .setQueueFamilyIndices(manager->device->concurrent_family_indices);
+        }
+    }
+
+    vk::MemoryRequirements Image::get_memory_requirements() {
+        return manager->device->device.getImageMemoryRequirements(image);
+    }
+
+    void Image::bind_memory(VmaAllocation allocation) {
+        this->allocation = allocation;
+        vmaBindImageMemory(manager->vma_allocator, allocation, image);
+    }
+
+    void Image::set_movable(vk::ImageLayout layout, const ImageMovedCallback &callback) {
+        movable_layout = layout;
+        moved_callback = callback;
+    }
+
+    bool Image::is_movable() {
+        auto transfer_usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+        return !pinned && owns_allocation && movable_layout.has_value() && ((image_create_info.usage & transfer_usage) == transfer_usage);
+    }
+
+    void Image::begin_move(vk::CommandBuffer command_buffer, VmaAllocation dst_allocation) {
+        // image_create_info中已经带有并发共享模式, 新图像同样在图形和计算队列族间共享, 不需要转移队列族所有权
+        moving_image = manager->device->device.createImage(image_create_info);
+        vmaBindImageMemory(manager->vma_allocator, dst_allocation, moving_image);
+
+        auto aspect = get_format_aspect(image_create_info.format);
+        vk::ImageSubresourceRange range { aspect, 0, image_create_info.mipLevels, 0, 1 };
+        std::array<vk::ImageMemoryBarrier, 2> barriers;
+        barriers[0].setImage(image)
+            .setOldLayout(movable_layout.value())
+            .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setSrcAccessMask(vk::AccessFlagBits::eMemoryWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eTransferRead)
+            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setSubresourceRange(range);
+        barriers[1].setImage(moving_image)
+            .setOldLayout(vk::ImageLayout::eUndefined)
+            .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setSrcAccessMask(vk::AccessFlagBits::eNone)
+            .setDstAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+            .setSubresourceRange(range);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags {}, {}, {}, barriers);
+
+        std::vector<vk::ImageCopy> copies(image_create_info.mipLevels);
+        for (uint32_t level = 0; level < image_create_info.mipLevels; level ++) {
+            vk::Extent3D extent {
+                std::max(image_create_info.extent.width >> level, 1u),
+                std::max(image_create_info.extent.height >> level, 1u),
+                1
+            };
+            copies[level].setSrcSubresource({ aspect, level, 0, 1 })
+                .setSrcOffset({ 0, 0, 0 })
+                .setDstSubresource({ aspect, level, 0, 1 })
+                .setDstOffset({ 0, 0, 0 })
+                .setExtent(extent);
+        }
+        command_buffer.copyImage(image, vk::ImageLayout::eTransferSrcOptimal, moving_image, vk::ImageLayout::eTransferDstOptimal, copies);
+
+        barriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setNewLayout(movable_layout.value())
+            .setSrcAccessMask(vk::AccessFlagBits::eTransferWrite)
+            .setDstAccessMask(vk::AccessFlagBits::eMemoryRead);
+        command_buffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags {}, {}, {}, { barriers[1] });
+    }
 
+    void Image::end_move() {
+        manager->device->device.destroyImage(image);
+        image = moving_image;
+        moving_image = VK_NULL_HANDLE;
+        if (moved_callback) {
+            moved_callback();
+        }
     }
 
     Image::~Image() {
-        vmaDestroyImage(manager->vma_allocator, image, allocation);
+        if (owns_allocation) {
+            vmaSetAllocationUserData(manager->vma_allocator, allocation, nullptr);
+            manager->destroy_later([image = image, allocation = allocation]() {
+                vmaDestroyImage(manager->vma_allocator, image, allocation);
+            });
+        } else {
+            manager->destroy_later([image = image]() {
+                manager->device->device.destroyImage(image);
+            });
+        }
     }
 }
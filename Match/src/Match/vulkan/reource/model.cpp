@@ -86,6 +86,18 @@ namespace Match {
             meshes.insert(std::make_pair(shape.name, std::move(mesh)));
         }
         vertex_count = vertices.size();
+
+        // 计算每个Mesh的包围盒, 用于剔除
+        for (auto &[name, mesh] : meshes) {
+            if (mesh->indices.empty()) {
+                continue;
+            }
+            mesh->pos_min = mesh->pos_max = vertices[mesh->indices.front()].pos;
+            for (auto index : mesh->indices) {
+                mesh->pos_min = glm::min(mesh->pos_min, vertices[index].pos);
+                mesh->pos_max = glm::max(mesh->pos_max, vertices[index].pos);
+            }
+        }
     }
 
     Model::~Model() {
@@ -98,12 +110,14 @@ namespace Match {
     BufferPosition Model::upload_data(std::shared_ptr<VertexBuffer> vertex_buffer, std::shared_ptr<IndexBuffer> index_buffer, BufferPosition position) {
         this->position = position;
         auto temp_position = position;
-        temp_position.vertex_buffer_offset = vertex_buffer->upload_data_from_vector(vertices, temp_position.vertex_buffer_offset);
+        temp_position.vertex_buffer_offset = vertex_buffer->upload_data_from_vector(vertices, temp_position.vertex_buffer_offset, false);
         for (auto &[name, mesh] : meshes) {
             mesh->position.vertex_buffer_offset = this->position.vertex_buffer_offset;
             mesh->position.index_buffer_offset = temp_position.index_buffer_offset;
-            temp_position.index_buffer_offset = index_buffer->upload_data_from_vector(mesh->indices, temp_position.index_buffer_offset);
+            temp_position.index_buffer_offset = index_buffer->upload_data_from_vector(mesh->indices, temp_position.index_buffer_offset, false);
         }
+        vertex_buffer->flush();
+        index_buffer->flush();
         return temp_position;
     }
 
@@ -142,11 +156,10 @@ namespace Match {
             });
             ptr ++;
         }
-        get_spheres_buffer()->unmap();
 
-        aabbs_buffer = std::make_shared<Buffer>(aabbs.size() * sizeof(SphereAaBbData), vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        aabbs_buffer = std::make_shared<Buffer>(aabbs.size() * sizeof(SphereAaBbData), vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
         memcpy(aabbs_buffer->map(), aabbs.data(), aabbs_buffer->size);
-        aabbs_buffer->unmap();
+        aabbs_buffer->flush();
 
         return *this;
     }
@@ -167,6 +180,8 @@ namespace Match {
                 batch_begin ++;
             }
         });
+        get_spheres_buffer()->flush();
+        aabbs_buffer->flush();
         std::shared_ptr<SphereCollect> sphere_collect(this, [](auto) {});
         builder->add_model(sphere_collect);
         builder->update();
@@ -5,9 +5,29 @@
 #include "../inner.hpp"
 
 namespace Match {
+    AccelerationStructureArena::AccelerationStructureArena(uint64_t size) : size(size), used(0) {
+        buffer = std::make_unique<Buffer>(size, vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_GPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+    }
+
+    uint64_t AccelerationStructureArena::allocate(uint64_t size) {
+        auto offset = used;
+        used += align(size);
+        if (used > this->size) {
+            MCH_ERROR("Acceleration structure arena overflow: {} > {}", used, this->size)
+        }
+        return offset;
+    }
+
+    AccelerationStructureArena::~AccelerationStructureArena() {
+        buffer.reset();
+    }
+
     ModelAccelerationStructure::~ModelAccelerationStructure() {
-        manager->device->device.destroyAccelerationStructureKHR(bottom_level_acceleration_structure, nullptr, manager->dispatcher);
-        acceleration_structure_buffer.reset();
+        // 正在执行的帧可能还在通过TLAS访问, 延迟销毁, arena的缓冲同样延迟释放
+        manager->destroy_later([acceleration_structure = bottom_level_acceleration_structure]() {
+            manager->device->device.destroyAccelerationStructureKHR(acceleration_structure, nullptr, manager->dispatcher);
+        });
+        arena.reset();
     }
 
     void AccelerationStructureBuilder::add_model(std::shared_ptr<RayTracingModel> model) {
@@ -21,6 +41,9 @@ namespace Match {
         case RayTracingModel::RayTracingModelType::eGLTFPrimitive:
             MCH_ERROR("Please use add_scene(...) to add GLTFPrimitive with GLTFScene")
             break;
+        case RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive:
+            MCH_ERROR("Please use add_scene(...) to add GLTFDeformedPrimitive with GLTFScene")
+            break;
         }
     }
 
@@ -150,6 +173,39 @@ namespace Match {
                 info.size = manager->device->device.getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, info.build, primitive_count, manager->dispatcher);
                 max_scratch_size = std::max(max_scratch_size, is_update ? info.size.updateScratchSize : info.size.buildScratchSize);
             });
+            // 变形后的图元每帧由GLTFSkinner重新拟合, 总是允许更新
+            gltf_scene->enumerate_deformed_primitives([&](auto *gltf_node, auto deformed_primitive) {
+                if (!is_update) {
+                    deformed_primitive->acceleration_structure = std::make_unique<ModelAccelerationStructure>();
+                }
+                auto &gltf_primitive = deformed_primitive->primitive;
+                auto primitive_count = gltf_primitive->index_count / 3;
+                auto &info = build_infos.emplace_back(*deformed_primitive->acceleration_structure.value());
+
+                info.geometry_datas.emplace_back().triangles
+                    .setVertexFormat(vk::Format::eR32G32B32Sfloat)
+                    .setVertexStride(sizeof(glm::vec3))
+                    .setVertexData(gltf_scene->get_deformed_vertex_address())
+                    .setMaxVertex(gltf_primitive->vertex_count - 1)
+                    .setIndexType(vk::IndexType::eUint32)
+                    .setIndexData(get_buffer_address(gltf_scene->index_buffer->buffer))
+                    .sType = vk::StructureType::eAccelerationStructureGeometryTrianglesDataKHR;
+                info.geometries.emplace_back()
+                    .setGeometry(info.geometry_datas.back())
+                    .setGeometryType(vk::GeometryTypeKHR::eTriangles)
+                    .setFlags(vk::GeometryFlagBitsKHR::eOpaque);
+                info.ranges.emplace_back()
+                    .setFirstVertex(deformed_primitive->deformed_vertex_offset)
+                    .setPrimitiveOffset(gltf_primitive->primitive_instance_data.first_index * sizeof(uint32_t))
+                    .setPrimitiveCount(primitive_count)
+                    .setTransformOffset(0);
+                info.build.setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
+                    .setMode(mode)
+                    .setFlags(flags | vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate)
+                    .setGeometries(info.geometries);
+                info.size = manager->device->device.getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, info.build, primitive_count, manager->dispatcher);
+                max_scratch_size = std::max(max_scratch_size, is_update ? info.size.updateScratchSize : info.size.buildScratchSize);
+            });
         }
 
         if (max_staging_size > current_staging_size) {
@@ -219,22 +275,25 @@ namespace Match {
         auto query_pool = manager->device->device.createQueryPool(query_pool_create_info);
 
         std::vector<uint32_t> build_info_indices;
-        uint64_t batch_size = 0;
+        std::shared_ptr<AccelerationStructureArena> uncompacted_arena;
+        uint64_t batch_size = 0, total_uncompacted_size = 0, total_compacted_size = 0;
         for (uint32_t info_index = 0; info_index < build_infos.size(); info_index ++) {
-            batch_size += build_infos[info_index].size.accelerationStructureSize;
+            batch_size += AccelerationStructureArena::align(build_infos[info_index].size.accelerationStructureSize);
             build_info_indices.push_back(info_index);
             if (batch_size > 256 * 1024 * 1024 || info_index == build_infos.size() - 1) {
                 uint32_t query_index = 0;
                 auto command_buffer = manager->command_pool->allocate_single_use();
                 command_buffer.resetQueryPool(query_pool, 0, build_infos.size());
                 if (!is_update) {
+                    uncompacted_arena = std::make_shared<AccelerationStructureArena>(batch_size);
+                    total_uncompacted_size += batch_size;
                     for (auto index : build_info_indices) {
                         auto &info = build_infos[index];
-                        info.uncompacted_acceleration_structure_buffer = std::make_unique<Buffer>(info.size.accelerationStructureSize, vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_GPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
 
                         vk::AccelerationStructureCreateInfoKHR acceleration_structure_create_info {};
                         acceleration_structure_create_info.setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
-                            .setBuffer(info.uncompacted_acceleration_structure_buffer->buffer)
+                            .setBuffer(uncompacted_arena->buffer->buffer)
+                            .setOffset(uncompacted_arena->allocate(info.size.accelerationStructureSize))
                             .setSize(info.size.accelerationStructureSize);
                         info.uncompacted_acceleration_structure = manager->device->device.createAccelerationStructureKHR(acceleration_structure_create_info, nullptr, manager->dispatcher);
 
@@ -255,16 +314,25 @@ namespace Match {
                     std::vector<vk::DeviceSize> compacted_sizes(build_info_indices.size());
                     vk_check(manager->device->device.getQueryPoolResults(query_pool, 0, compacted_sizes.size(), sizeof(vk::DeviceSize) * compacted_sizes.size(), compacted_sizes.data(), sizeof(vk::DeviceSize), vk::QueryResultFlagBits::eWait));
 
+                    uint64_t compacted_arena_size = 0;
+                    for (auto compacted_size : compacted_sizes) {
+                        compacted_arena_size += AccelerationStructureArena::align(compacted_size);
+                    }
+                    auto compacted_arena = std::make_shared<AccelerationStructureArena>(compacted_arena_size);
+                    total_compacted_size += compacted_arena_size;
+
                     command_buffer = manager->command_pool->allocate_single_use();
                     uint32_t compacted_sizes_index = 0;
                     for (auto index : build_info_indices) {
                         auto &info = build_infos[index];
                         auto &acceleration_structure = info.model_acceleration_structure;
-                        acceleration_structure.acceleration_structure_buffer = std::make_unique<Buffer>(compacted_sizes[compacted_sizes_index], vk::BufferUsageFlagBits::eAccelerationStructureStorageKHR | vk::BufferUsageFlagBits::eShaderDeviceAddress, VMA_MEMORY_USAGE_GPU_ONLY, VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT);
+                        acceleration_structure.arena = compacted_arena;
+                        acceleration_structure.arena_offset = compacted_arena->allocate(compacted_sizes[compacted_sizes_index]);
 
                         vk::AccelerationStructureCreateInfoKHR acceleration_structure_create_info {};
                         acceleration_structure_create_info.setType(vk::AccelerationStructureTypeKHR::eBottomLevel)
-                            .setBuffer(acceleration_structure.acceleration_structure_buffer->buffer)
+                            .setBuffer(compacted_arena->buffer->buffer)
+                            .setOffset(acceleration_structure.arena_offset)
                             .setSize(compacted_sizes[compacted_sizes_index]);
                         acceleration_structure.bottom_level_acceleration_structure = manager->device->device.createAccelerationStructureKHR(acceleration_structure_create_info, nullptr, manager->dispatcher);
 
@@ -292,15 +360,18 @@ namespace Match {
                     }
                 }
                 manager->command_pool->free_single_use(command_buffer);
+                if (!is_update) {
+                    for (auto index : build_info_indices) {
+                        manager->device->device.destroyAccelerationStructureKHR(build_infos[index].uncompacted_acceleration_structure, nullptr, manager->dispatcher);
+                    }
+                    uncompacted_arena.reset();
+                }
                 build_info_indices.clear();
                 batch_size = 0;
             }
         }
-        if (!is_update) {
-            for (auto &info : build_infos) {
-                manager->device->device.destroyAccelerationStructureKHR(info.uncompacted_acceleration_structure, nullptr, manager->dispatcher);
-                info.uncompacted_acceleration_structure_buffer.reset();
-            }
+        if (!is_update && !build_infos.empty()) {
+            MCH_DEBUG("Built {} bottom level acceleration structures: {} bytes uncompacted, {} bytes compacted", build_infos.size(), total_uncompacted_size, total_compacted_size)
         }
         build_infos.clear();
         manager->device->device.destroyQueryPool(query_pool);
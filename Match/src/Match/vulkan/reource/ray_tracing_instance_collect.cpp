@@ -1,4 +1,5 @@
 #include <Match/vulkan/resource/ray_tracing_instance_collect.hpp>
+#include <Match/vulkan/renderer.hpp>
 #include <Match/core/utils.hpp>
 #include "../inner.hpp"
 
@@ -6,12 +7,15 @@ namespace Match {
     RayTracingInstanceCollect::RayTracingInstanceCollect(bool allow_update) : allow_update(allow_update), instance_count(0) {
         registrar = std::make_unique<CustomDataRegistrar<InstanceCreateInfo>>();
         registrar->register_custom_data<InstanceAddressData>();
+        moved_callback_id = manager->defragmenter->register_resource_moved_callback([this]() {
+            update_instance_address_data();
+        });
     }
 
     RayTracingInstanceCollect &RayTracingInstanceCollect::build() {
         instance_count = registrar->build_groups();
 
-        acceleration_struction_instance_infos_buffer = std::make_unique<Buffer>(instance_count * sizeof(vk::AccelerationStructureInstanceKHR), vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+        acceleration_struction_instance_infos_buffer = std::make_unique<Buffer>(instance_count * sizeof(vk::AccelerationStructureInstanceKHR), vk::BufferUsageFlagBits::eShaderDeviceAddress | vk::BufferUsageFlagBits::eAccelerationStructureBuildInputReadOnlyKHR, VMA_MEMORY_USAGE_AUTO, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
         auto *acceleration_struction_instance_infos_ptr = static_cast<vk::AccelerationStructureInstanceKHR *>(acceleration_struction_instance_infos_buffer->map());
 
         for (auto &[group_id, group_info] : registrar->groups) {
@@ -30,6 +34,7 @@ namespace Match {
             }
             group_info.custom_create_infos.clear();
         }
+        acceleration_struction_instance_infos_buffer->flush();
 
         vk::AccelerationStructureBuildRangeInfoKHR range {};
         range.setPrimitiveCount(instance_count)
@@ -98,6 +103,7 @@ namespace Match {
                 batch_begin ++;
             }
         });
+        acceleration_struction_instance_infos_buffer->flush();
 
         auto &group_info = registrar->groups.at(group_id);
 
@@ -134,8 +140,71 @@ namespace Match {
         return *this;
     }
 
+    RayTracingInstanceCollect &RayTracingInstanceCollect::refit(Renderer &renderer) {
+        if (!allow_update) {
+            MCH_WARN("This RayTracingInstanceCollect doesn't allow update")
+            return *this;
+        }
+
+        vk::AccelerationStructureGeometryInstancesDataKHR instances {};
+        instances.setData(get_buffer_address(acceleration_struction_instance_infos_buffer->buffer));
+        vk::AccelerationStructureGeometryKHR geometry {};
+        geometry.setGeometry(instances)
+            .setGeometryType(vk::GeometryTypeKHR::eInstances);
+
+        vk::AccelerationStructureBuildGeometryInfoKHR build {};
+        build.setType(vk::AccelerationStructureTypeKHR::eTopLevel)
+            .setMode(vk::BuildAccelerationStructureModeKHR::eUpdate)
+            .setFlags(vk::BuildAccelerationStructureFlagBitsKHR::ePreferFastTrace | vk::BuildAccelerationStructureFlagBitsKHR::eAllowUpdate)
+            .setGeometries(geometry);
+
+        // 命令录制在帧命令缓冲中, 不能在这里重新创建仍可能被使用的scratch缓冲
+        auto size_info = manager->device->device.getAccelerationStructureBuildSizesKHR(vk::AccelerationStructureBuildTypeKHR::eDevice, build, instance_count, manager->dispatcher);
+        if (scratch_buffer->size < size_info.updateScratchSize) {
+            MCH_ERROR("RayTracingInstanceCollect scratch buffer is too small to refit")
+            return *this;
+        }
+
+        build.setSrcAccelerationStructure(instance_collect)
+            .setDstAccelerationStructure(instance_collect)
+            .setScratchData(get_buffer_address(scratch_buffer->buffer));
+        vk::AccelerationStructureBuildRangeInfoKHR range {};
+        range.setPrimitiveCount(instance_count)
+            .setPrimitiveOffset(0)
+            .setFirstVertex(0)
+            .setTransformOffset(0);
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR | vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::AccessFlagBits::eAccelerationStructureWriteKHR | vk::AccessFlagBits::eAccelerationStructureReadKHR,
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::AccessFlagBits::eAccelerationStructureReadKHR | vk::AccessFlagBits::eAccelerationStructureWriteKHR
+        );
+        renderer.get_command_buffer().buildAccelerationStructuresKHR(build, &range, manager->dispatcher);
+        renderer.memory_barrier(
+            vk::PipelineStageFlagBits::eAccelerationStructureBuildKHR, vk::AccessFlagBits::eAccelerationStructureWriteKHR,
+            vk::PipelineStageFlagBits::eRayTracingShaderKHR, vk::AccessFlagBits::eAccelerationStructureReadKHR
+        );
+        return *this;
+    }
+
+    void RayTracingInstanceCollect::update_instance_address_data() {
+        if (instance_count == 0) {
+            return;
+        }
+        auto instance_address_data_buffer = get_instance_address_data_buffer();
+        auto *instance_address_data_ptr = static_cast<InstanceAddressData *>(instance_address_data_buffer->map());
+        for (uint32_t i = 0; i < instance_count; i ++) {
+            instance_address_data_ptr[i].vertex_buffer_address = manager->defragmenter->remap_address(instance_address_data_ptr[i].vertex_buffer_address);
+            instance_address_data_ptr[i].index_buffer_address = manager->defragmenter->remap_address(instance_address_data_ptr[i].index_buffer_address);
+        }
+        instance_address_data_buffer->flush();
+    }
+
     RayTracingInstanceCollect::~RayTracingInstanceCollect() {
-        manager->device->device.destroyAccelerationStructureKHR(instance_collect, nullptr, manager->dispatcher);
+        if (manager->defragmenter.get() != nullptr) {
+            manager->defragmenter->remove_resource_moved_callback(moved_callback_id);
+        }
+        manager->destroy_later([instance_collect = instance_collect]() {
+            manager->device->device.destroyAccelerationStructureKHR(instance_collect, nullptr, manager->dispatcher);
+        });
         instance_collect_buffer.reset();
         scratch_buffer.reset();
         acceleration_struction_instance_infos_buffer.reset();
@@ -159,6 +228,16 @@ namespace Match {
                 .vertex_buffer_address = get_buffer_address(dynamic_cast<GLTFPrimitive &>(model).scene.vertex_buffer->buffer),
                 .index_buffer_address = get_buffer_address(dynamic_cast<GLTFPrimitive &>(model).scene.index_buffer->buffer),
             };
+        case RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive: {
+            // 着色器用first_vertex加索引读取顶点, 地址向前偏移使其落在变形后的顶点上
+            auto &deformed_primitive = dynamic_cast<GLTFDeformedPrimitive &>(model);
+            auto &scene = deformed_primitive.primitive->scene;
+            int64_t vertex_offset = static_cast<int64_t>(deformed_primitive.deformed_vertex_offset) - static_cast<int64_t>(deformed_primitive.primitive->primitive_instance_data.first_vertex);
+            return {
+                .vertex_buffer_address = scene.get_deformed_vertex_address() + vertex_offset * static_cast<int64_t>(sizeof(glm::vec3)),
+                .index_buffer_address = get_buffer_address(scene.index_buffer->buffer),
+            };
+        }
         }
         return {};
     }
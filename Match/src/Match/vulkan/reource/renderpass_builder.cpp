@@ -4,6 +4,7 @@
 #include <Match/core/setting.hpp>
 #include <Match/constant.hpp>
 #include "../inner.hpp"
+#include <algorithm>
 
 namespace Match {
     vk::AttachmentReference SubpassBuilder::create_reference(const std::string &name, vk::ImageLayout layout, bool is_attachment_read) {
@@ -172,7 +173,7 @@ namespace Match {
                 attachment.description_read->samples = vk::SampleCountFlagBits::e1;
                 attachment.description_read->loadOp = vk::AttachmentLoadOp::eDontCare;
                 attachment.description_write.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
-                attachment.usage_read = vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
+                attachment.usage_read = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
                 attachment.offset = resolved_attachment_count;
                 resolved_attachment_count += 1;
             } else {
@@ -190,7 +191,7 @@ namespace Match {
                 attachment.description_read->samples = vk::SampleCountFlagBits::e1;
                 attachment.description_read->loadOp = vk::AttachmentLoadOp::eDontCare;
                 attachment.description_write.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
-                attachment.usage_read = vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
+                attachment.usage_read = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
                 attachment.offset = resolved_attachment_count;
                 resolved_attachment_count += 1;
             } else {
@@ -208,7 +209,7 @@ namespace Match {
                 attachment.description_read->samples = vk::SampleCountFlagBits::e1;
                 attachment.description_read->loadOp = vk::AttachmentLoadOp::eDontCare;
                 attachment.description_write.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
-                attachment.usage_read = vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
+                attachment.usage_read = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment | vk::ImageUsageFlagBits::eSampled;
                 attachment.offset = resolved_attachment_count;
                 resolved_attachment_count += 1;
             } else {
@@ -216,8 +217,29 @@ namespace Match {
             }
             break;
         }
-        attachment.usage |= additional_usage;
-        attachment.usage_read |= additional_usage;
+        if (attachment.description_read.has_value()) {
+            // 多重采样的图像只在RenderPass内使用, 采样时使用的是Resolve之后的图像
+            attachment.usage |= additional_usage & ~vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled);
+            attachment.usage_read |= additional_usage;
+        } else {
+            attachment.usage |= additional_usage;
+        }
+        return *this;
+    }
+
+    RenderPassBuilder &RenderPassBuilder::add_transient_attachment(const std::string &name, AttachmentType type, vk::ImageUsageFlags additional_usage) {
+        add_attachment(name, type, additional_usage);
+        // 不需要默认的Sampled用途, 内容不会保留到RenderPass之外
+        auto &attachment = attachments.back();
+        auto default_sampled = vk::ImageUsageFlags(vk::ImageUsageFlagBits::eSampled) & ~additional_usage;
+        attachment.usage &= ~default_sampled;
+        attachment.usage_read &= ~default_sampled;
+        vk::ImageUsageFlags transient_usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment;
+        if (additional_usage & ~transient_usage) {
+            MCH_WARN("Attachment {} has usages other than color, depth-stencil or input attachment and can't be transient", name)
+            return *this;
+        }
+        attachment.transient = true;
         return *this;
     }
 
@@ -246,9 +268,152 @@ namespace Match {
         for (const auto &subpass_builder : subpass_builders) {
             final_subpasses.push_back(subpass_builder->build());
         }
+        analyze_attachments();
         create_info.setAttachments(final_attachments)
             .setSubpasses(final_subpasses)
-            .setDependencies(final_dependencies);
+            .setDependencies(built_dependencies);
         return std::move(create_info);
     }
+
+    void RenderPassBuilder::analyze_attachments() {
+        uint32_t attachments_count = final_attachments.size();
+        final_usages.assign(attachments_count, {});
+        final_aspects.assign(attachments_count, {});
+        // 多重采样的图像只会被Resolve, 总是可以是Transient的, 其余Attachment需要用add_transient_attachment声明
+        std::vector<bool> transient_requested(attachments_count, false);
+        for (auto &[name, idx] : attachments_map) {
+            auto &attachment = attachments[idx];
+            final_usages[idx] = attachment.usage;
+            final_aspects[idx] = attachment.aspect;
+            uint32_t read_idx = get_attachment_index(name, true);
+            if (read_idx != idx && read_idx < attachments_count) {
+                final_usages[read_idx] = attachment.usage_read;
+                final_aspects[read_idx] = attachment.aspect;
+                transient_requested[idx] = true;
+                transient_requested[read_idx] = attachment.transient;
+            } else {
+                transient_requested[idx] = attachment.transient;
+            }
+        }
+
+        // 统计每个Attachment第一次和最后一次被使用的Subpass
+        // 同时记录最后一次写入和最后一次作为InputAttachment读取的Subpass
+        std::vector<std::pair<uint32_t, uint32_t>> lifetimes(attachments_count, { -1u, 0 });
+        std::vector<uint32_t> last_writes(attachments_count, -1u), last_reads(attachments_count, -1u);
+        auto use = [&](uint32_t attachment_idx, uint32_t subpass_idx) {
+            if (attachment_idx >= attachments_count) {
+                return;
+            }
+            auto &lifetime = lifetimes[attachment_idx];
+            lifetime.first = std::min(lifetime.first, subpass_idx);
+            lifetime.second = std::max(lifetime.second, subpass_idx);
+        };
+        auto write = [&](uint32_t attachment_idx, uint32_t subpass_idx) {
+            use(attachment_idx, subpass_idx);
+            if (attachment_idx < attachments_count) {
+                last_writes[attachment_idx] = subpass_idx;
+            }
+        };
+        for (uint32_t subpass_idx = 0; subpass_idx < subpass_builders.size(); subpass_idx ++) {
+            auto &subpass_builder = subpass_builders[subpass_idx];
+            for (auto &reference : subpass_builder->input_attachments) {
+                use(reference.attachment, subpass_idx);
+                if (reference.attachment < attachments_count) {
+                    last_reads[reference.attachment] = subpass_idx;
+                }
+            }
+            for (auto &reference : subpass_builder->output_attachments) {
+                write(reference.attachment, subpass_idx);
+            }
+            if (runtime_setting->is_msaa_enabled()) {
+                for (auto &reference : subpass_builder->resolve_attachments) {
+                    write(reference.attachment, subpass_idx);
+                }
+            }
+            if (subpass_builder->depth_attachment.has_value()) {
+                write(subpass_builder->depth_attachment->attachment, subpass_idx);
+            }
+            for (auto attachment_idx : subpass_builder->preserve_attachments) {
+                use(attachment_idx, subpass_idx);
+            }
+        }
+
+        lazily_allocated_memory_supported = false;
+        auto memory_properties = manager->device->physical_device.getMemoryProperties();
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i ++) {
+            if (memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated) {
+                lazily_allocated_memory_supported = true;
+                break;
+            }
+        }
+
+        // 只在RenderPass内部使用的Attachment不需要保存内容, 标记为Transient
+        uint32_t present_idx = get_attachment_index(SWAPCHAIN_IMAGE_ATTACHMENT, true);
+        vk::ImageUsageFlags transient_usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment;
+        std::vector<uint32_t> transient_attachments;
+        for (uint32_t idx = 0; idx < attachments_count; idx ++) {
+            auto &description = final_attachments[idx];
+            description.flags = vk::AttachmentDescriptionFlags {};
+            if (lifetimes[idx].first == -1u) {
+                description.setLoadOp(vk::AttachmentLoadOp::eDontCare)
+                    .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+            }
+            if (!transient_requested[idx] || idx == present_idx) {
+                continue;
+            }
+            if (final_usages[idx] & ~transient_usage) {
+                continue;
+            }
+            final_usages[idx] |= vk::ImageUsageFlagBits::eTransientAttachment;
+            // 最后一次写入之后还有Subpass作为InputAttachment读取时需要保存内容, 使用动态渲染时每个Subpass都是单独的一次渲染
+            if (last_reads[idx] == -1u || last_writes[idx] == -1u || last_reads[idx] <= last_writes[idx]) {
+                description.setStoreOp(vk::AttachmentStoreOp::eDontCare)
+                    .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+            }
+            if (lifetimes[idx].first != -1u) {
+                transient_attachments.push_back(idx);
+            }
+        }
+
+        // 支持延迟分配内存时Transient Attachment几乎不占用显存, 否则让生命周期不重叠的Attachment共用同一块显存
+        final_alias_groups.clear();
+        built_dependencies = final_dependencies;
+        if (lazily_allocated_memory_supported) {
+            return;
+        }
+        std::sort(transient_attachments.begin(), transient_attachments.end(), [&](uint32_t a, uint32_t b) {
+            return lifetimes[a].first < lifetimes[b].first;
+        });
+        std::vector<std::vector<uint32_t>> groups;
+        for (auto idx : transient_attachments) {
+            auto group = std::find_if(groups.begin(), groups.end(), [&](const std::vector<uint32_t> &group) {
+                return lifetimes[group.back()].second < lifetimes[idx].first;
+            });
+            if (group == groups.end()) {
+                groups.push_back({ idx });
+            } else {
+                group->push_back(idx);
+            }
+        }
+        for (auto &group : groups) {
+            if (group.size() < 2) {
+                continue;
+            }
+            for (uint32_t i = 0; i < group.size(); i ++) {
+                final_attachments[group[i]].flags |= vk::AttachmentDescriptionFlagBits::eMayAlias;
+                if (i == 0) {
+                    continue;
+                }
+                built_dependencies.push_back({
+                    lifetimes[group[i - 1]].second,
+                    lifetimes[group[i]].first,
+                    vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests | vk::PipelineStageFlagBits::eFragmentShader,
+                    vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests,
+                    vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eInputAttachmentRead,
+                    vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                });
+            }
+            final_alias_groups.push_back(std::move(group));
+        }
+    }
 }
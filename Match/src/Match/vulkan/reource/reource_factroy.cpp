@@ -11,8 +11,12 @@ namespace Match {
         return std::make_shared<RenderPassBuilder>();
     }
 
-    std::shared_ptr<Renderer> ResourceFactory::create_renderer(std::shared_ptr<RenderPassBuilder> builder) {
-        return std::make_shared<Renderer>(builder);
+    std::shared_ptr<Renderer> ResourceFactory::create_renderer(std::shared_ptr<RenderPassBuilder> builder, RenderingMode mode) {
+        return std::make_shared<Renderer>(builder, mode);
+    }
+
+    std::shared_ptr<RenderGraph> ResourceFactory::create_render_graph(std::weak_ptr<Renderer> renderer) {
+        return std::make_shared<RenderGraph>(renderer);
     }
 
     std::shared_ptr<Shader> ResourceFactory::load_shader(const std::string &filename) {
@@ -45,12 +49,45 @@ namespace Match {
         return std::make_shared<GraphicsShaderProgram>(renderer, subpass_name);
     }
 
-    std::shared_ptr<VertexBuffer> ResourceFactory::create_vertex_buffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage) {
-        return std::make_shared<VertexBuffer>(vertex_size, count, additional_usage);
+    std::shared_ptr<VertexBuffer> ResourceFactory::create_vertex_buffer(uint32_t vertex_size, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) {
+        return std::make_shared<VertexBuffer>(vertex_size, count, additional_usage, mode);
+    }
+
+    std::shared_ptr<IndexBuffer> ResourceFactory::create_index_buffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) {
+        return std::make_shared<IndexBuffer>(type, count, additional_usage, mode);
     }
 
-    std::shared_ptr<IndexBuffer> ResourceFactory::create_index_buffer(IndexType type, uint32_t count, vk::BufferUsageFlags additional_usage) {
-        return std::make_shared<IndexBuffer>(type, count, additional_usage);
+    std::shared_ptr<IndirectBuffer> ResourceFactory::create_indirect_buffer(IndirectCommandType type, uint32_t max_draw_count, vk::BufferUsageFlags additional_usage, BufferUploadMode mode) {
+        return std::make_shared<IndirectBuffer>(type, max_draw_count, additional_usage, mode);
+    }
+
+    std::shared_ptr<IndirectBuffer> ResourceFactory::create_indirect_buffer(std::shared_ptr<const Model> model, uint32_t instance_count, uint32_t first_instance) {
+        std::vector<vk::DrawIndexedIndirectCommand> commands;
+        commands.reserve(model->meshes.size());
+        for (auto &[name, mesh] : model->meshes) {
+            commands.push_back({ mesh->get_index_count(), instance_count, mesh->position.index_buffer_offset, static_cast<int32_t>(mesh->position.vertex_buffer_offset), first_instance });
+        }
+        auto indirect_buffer = std::make_shared<IndirectBuffer>(IndirectCommandType::eDrawIndexed, commands.size(), vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        // 空的模型或场景没有绘制命令, 保留一个空的缓冲, 绘制数量为0
+        if (!commands.empty()) {
+            indirect_buffer->upload_commands(commands);
+        }
+        return indirect_buffer;
+    }
+
+    std::shared_ptr<IndirectBuffer> ResourceFactory::create_indirect_buffer(std::shared_ptr<GLTFScene> scene) {
+        // firstInstance记录绘制的序号, 着色器可以通过gl_InstanceIndex查找每个图元的数据
+        std::vector<vk::DrawIndexedIndirectCommand> commands;
+        scene->enumerate_primitives([&](GLTFNode *node, std::shared_ptr<GLTFPrimitive> primitive) {
+            uint32_t draw_id = commands.size();
+            commands.push_back({ primitive->index_count, 1, primitive->primitive_instance_data.first_index, static_cast<int32_t>(primitive->primitive_instance_data.first_vertex), draw_id });
+        });
+        auto indirect_buffer = std::make_shared<IndirectBuffer>(IndirectCommandType::eDrawIndexed, commands.size(), vk::BufferUsageFlags {}, BufferUploadMode::eStatic);
+        // 空的模型或场景没有绘制命令, 保留一个空的缓冲, 绘制数量为0
+        if (!commands.empty()) {
+            indirect_buffer->upload_commands(commands);
+        }
+        return indirect_buffer;
     }
 
     std::shared_ptr<DescriptorSet> ResourceFactory::create_descriptor_set(std::optional<std::weak_ptr<Renderer>> renderer) {
@@ -69,8 +106,12 @@ namespace Match {
         return std::make_shared<UniformBuffer>(size, create_for_each_frame_in_flight);
     }
 
-    std::shared_ptr<TwoStageBuffer> ResourceFactory::create_storage_buffer(uint64_t size) {
-        return std::make_shared<TwoStageBuffer>(size, vk::BufferUsageFlagBits::eStorageBuffer);
+    std::shared_ptr<ReadbackBuffer> ResourceFactory::create_readback_buffer(uint64_t size, vk::BufferUsageFlags additional_usage) {
+        return std::make_shared<ReadbackBuffer>(size, additional_usage);
+    }
+
+    std::shared_ptr<TwoStageBuffer> ResourceFactory::create_storage_buffer(uint64_t size, BufferUploadMode mode) {
+        return std::make_shared<TwoStageBuffer>(size, vk::BufferUsageFlagBits::eStorageBuffer, vk::BufferUsageFlags {}, mode);
     }
 
     std::shared_ptr<StorageImage> ResourceFactory::create_storage_image(uint32_t width, uint32_t height, vk::Format format, bool sampled, bool enable_clear) {
@@ -112,8 +153,8 @@ namespace Match {
         return std::make_shared<SphereCollect>();
     }
 
-    std::shared_ptr<GLTFScene> ResourceFactory::load_gltf_scene(const std::string &filename, const std::vector<std::string> &load_attributes) {
-        return std::make_shared<GLTFScene>(root + "/models/" + filename, load_attributes);
+    std::shared_ptr<GLTFScene> ResourceFactory::load_gltf_scene(const std::string &filename, const std::vector<std::string> &load_attributes, uint32_t thread_count, GLTFBufferLocation buffer_location) {
+        return std::make_shared<GLTFScene>(root + "/models/" + filename, load_attributes, thread_count, buffer_location);
     }
 
     std::shared_ptr<AccelerationStructureBuilder> ResourceFactory::create_acceleration_structure_builder() {
@@ -132,6 +173,34 @@ namespace Match {
         return std::make_shared<ComputeShaderProgram>();
     }
 
+    std::shared_ptr<DispatchArgsGenerator> ResourceFactory::create_dispatch_args_generator(std::shared_ptr<StorageBuffer> count_buffer, std::shared_ptr<IndirectBuffer> args_buffer, uint32_t group_size) {
+        return std::make_shared<DispatchArgsGenerator>(count_buffer, args_buffer, group_size);
+    }
+
+    std::shared_ptr<GPUCuller> ResourceFactory::create_gpu_culler(uint32_t max_draw_count, uint32_t max_instance_count) {
+        return std::make_shared<GPUCuller>(max_draw_count, max_instance_count);
+    }
+
+    std::shared_ptr<HiZPyramid> ResourceFactory::create_hi_z_pyramid(std::weak_ptr<Renderer> renderer, const std::string &depth_attachment_name) {
+        return std::make_shared<HiZPyramid>(renderer, depth_attachment_name);
+    }
+
+    std::shared_ptr<SoftwareOcclusionCuller> ResourceFactory::create_software_occlusion_culler(uint32_t width, uint32_t height, uint32_t thread_count) {
+        return std::make_shared<SoftwareOcclusionCuller>(width, height, thread_count);
+    }
+
+    std::shared_ptr<FrustumCuller> ResourceFactory::create_frustum_culler() {
+        return std::make_shared<FrustumCuller>();
+    }
+
+    std::shared_ptr<GLTFSkinner> ResourceFactory::create_gltf_skinner(std::shared_ptr<GLTFScene> scene) {
+        return std::make_shared<GLTFSkinner>(scene);
+    }
+
+    std::shared_ptr<GLTFAnimator> ResourceFactory::create_gltf_animator(std::shared_ptr<GLTFScene> scene, uint32_t animation_index, uint32_t thread_count) {
+        return std::make_shared<GLTFAnimator>(scene, animation_index, thread_count);
+    }
+
     std::shared_ptr<VolumeData> ResourceFactory::load_volume_data(const std::string &filename) {
         return std::make_shared<VolumeData>(root + "/volume_datas/" + filename);
     }
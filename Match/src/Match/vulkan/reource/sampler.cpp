@@ -19,10 +19,18 @@ namespace Match {
             .setMinLod(0.0f)
             .setMaxLod(static_cast<float>(options.mip_levels))
             .setMipLodBias(0.0f);
+        // Min/Max模式在过滤时取覆盖范围内的最小/最大值, 用于生成深度金字塔等
+        vk::SamplerReductionModeCreateInfo reduction_mode_create_info {};
+        if (options.reduction_mode != SamplerReductionMode::eWeightedAverage) {
+            reduction_mode_create_info.setReductionMode(transform<vk::SamplerReductionMode>(options.reduction_mode));
+            sampler_create_info.setPNext(&reduction_mode_create_info);
+        }
         sampler = manager->device->device.createSampler(sampler_create_info);
     }
 
     Sampler::~Sampler() {
-        manager->device->device.destroySampler(sampler);
+        manager->destroy_later([sampler = sampler]() {
+            manager->device->device.destroySampler(sampler);
+        });
     }
 }
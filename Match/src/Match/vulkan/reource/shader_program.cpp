@@ -4,6 +4,7 @@
 #include <Match/core/setting.hpp>
 #include <Match/core/utils.hpp>
 #include "../inner.hpp"
+#include <algorithm>
 
 namespace Match {
     static vk::PipelineShaderStageCreateInfo create_pipeline_shader_stage_create_info(vk::ShaderStageFlagBits stage, vk::ShaderModule module, const std::string &entry) {
@@ -16,8 +17,10 @@ namespace Match {
     }
 
     ShaderProgram::~ShaderProgram() {
-        manager->device->device.destroyPipeline(pipeline);
-        manager->device->device.destroyPipelineLayout(layout);
+        manager->destroy_later([pipeline = pipeline, layout = layout]() {
+            manager->device->device.destroyPipeline(pipeline);
+            manager->device->device.destroyPipelineLayout(layout);
+        });
         descriptor_sets.clear();
     }
 
@@ -78,6 +81,26 @@ namespace Match {
         input_assembly_state.setTopology(transform<vk::PrimitiveTopology>(options.topology))
             .setPrimitiveRestartEnable(VK_FALSE);
 
+        compile_options = options;
+        auto dynamic_states = options.dynamic_states;
+        auto add_dynamic_state = [&](vk::DynamicState state) {
+            if (std::find(dynamic_states.begin(), dynamic_states.end(), state) == dynamic_states.end()) {
+                dynamic_states.push_back(state);
+            }
+        };
+        if (options.dynamic_viewport_scissor) {
+            add_dynamic_state(vk::DynamicState::eViewport);
+            add_dynamic_state(vk::DynamicState::eScissor);
+        }
+        if (options.extended_dynamic_state) {
+            add_dynamic_state(vk::DynamicState::eCullMode);
+            add_dynamic_state(vk::DynamicState::eFrontFace);
+            add_dynamic_state(vk::DynamicState::eDepthTestEnable);
+            add_dynamic_state(vk::DynamicState::eDepthWriteEnable);
+            add_dynamic_state(vk::DynamicState::eDepthCompareOp);
+            add_dynamic_state(vk::DynamicState::ePrimitiveTopology);
+        }
+
         auto &size = runtime_setting->get_window_size();
         vk::Viewport viewport {
             0.0f,
@@ -91,9 +114,19 @@ namespace Match {
             { 0, 0 },
             { size.width, size.height },
         };
+        // 动态视口和裁剪, 窗口大小改变时不需要重建管线
+        auto is_dynamic = [&](vk::DynamicState state) {
+            return std::find(dynamic_states.begin(), dynamic_states.end(), state) != dynamic_states.end();
+        };
         vk::PipelineViewportStateCreateInfo viewport_state {};
         viewport_state.setViewports(viewport)
             .setScissors(scissor);
+        if (is_dynamic(vk::DynamicState::eViewport)) {
+            viewport_state.setPViewports(nullptr);
+        }
+        if (is_dynamic(vk::DynamicState::eScissor)) {
+            viewport_state.setPScissors(nullptr);
+        }
 
         vk::PipelineRasterizationStateCreateInfo rasterization_state {};
         rasterization_state.setRasterizerDiscardEnable(VK_FALSE)
@@ -127,7 +160,23 @@ namespace Match {
             .setAttachments(subpass.output_attachment_blend_states);
 
         vk::PipelineDynamicStateCreateInfo dynamic_state {};
-        dynamic_state.setDynamicStates(options.dynamic_states);
+        dynamic_state.setDynamicStates(dynamic_states);
+
+        // 动态渲染的管线只依赖Attachment的格式, 不依赖RenderPass
+        vk::PipelineRenderingCreateInfo rendering_create_info {};
+        std::vector<vk::Format> color_attachment_formats;
+        auto &final_attachments = locked_renderer->render_pass_builder->final_attachments;
+        for (auto &reference : subpass.output_attachments) {
+            color_attachment_formats.push_back(final_attachments[reference.attachment].format);
+        }
+        rendering_create_info.setColorAttachmentFormats(color_attachment_formats);
+        if (subpass.depth_attachment.has_value()) {
+            auto depth_format = final_attachments[subpass.depth_attachment->attachment].format;
+            rendering_create_info.setDepthAttachmentFormat(depth_format);
+            if (has_stencil_component(depth_format)) {
+                rendering_create_info.setStencilAttachmentFormat(depth_format);
+            }
+        }
 
         compile_pipeline_layout();
 
@@ -143,10 +192,14 @@ namespace Match {
             .setPColorBlendState(&color_blend_state)
             .setPDynamicState(&dynamic_state)
             .setLayout(layout)
-            .setRenderPass(locked_renderer->render_pass->render_pass)
-            .setSubpass(subpass_idx)
             .setBasePipelineHandle(nullptr)
             .setBasePipelineIndex(0);
+        if (locked_renderer->mode == RenderingMode::eDynamicRendering) {
+            create_info.setPNext(&rendering_create_info);
+        } else {
+            create_info.setRenderPass(locked_renderer->render_pass->render_pass)
+                .setSubpass(subpass_idx);
+        }
         locked_renderer.reset();
 
         pipeline = manager->device->device.createGraphicsPipeline(nullptr, create_info).value;
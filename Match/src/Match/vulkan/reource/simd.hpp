@@ -0,0 +1,95 @@
+#pragma once
+
+#include <Match/commons.hpp>
+#include <algorithm>
+#include <cmath>
+
+// CPU剔除和动画求值使用的SIMD封装, 开启MATCH_ENABLE_AVX2时每次处理8个float, x86-64默认使用SSE2处理4个, 其余平台退化为标量
+#if defined (__AVX2__)
+    #include <immintrin.h>
+    #define MATCH_SIMD_AVX2
+#elif defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define MATCH_SIMD_SSE2
+#endif
+
+namespace Match {
+#if defined (MATCH_SIMD_AVX2)
+    using SimdFloat = __m256;
+    constexpr uint32_t simd_width = 8;
+    inline SimdFloat simd_set(float value) { return _mm256_set1_ps(value); }
+    inline SimdFloat simd_load(const float *ptr) { return _mm256_loadu_ps(ptr); }
+    inline void simd_store(float *ptr, SimdFloat value) { _mm256_storeu_ps(ptr, value); }
+    inline SimdFloat simd_add(SimdFloat a, SimdFloat b) { return _mm256_add_ps(a, b); }
+    inline SimdFloat simd_sub(SimdFloat a, SimdFloat b) { return _mm256_sub_ps(a, b); }
+    inline SimdFloat simd_mul(SimdFloat a, SimdFloat b) { return _mm256_mul_ps(a, b); }
+    inline SimdFloat simd_div(SimdFloat a, SimdFloat b) { return _mm256_div_ps(a, b); }
+    inline SimdFloat simd_min(SimdFloat a, SimdFloat b) { return _mm256_min_ps(a, b); }
+    inline SimdFloat simd_max(SimdFloat a, SimdFloat b) { return _mm256_max_ps(a, b); }
+    inline SimdFloat simd_abs(SimdFloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    inline SimdFloat simd_sqrt(SimdFloat a) { return _mm256_sqrt_ps(a); }
+    inline SimdFloat simd_ge(SimdFloat a, SimdFloat b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    inline SimdFloat simd_and(SimdFloat a, SimdFloat b) { return _mm256_and_ps(a, b); }
+    inline SimdFloat simd_select(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm256_blendv_ps(b, a, mask); }
+    inline uint32_t simd_mask_bits(SimdFloat mask) { return static_cast<uint32_t>(_mm256_movemask_ps(mask)); }
+    inline bool simd_any(SimdFloat mask) { return _mm256_movemask_ps(mask) != 0; }
+    inline SimdFloat simd_lane_index() { return _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7); }
+    inline float simd_reduce_max(SimdFloat value) {
+        __m128 result = _mm_max_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+        result = _mm_max_ps(result, _mm_movehl_ps(result, result));
+        result = _mm_max_ss(result, _mm_shuffle_ps(result, result, 1));
+        return _mm_cvtss_f32(result);
+    }
+    constexpr const char *simd_name = "AVX2";
+#elif defined (MATCH_SIMD_SSE2)
+    using SimdFloat = __m128;
+    constexpr uint32_t simd_width = 4;
+    inline SimdFloat simd_set(float value) { return _mm_set1_ps(value); }
+    inline SimdFloat simd_load(const float *ptr) { return _mm_loadu_ps(ptr); }
+    inline void simd_store(float *ptr, SimdFloat value) { _mm_storeu_ps(ptr, value); }
+    inline SimdFloat simd_add(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+    inline SimdFloat simd_sub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+    inline SimdFloat simd_mul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+    inline SimdFloat simd_div(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+    inline SimdFloat simd_min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+    inline SimdFloat simd_max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+    inline SimdFloat simd_abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    inline SimdFloat simd_sqrt(SimdFloat a) { return _mm_sqrt_ps(a); }
+    inline SimdFloat simd_ge(SimdFloat a, SimdFloat b) { return _mm_cmpge_ps(a, b); }
+    inline SimdFloat simd_and(SimdFloat a, SimdFloat b) { return _mm_and_ps(a, b); }
+    // SSE2没有blendv
+    inline SimdFloat simd_select(SimdFloat mask, SimdFloat a, SimdFloat b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+    inline uint32_t simd_mask_bits(SimdFloat mask) { return static_cast<uint32_t>(_mm_movemask_ps(mask)); }
+    inline bool simd_any(SimdFloat mask) { return _mm_movemask_ps(mask) != 0; }
+    inline SimdFloat simd_lane_index() { return _mm_setr_ps(0, 1, 2, 3); }
+    inline float simd_reduce_max(SimdFloat value) {
+        value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+        value = _mm_max_ss(value, _mm_shuffle_ps(value, value, 1));
+        return _mm_cvtss_f32(value);
+    }
+    constexpr const char *simd_name = "SSE2";
+#else
+    // 没有SIMD时每次处理1个float, 掩码用1和0表示
+    using SimdFloat = float;
+    constexpr uint32_t simd_width = 1;
+    inline SimdFloat simd_set(float value) { return value; }
+    inline SimdFloat simd_load(const float *ptr) { return *ptr; }
+    inline void simd_store(float *ptr, SimdFloat value) { *ptr = value; }
+    inline SimdFloat simd_add(SimdFloat a, SimdFloat b) { return a + b; }
+    inline SimdFloat simd_sub(SimdFloat a, SimdFloat b) { return a - b; }
+    inline SimdFloat simd_mul(SimdFloat a, SimdFloat b) { return a * b; }
+    inline SimdFloat simd_div(SimdFloat a, SimdFloat b) { return a / b; }
+    inline SimdFloat simd_min(SimdFloat a, SimdFloat b) { return std::min(a, b); }
+    inline SimdFloat simd_max(SimdFloat a, SimdFloat b) { return std::max(a, b); }
+    inline SimdFloat simd_abs(SimdFloat a) { return std::abs(a); }
+    inline SimdFloat simd_sqrt(SimdFloat a) { return std::sqrt(a); }
+    inline SimdFloat simd_ge(SimdFloat a, SimdFloat b) { return a >= b ? 1.0f : 0.0f; }
+    inline SimdFloat simd_and(SimdFloat a, SimdFloat b) { return a * b; }
+    inline SimdFloat simd_select(SimdFloat mask, SimdFloat a, SimdFloat b) { return mask != 0 ? a : b; }
+    inline uint32_t simd_mask_bits(SimdFloat mask) { return mask != 0 ? 1 : 0; }
+    inline bool simd_any(SimdFloat mask) { return mask != 0; }
+    inline SimdFloat simd_lane_index() { return 0; }
+    inline float simd_reduce_max(SimdFloat value) { return value; }
+    constexpr const char *simd_name = "Scalar";
+#endif
+}
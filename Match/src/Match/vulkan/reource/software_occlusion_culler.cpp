@@ -0,0 +1,475 @@
+#include <Match/vulkan/resource/software_occlusion_culler.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "simd.hpp"
+#include "../inner.hpp"
+
+namespace Match {
+    namespace {
+        using Clock = std::chrono::high_resolution_clock;
+
+        inline float elapsed_milliseconds(Clock::time_point start) {
+            return std::chrono::duration<float, std::chrono::milliseconds::period>(Clock::now() - start).count();
+        }
+
+        inline uint32_t round_up(uint32_t value, uint32_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    SoftwareOcclusionCuller::SoftwareOcclusionCuller(uint32_t width, uint32_t height, uint32_t thread_count) : view_project(1) {
+        // 每个Bin包含整数个Tile, Tile的宽度是SIMD宽度的整数倍, 光栅化时不会越过Bin的边界
+        this->width = round_up(std::max(width, 1u), tile_width * bin_count_x);
+        this->height = round_up(std::max(height, 1u), tile_height * bin_count_y);
+        tile_count_x = this->width / tile_width;
+        tile_count_y = this->height / tile_height;
+        if (thread_count == 0) {
+            thread_count = manager->thread_pool->get_thread_count();
+        }
+        this->thread_count = thread_count;
+
+        depth_buffer.resize(this->width * this->height, 1.0f);
+        tile_max_depth.resize(tile_count_x * tile_count_y, 1.0f);
+        thread_triangles.resize(thread_count);
+        thread_bins.resize(thread_count, std::vector<std::vector<uint32_t>>(bin_count_x * bin_count_y));
+        MCH_DEBUG("Software occlusion culler: {}x{} depth buffer, {} threads, {} kernels", this->width, this->height, thread_count, simd_name)
+    }
+
+    const char *SoftwareOcclusionCuller::get_simd_name() {
+        return simd_name;
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occluder(std::shared_ptr<const Model> model, const std::string &mesh_name, const glm::mat4 &transform) {
+        auto mesh = model->get_mesh_by_name(mesh_name);
+        occluders.push_back({
+            reinterpret_cast<const uint8_t *>(model->vertices.data()) + offsetof(Vertex, pos),
+            sizeof(Vertex),
+            mesh->indices.data(),
+            static_cast<uint32_t>(mesh->indices.size() / 3),
+            transform,
+        });
+        return occluders.size() - 1;
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occluder(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform) {
+        // 图元的索引是相对于first_vertex的
+        occluders.push_back({
+            reinterpret_cast<const uint8_t *>(primitive->scene.positions.data() + primitive->primitive_instance_data.first_vertex),
+            sizeof(glm::vec3),
+            primitive->scene.indices.data() + primitive->primitive_instance_data.first_index,
+            primitive->index_count / 3,
+            transform,
+        });
+        return occluders.size() - 1;
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occluder(const glm::vec3 *positions, const uint32_t *indices, uint32_t triangle_count, const glm::mat4 &transform) {
+        occluders.push_back({
+            reinterpret_cast<const uint8_t *>(positions),
+            sizeof(glm::vec3),
+            indices,
+            triangle_count,
+            transform,
+        });
+        return occluders.size() - 1;
+    }
+
+    void SoftwareOcclusionCuller::set_occluder_transform(uint32_t occluder_index, const glm::mat4 &transform) {
+        occluders[occluder_index].transform = transform;
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occludee(const glm::vec3 &pos_min, const glm::vec3 &pos_max, const glm::mat4 &transform) {
+        occludees.push_back({ pos_min, pos_max, transform });
+        return occludees.size() - 1;
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occludee(std::shared_ptr<const Mesh> mesh, const glm::mat4 &transform) {
+        return add_occludee(mesh->pos_min, mesh->pos_max, transform);
+    }
+
+    uint32_t SoftwareOcclusionCuller::add_occludee(std::shared_ptr<GLTFPrimitive> primitive, const glm::mat4 &transform) {
+        return add_occludee(primitive->pos_min, primitive->pos_max, transform);
+    }
+
+    void SoftwareOcclusionCuller::set_occludee_transform(uint32_t occludee_index, const glm::mat4 &transform) {
+        occludees[occludee_index].transform = transform;
+    }
+
+    bool SoftwareOcclusionCuller::setup_triangle(const glm::vec4 &v0, const glm::vec4 &v1, const glm::vec4 &v2, SetupTriangle &triangle) const {
+        // 深度范围是[0, 1], 有顶点在近平面(z = 0)之前的三角形直接跳过, 少画遮挡物只会让剔除更保守
+        // 只检查w时, 位于相机和近平面之间的顶点会写入负的深度, 把后面的物体全部错误地剔除
+        constexpr float near_w = 1e-5f;
+        if (v0.w <= near_w || v1.w <= near_w || v2.w <= near_w) {
+            return false;
+        }
+        if (v0.z < 0 || v1.z < 0 || v2.z < 0) {
+            return false;
+        }
+        glm::vec3 p[3];
+        const glm::vec4 *clip[3] = { &v0, &v1, &v2 };
+        for (uint32_t i = 0; i < 3; i ++) {
+            auto ndc = glm::vec3(*clip[i]) / clip[i]->w;
+            p[i] = { (ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z };
+        }
+        if (p[0].z > 1 && p[1].z > 1 && p[2].z > 1) {
+            return false;
+        }
+
+        // 逆时针为正面, 剔除背面和退化的三角形
+        float dx1 = p[1].x - p[0].x, dy1 = p[1].y - p[0].y, dz1 = p[1].z - p[0].z;
+        float dx2 = p[2].x - p[0].x, dy2 = p[2].y - p[0].y, dz2 = p[2].z - p[0].z;
+        float area = dx1 * dy2 - dx2 * dy1;
+        if (area <= 0) {
+            return false;
+        }
+
+        // 覆盖的像素中心范围
+        float min_x = std::min({ p[0].x, p[1].x, p[2].x }), max_x = std::max({ p[0].x, p[1].x, p[2].x });
+        float min_y = std::min({ p[0].y, p[1].y, p[2].y }), max_y = std::max({ p[0].y, p[1].y, p[2].y });
+        triangle.min_x = static_cast<int32_t>(std::ceil(std::clamp(min_x - 0.5f, -1.0f, static_cast<float>(width))));
+        triangle.max_x = static_cast<int32_t>(std::floor(std::clamp(max_x - 0.5f, -1.0f, static_cast<float>(width))));
+        triangle.min_y = static_cast<int32_t>(std::ceil(std::clamp(min_y - 0.5f, -1.0f, static_cast<float>(height))));
+        triangle.max_y = static_cast<int32_t>(std::floor(std::clamp(max_y - 0.5f, -1.0f, static_cast<float>(height))));
+        triangle.min_x = std::max(triangle.min_x, 0);
+        triangle.min_y = std::max(triangle.min_y, 0);
+        triangle.max_x = std::min(triangle.max_x, static_cast<int32_t>(width) - 1);
+        triangle.max_y = std::min(triangle.max_y, static_cast<int32_t>(height) - 1);
+        if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y) {
+            return false;
+        }
+
+        // 边函数 a * x + b * y + c, 在三角形内部为正
+        for (uint32_t i = 0; i < 3; i ++) {
+            auto &from = p[i], &to = p[(i + 1) % 3];
+            triangle.edge_a[i] = from.y - to.y;
+            triangle.edge_b[i] = to.x - from.x;
+            triangle.edge_c[i] = -(triangle.edge_a[i] * from.x + triangle.edge_b[i] * from.y);
+        }
+
+        // 深度平面加上半个像素内的最大变化量, 保证写入的是像素覆盖范围内最远的深度
+        triangle.depth_a = (dz1 * dy2 - dz2 * dy1) / area;
+        triangle.depth_b = (dz2 * dx1 - dz1 * dx2) / area;
+        triangle.depth_c = p[0].z - triangle.depth_a * p[0].x - triangle.depth_b * p[0].y + 0.5f * (std::abs(triangle.depth_a) + std::abs(triangle.depth_b));
+        triangle.depth_max = std::min(std::max({ p[0].z, p[1].z, p[2].z }), 1.0f);
+        return true;
+    }
+
+    void SoftwareOcclusionCuller::rasterize_triangle(const SetupTriangle &triangle, int32_t bin_min_x, int32_t bin_min_y, int32_t bin_max_x, int32_t bin_max_y) {
+        int32_t x0 = std::max(triangle.min_x, bin_min_x), x1 = std::min(triangle.max_x, bin_max_x - 1);
+        int32_t y0 = std::max(triangle.min_y, bin_min_y), y1 = std::min(triangle.max_y, bin_max_y - 1);
+        if (x0 > x1 || y0 > y1) {
+            return;
+        }
+        // Bin的起点按Tile对齐, 向下对齐到SIMD宽度不会越过Bin
+        x0 -= x0 % simd_width;
+
+        auto zero = simd_set(0);
+        auto lane = simd_lane_index();
+        SimdFloat edge_a[3] = { simd_set(triangle.edge_a[0]), simd_set(triangle.edge_a[1]), simd_set(triangle.edge_a[2]) };
+        auto depth_a = simd_set(triangle.depth_a);
+        auto depth_max = simd_set(triangle.depth_max);
+        for (int32_t y = y0; y <= y1; y ++) {
+            float py = y + 0.5f;
+            SimdFloat edge_row[3];
+            for (uint32_t i = 0; i < 3; i ++) {
+                edge_row[i] = simd_set(triangle.edge_b[i] * py + triangle.edge_c[i]);
+            }
+            auto depth_row = simd_set(triangle.depth_b * py + triangle.depth_c);
+            float *row = depth_buffer.data() + y * width;
+            for (int32_t x = x0; x <= x1; x += simd_width) {
+                auto px = simd_add(lane, simd_set(x + 0.5f));
+                auto inside = simd_and(
+                    simd_and(
+                        simd_ge(simd_add(simd_mul(edge_a[0], px), edge_row[0]), zero),
+                        simd_ge(simd_add(simd_mul(edge_a[1], px), edge_row[1]), zero)
+                    ),
+                    simd_ge(simd_add(simd_mul(edge_a[2], px), edge_row[2]), zero)
+                );
+                if (!simd_any(inside)) {
+                    continue;
+                }
+                auto depth = simd_min(simd_add(simd_mul(depth_a, px), depth_row), depth_max);
+                auto old_depth = simd_load(row + x);
+                simd_store(row + x, simd_select(inside, simd_min(old_depth, depth), old_depth));
+            }
+        }
+    }
+
+    void SoftwareOcclusionCuller::update_tile_depth(int32_t bin_min_x, int32_t bin_min_y, int32_t bin_max_x, int32_t bin_max_y) {
+        for (int32_t tile_y = bin_min_y / tile_height; tile_y < bin_max_y / static_cast<int32_t>(tile_height); tile_y ++) {
+            for (int32_t tile_x = bin_min_x / tile_width; tile_x < bin_max_x / static_cast<int32_t>(tile_width); tile_x ++) {
+                auto max_depth = simd_set(0);
+                for (uint32_t y = 0; y < tile_height; y ++) {
+                    const float *row = depth_buffer.data() + (tile_y * tile_height + y) * width + tile_x * tile_width;
+                    for (uint32_t x = 0; x < tile_width; x += simd_width) {
+                        max_depth = simd_max(max_depth, simd_load(row + x));
+                    }
+                }
+                tile_max_depth[tile_y * tile_count_x + tile_x] = simd_reduce_max(max_depth);
+            }
+        }
+    }
+
+    bool SoftwareOcclusionCuller::project_occludee(const Occludee &occludee, int32_t &min_x, int32_t &min_y, int32_t &max_x, int32_t &max_y, float &min_depth) const {
+        auto mvp = view_project * occludee.transform;
+        glm::vec2 screen_min(std::numeric_limits<float>::max()), screen_max(std::numeric_limits<float>::lowest());
+        min_depth = std::numeric_limits<float>::max();
+        for (uint32_t i = 0; i < 8; i ++) {
+            glm::vec3 corner = {
+                (i & 1) ? occludee.pos_max.x : occludee.pos_min.x,
+                (i & 2) ? occludee.pos_max.y : occludee.pos_min.y,
+                (i & 4) ? occludee.pos_max.z : occludee.pos_min.z,
+            };
+            auto clip = mvp * glm::vec4(corner, 1);
+            // 与近平面相交时无法投影
+            if (clip.w <= 1e-5f) {
+                return false;
+            }
+            auto ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 screen = { (ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height };
+            screen_min = glm::min(screen_min, screen);
+            screen_max = glm::max(screen_max, screen);
+            min_depth = std::min(min_depth, ndc.z);
+        }
+        min_x = static_cast<int32_t>(std::floor(std::clamp(screen_min.x, -1.0f, static_cast<float>(width))));
+        min_y = static_cast<int32_t>(std::floor(std::clamp(screen_min.y, -1.0f, static_cast<float>(height))));
+        max_x = static_cast<int32_t>(std::floor(std::clamp(screen_max.x, -1.0f, static_cast<float>(width))));
+        max_y = static_cast<int32_t>(std::floor(std::clamp(screen_max.y, -1.0f, static_cast<float>(height))));
+        min_x = std::max(min_x, 0);
+        min_y = std::max(min_y, 0);
+        max_x = std::min(max_x, static_cast<int32_t>(width) - 1);
+        max_y = std::min(max_y, static_cast<int32_t>(height) - 1);
+        return true;
+    }
+
+    bool SoftwareOcclusionCuller::test_occludee(const Occludee &occludee) const {
+        int32_t min_x, min_y, max_x, max_y;
+        float min_depth;
+        if (!project_occludee(occludee, min_x, min_y, max_x, max_y, min_depth)) {
+            return true;
+        }
+        // 包围盒完全在屏幕外的物体也视为不可见
+        if (min_x > max_x || min_y > max_y || min_depth > 1) {
+            return false;
+        }
+
+        // 只要有一个像素的遮挡物深度不比包围盒最近的点更近就是可见的
+        auto lane = simd_lane_index();
+        auto reference_depth = simd_set(min_depth);
+        auto rect_min_x = simd_set(static_cast<float>(min_x)), rect_max_x = simd_set(static_cast<float>(max_x));
+        for (int32_t tile_y = min_y / tile_height; tile_y <= max_y / static_cast<int32_t>(tile_height); tile_y ++) {
+            for (int32_t tile_x = min_x / tile_width; tile_x <= max_x / static_cast<int32_t>(tile_width); tile_x ++) {
+                if (tile_max_depth[tile_y * tile_count_x + tile_x] < min_depth) {
+                    continue;
+                }
+                int32_t y0 = std::max(min_y, tile_y * static_cast<int32_t>(tile_height));
+                int32_t y1 = std::min(max_y, tile_y * static_cast<int32_t>(tile_height) + static_cast<int32_t>(tile_height) - 1);
+                for (int32_t y = y0; y <= y1; y ++) {
+                    const float *row = depth_buffer.data() + y * width;
+                    for (int32_t x = tile_x * tile_width; x < (tile_x + 1) * static_cast<int32_t>(tile_width); x += simd_width) {
+                        auto px = simd_add(lane, simd_set(static_cast<float>(x)));
+                        auto in_rect = simd_and(simd_ge(px, rect_min_x), simd_ge(rect_max_x, px));
+                        if (simd_any(simd_and(in_rect, simd_ge(simd_load(row + x), reference_depth)))) {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void SoftwareOcclusionCuller::cull(const glm::mat4 &view_project) {
+        this->view_project = view_project;
+        auto start = Clock::now();
+        std::fill(depth_buffer.begin(), depth_buffer.end(), 1.0f);
+
+        // 第1步: 按三角形划分给每个线程, 变换后记录到覆盖的Bin中
+        std::vector<uint32_t> triangle_offsets(occluders.size() + 1, 0);
+        for (uint32_t i = 0; i < occluders.size(); i ++) {
+            triangle_offsets[i + 1] = triangle_offsets[i] + occluders[i].triangle_count;
+        }
+        uint32_t triangle_count = triangle_offsets.back();
+        int32_t bin_width = width / bin_count_x, bin_height = height / bin_count_y;
+        auto &thread_pool = *manager->thread_pool;
+        thread_pool.parallel_for(thread_count, [&](uint32_t thread_idx, uint32_t) {
+            auto &triangles = thread_triangles[thread_idx];
+            auto &bins = thread_bins[thread_idx];
+            triangles.clear();
+            for (auto &bin : bins) {
+                bin.clear();
+            }
+            uint32_t begin = static_cast<uint64_t>(triangle_count) * thread_idx / thread_count;
+            uint32_t end = static_cast<uint64_t>(triangle_count) * (thread_idx + 1) / thread_count;
+            if (begin == end) {
+                return;
+            }
+            uint32_t occluder_idx = std::upper_bound(triangle_offsets.begin(), triangle_offsets.end(), begin) - triangle_offsets.begin() - 1;
+            auto mvp = view_project * occluders[occluder_idx].transform;
+            for (uint32_t global_idx = begin; global_idx < end; global_idx ++) {
+                if (global_idx >= triangle_offsets[occluder_idx + 1]) {
+                    while (global_idx >= triangle_offsets[occluder_idx + 1]) {
+                        occluder_idx ++;
+                    }
+                    mvp = view_project * occluders[occluder_idx].transform;
+                }
+                auto &occluder = occluders[occluder_idx];
+                const uint32_t *indices = occluder.indices + 3 * (global_idx - triangle_offsets[occluder_idx]);
+                glm::vec4 clip[3];
+                for (uint32_t i = 0; i < 3; i ++) {
+                    auto &pos = *reinterpret_cast<const glm::vec3 *>(occluder.positions + indices[i] * occluder.position_stride);
+                    clip[i] = mvp * glm::vec4(pos, 1);
+                }
+                SetupTriangle triangle;
+                if (!setup_triangle(clip[0], clip[1], clip[2], triangle)) {
+                    continue;
+                }
+                uint32_t triangle_idx = triangles.size();
+                triangles.push_back(triangle);
+                for (int32_t bin_y = triangle.min_y / bin_height; bin_y <= triangle.max_y / bin_height; bin_y ++) {
+                    for (int32_t bin_x = triangle.min_x / bin_width; bin_x <= triangle.max_x / bin_width; bin_x ++) {
+                        bins[bin_y * bin_count_x + bin_x].push_back(triangle_idx);
+                    }
+                }
+            }
+        }, thread_count);
+
+        // 第2步: 每个Bin由一个线程光栅化, Bin之间没有重叠的像素
+        thread_pool.parallel_for(bin_count_x * bin_count_y, [&](uint32_t bin_idx, uint32_t) {
+            int32_t bin_min_x = (bin_idx % bin_count_x) * bin_width, bin_min_y = (bin_idx / bin_count_x) * bin_height;
+            for (uint32_t thread_idx = 0; thread_idx < thread_count; thread_idx ++) {
+                auto &triangles = thread_triangles[thread_idx];
+                for (auto triangle_idx : thread_bins[thread_idx][bin_idx]) {
+                    rasterize_triangle(triangles[triangle_idx], bin_min_x, bin_min_y, bin_min_x + bin_width, bin_min_y + bin_height);
+                }
+            }
+            update_tile_depth(bin_min_x, bin_min_y, bin_min_x + bin_width, bin_min_y + bin_height);
+        }, thread_count);
+
+        stats.occluder_triangle_count = triangle_count;
+        stats.rasterized_triangle_count = 0;
+        for (auto &triangles : thread_triangles) {
+            stats.rasterized_triangle_count += triangles.size();
+        }
+        stats.rasterize_time = elapsed_milliseconds(start);
+        stats.triangles_per_second = stats.rasterize_time > 0 ? stats.rasterized_triangle_count / (stats.rasterize_time / 1000.0f) : 0;
+
+        // 第3步: 测试被遮挡物体
+        start = Clock::now();
+        visibility.resize(occludees.size());
+        uint32_t occludee_count = occludees.size();
+        thread_pool.parallel_for(thread_count, [&](uint32_t thread_idx, uint32_t) {
+            uint32_t begin = static_cast<uint64_t>(occludee_count) * thread_idx / thread_count;
+            uint32_t end = static_cast<uint64_t>(occludee_count) * (thread_idx + 1) / thread_count;
+            for (uint32_t i = begin; i < end; i ++) {
+                visibility[i] = test_occludee(occludees[i]) ? 1 : 0;
+            }
+        }, thread_count);
+        visible_occludees.clear();
+        for (uint32_t i = 0; i < occludee_count; i ++) {
+            if (visibility[i] != 0) {
+                visible_occludees.push_back(i);
+            }
+        }
+        stats.test_time = elapsed_milliseconds(start);
+        stats.occludee_count = occludee_count;
+        stats.visible_count = visible_occludees.size();
+        stats.occluded_count = occludee_count - stats.visible_count;
+    }
+
+    void SoftwareOcclusionCuller::rasterize_reference(std::vector<float> &reference_depth, uint32_t &triangle_count) const {
+        reference_depth.assign(width * height, 1.0f);
+        triangle_count = 0;
+        for (auto &occluder : occluders) {
+            auto mvp = view_project * occluder.transform;
+            for (uint32_t t = 0; t < occluder.triangle_count; t ++) {
+                glm::vec4 clip[3];
+                for (uint32_t i = 0; i < 3; i ++) {
+                    auto &pos = *reinterpret_cast<const glm::vec3 *>(occluder.positions + occluder.indices[3 * t + i] * occluder.position_stride);
+                    clip[i] = mvp * glm::vec4(pos, 1);
+                }
+                SetupTriangle triangle;
+                if (!setup_triangle(clip[0], clip[1], clip[2], triangle)) {
+                    continue;
+                }
+                triangle_count ++;
+                for (int32_t y = triangle.min_y; y <= triangle.max_y; y ++) {
+                    float py = y + 0.5f;
+                    for (int32_t x = triangle.min_x; x <= triangle.max_x; x ++) {
+                        float px = x + 0.5f;
+                        bool inside = true;
+                        for (uint32_t i = 0; i < 3; i ++) {
+                            if (triangle.edge_a[i] * px + (triangle.edge_b[i] * py + triangle.edge_c[i]) < 0) {
+                                inside = false;
+                            }
+                        }
+                        if (!inside) {
+                            continue;
+                        }
+                        float depth = std::min(triangle.depth_a * px + (triangle.depth_b * py + triangle.depth_c), triangle.depth_max);
+                        auto &pixel = reference_depth[y * width + x];
+                        pixel = std::min(pixel, depth);
+                    }
+                }
+            }
+        }
+    }
+
+    bool SoftwareOcclusionCuller::test_occludee_reference(const Occludee &occludee, const std::vector<float> &reference_depth) const {
+        int32_t min_x, min_y, max_x, max_y;
+        float min_depth;
+        if (!project_occludee(occludee, min_x, min_y, max_x, max_y, min_depth)) {
+            return true;
+        }
+        if (min_x > max_x || min_y > max_y || min_depth > 1) {
+            return false;
+        }
+        for (int32_t y = min_y; y <= max_y; y ++) {
+            for (int32_t x = min_x; x <= max_x; x ++) {
+                if (reference_depth[y * width + x] >= min_depth) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    SoftwareOcclusionReferenceResult SoftwareOcclusionCuller::compare_with_reference() {
+        SoftwareOcclusionReferenceResult result {};
+        std::vector<float> reference_depth;
+        uint32_t triangle_count;
+        auto start = Clock::now();
+        rasterize_reference(reference_depth, triangle_count);
+        result.reference_rasterize_time = elapsed_milliseconds(start);
+        result.reference_triangles_per_second = result.reference_rasterize_time > 0 ? triangle_count / (result.reference_rasterize_time / 1000.0f) : 0;
+
+        // 编译器可能把标量实现中的乘加合并为FMA, 允许极小的误差
+        for (uint32_t i = 0; i < reference_depth.size(); i ++) {
+            float error = std::abs(reference_depth[i] - depth_buffer[i]);
+            result.max_depth_error = std::max(result.max_depth_error, error);
+            if (error > 1e-5f) {
+                result.depth_mismatch_count ++;
+            }
+        }
+        for (uint32_t i = 0; i < occludees.size() && i < visibility.size(); i ++) {
+            if (test_occludee_reference(occludees[i], reference_depth) != (visibility[i] != 0)) {
+                result.visibility_mismatch_count ++;
+            }
+        }
+        if (result.depth_mismatch_count > 0 || result.visibility_mismatch_count > 0) {
+            MCH_WARN("Software occlusion culler differs from scalar reference: {} depth pixels (max error {}), {} occludees", result.depth_mismatch_count, result.max_depth_error, result.visibility_mismatch_count)
+        }
+        return result;
+    }
+
+    SoftwareOcclusionCuller::~SoftwareOcclusionCuller() {
+        occluders.clear();
+        occludees.clear();
+        thread_triangles.clear();
+        thread_bins.clear();
+    }
+}
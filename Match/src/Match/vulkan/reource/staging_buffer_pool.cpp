@@ -0,0 +1,52 @@
+#include <Match/vulkan/resource/staging_buffer_pool.hpp>
+#include "../inner.hpp"
+
+namespace Match {
+    StagingBufferPool::StagingBufferPool() : cached_size(0) {
+    }
+
+    std::unique_ptr<Buffer> StagingBufferPool::acquire(uint64_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto best = free_buffers.end();
+        for (auto it = free_buffers.begin(); it != free_buffers.end(); it ++) {
+            if ((*it)->size < size) {
+                continue;
+            }
+            if (best == free_buffers.end() || (*it)->size < (*best)->size) {
+                best = it;
+            }
+        }
+        if (best != free_buffers.end()) {
+            auto buffer = std::move(*best);
+            free_buffers.erase(best);
+            cached_size -= buffer->size;
+            return buffer;
+        }
+
+        size = (size + size_granularity - 1) / size_granularity * size_granularity;
+        MCH_DEBUG("Create staging buffer: {} bytes", size)
+        return std::make_unique<Buffer>(size, vk::BufferUsageFlagBits::eTransferSrc, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    }
+
+    void StagingBufferPool::release(std::unique_ptr<Buffer> buffer) {
+        if (buffer == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cached_size + buffer->size > max_cached_size) {
+            return;
+        }
+        cached_size += buffer->size;
+        free_buffers.push_back(std::move(buffer));
+    }
+
+    void StagingBufferPool::clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_buffers.clear();
+        cached_size = 0;
+    }
+
+    StagingBufferPool::~StagingBufferPool() {
+        clear();
+    }
+}
@@ -26,9 +26,6 @@ namespace Match {
     }
 
     void VolumeData::upload_to_buffer(std::shared_ptr<TwoStageBuffer> buffer, bool is_flush) {
-        buffer->upload_data_from_vector(raw_data);
-        if (is_flush) {
-            buffer->flush();
-        }
+        buffer->upload_data_from_vector(raw_data, 0, is_flush);
     }
 }
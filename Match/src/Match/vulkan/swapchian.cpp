@@ -4,7 +4,7 @@
 #include "inner.hpp"
 
 namespace Match {
-    Swapchain::Swapchain() {
+    Swapchain::Swapchain(vk::SwapchainKHR old_swapchain) {
         SwapchainDetails details;
         query_swapchain_details(details);
 
@@ -73,7 +73,7 @@ namespace Match {
         MCH_DEBUG("Auto set swapchain image_count to {}", image_count);
 
         vk::SwapchainCreateInfoKHR swapchain_create_info {};
-        swapchain_create_info.setOldSwapchain(VK_NULL_HANDLE)
+        swapchain_create_info.setOldSwapchain(old_swapchain)
             .setClipped(VK_TRUE)
             .setSurface(manager->surface)
             .setPreTransform(details.capabilities.currentTransform)
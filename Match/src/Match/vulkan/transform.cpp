@@ -213,6 +213,16 @@ namespace Match {
         }
     }
 
+    template <>
+    vk::SamplerReductionMode transform<vk::SamplerReductionMode>(SamplerReductionMode mode) {
+        switch (mode) {
+        default:
+        _case(vk::SamplerReductionMode, eWeightedAverage, SamplerReductionMode, eWeightedAverage)
+        _case(vk::SamplerReductionMode, eMin, SamplerReductionMode, eMin)
+        _case(vk::SamplerReductionMode, eMax, SamplerReductionMode, eMax)
+        }
+    }
+
     template <>
     vk::BorderColor transform<vk::BorderColor>(SamplerBorderColor color) {
         switch (color) {
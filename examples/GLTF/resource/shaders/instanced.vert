@@ -0,0 +1,22 @@
+#version 450
+
+
+layout (location = 0) in vec3 pos;
+// EXT_mesh_gpu_instancing的逐实例世界矩阵, 占用4个location
+layout (location = 1) in mat4 instance_matrix;
+
+layout (binding = 0) uniform CameraUniform {
+    vec3 pos;
+    mat4 view;
+    mat4 project;
+} camera;
+
+layout (location = 0) out vec3 frag_normal;
+layout (location = 1) out vec4 frag_color;
+
+void main() {
+    vec3 world_pos = (instance_matrix * vec4(pos, 1)).xyz;
+    frag_normal = world_pos;
+    frag_color = vec4(1);
+    gl_Position = camera.project * camera.view * vec4(world_pos / 400, 1);
+}
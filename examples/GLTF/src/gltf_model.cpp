@@ -346,8 +346,10 @@ void GLTFNode::update() {
 			}
 			mesh->uniform_block.joint_count = (float)skin->joints.size();
 			memcpy(mesh->uniform_buffer->get_uniform_ptr(), &mesh->uniform_block, sizeof(GLTFMesh::UniformBlock));
+			mesh->uniform_buffer->flush();
 		} else {
 			memcpy(mesh->uniform_buffer->get_uniform_ptr(), &mat, sizeof(glm::mat4));
+			mesh->uniform_buffer->flush();
 		}
 	}
 
@@ -1,6 +1,8 @@
 #include <Match/Match.hpp>
 #include "camera.hpp"
 #include <imgui.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
 
 Match::APIManager *ctx;
 std::shared_ptr<Match::ResourceFactory> factory;
@@ -21,11 +23,13 @@ int main() {
         builder->build();
 
         auto bdr = factory->create_render_pass_builder();
-        bdr->add_attachment("depth", Match::AttachmentType::eDepth)
+        // Hi-Z需要采样深度
+        bdr->add_attachment("depth", Match::AttachmentType::eDepth, vk::ImageUsageFlagBits::eSampled)
             .add_subpass("main")
             .attach_output_attachment(Match::SWAPCHAIN_IMAGE_ATTACHMENT)
             .attach_depth_attachment("depth");
-        auto renderer = factory->create_renderer(bdr);
+        // 遮挡剔除需要在两次绘制之间暂停渲染, 只有动态渲染支持
+        auto renderer = factory->create_renderer(bdr, Match::RenderingMode::eDynamicRendering);
         renderer->attach_render_layer<Match::ImGuiLayer>("imgui");
 
         auto camera = std::make_unique<Camera>(*factory);
@@ -56,28 +60,346 @@ int main() {
                 .depth_test_enable = VK_TRUE,
             });
 
+        // EXT_mesh_gpu_instancing: 每个图元一次实例化绘制, 逐实例读取世界矩阵
+        auto instanced_vas = factory->create_vertex_attribute_set({
+            {
+                0, Match::InputRate::ePerVertex,
+                { Match::VertexType::eFloat3 }
+            },
+            {
+                1, Match::InputRate::ePerInstance,
+                { Match::VertexType::eFloat4, Match::VertexType::eFloat4, Match::VertexType::eFloat4, Match::VertexType::eFloat4 }
+            }
+        });
+        auto instanced_vert_shader = factory->compile_shader("instanced.vert", Match::ShaderStage::eVertex);
+        auto instanced_sp = factory->create_shader_program(renderer, "main");
+        instanced_sp->attach_vertex_shader(instanced_vert_shader)
+            .attach_fragment_shader(frag_shader)
+            .attach_vertex_attribute_set(instanced_vas)
+            .attach_descriptor_set(ds)
+            .compile({
+                .cull_mode = Match::CullMode::eBack,
+                .front_face = Match::FrontFace::eCounterClockwise,
+                .depth_test_enable = VK_TRUE,
+            });
+        bool enable_gpu_instancing = false;
+
         auto vertex_buffer = factory->create_vertex_buffer(sizeof(glm::vec3), scene->positions.size());
         vertex_buffer->upload_data_from_vector(scene->positions);
         auto index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, scene->indices.size());
         index_buffer->upload_data_from_vector(scene->indices);
 
+        uint32_t primitive_count = 0;
+        scene->enumerate_primitives([&](Match::GLTFNode *node, std::shared_ptr<Match::GLTFPrimitive> primitive) {
+            primitive_count ++;
+        });
+        auto culler = factory->create_gpu_culler(primitive_count, primitive_count);
+        scene->enumerate_ray_tracing_models([&](Match::GLTFNode *node, std::shared_ptr<Match::GLTFPrimitive> primitive, std::shared_ptr<Match::RayTracingModel> model) {
+            // 变形后的图元单独绘制
+            if (model->get_ray_tracing_model_type() == Match::RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive) {
+                return;
+            }
+            // 与顶点着色器中的缩放一致
+            culler->add_instance(culler->add_primitive(primitive), glm::scale(glm::mat4(1), glm::vec3(1 / 400.0f)));
+        });
+
+        // 场景带蒙皮或变形目标时, 每帧播放动画并在计算着色器中变形顶点
+        std::shared_ptr<Match::GLTFSkinner> skinner;
+        if (scene->get_deformed_primitive_count() > 0) {
+            skinner = factory->create_gltf_skinner(scene);
+        }
+        int32_t animation_index = scene->get_animation_count() > 0 ? 0 : -1;
+        bool play_animation = true;
+        // 实例0的姿态写回场景, 其余实例用于测试大量动画实例的求值耗时, 播放时间只由animator保存
+        std::shared_ptr<Match::GLTFAnimator> animator;
+        uint32_t animated_instance_count = 1;
+        auto create_animator = [&]() {
+            animator = factory->create_gltf_animator(scene, animation_index);
+            for (uint32_t i = 0; i < animated_instance_count; i ++) {
+                animator->add_instance(i * 0.01f);
+            }
+        };
+        if (animation_index >= 0) {
+            create_animator();
+        }
+        auto draw_deformed_primitives = [&]() {
+            if (skinner.get() == nullptr) {
+                return;
+            }
+            renderer->bind_shader_program(sp);
+            renderer->bind_vertex_buffer(scene->get_deformed_vertex_buffer());
+            renderer->bind_index_buffer(index_buffer);
+            scene->enumerate_deformed_primitives([&](Match::GLTFNode *node, std::shared_ptr<Match::GLTFDeformedPrimitive> deformed_primitive) {
+                auto primitive = deformed_primitive->get_primitive();
+                renderer->draw_indexed(primitive->index_count, 1, primitive->primitive_instance_data.first_index, deformed_primitive->get_deformed_vertex_offset(), 0);
+            });
+        };
+        culler->enable_occlusion_culling(renderer, "depth");
+
+        // CPU软件遮挡剔除: 包围盒较大的图元(墙壁, 地面, 柱子)作为遮挡物, 所有图元都参与测试
+        auto software_culler = factory->create_software_occlusion_culler();
+        std::vector<std::shared_ptr<Match::GLTFPrimitive>> primitives;
+        glm::vec3 scene_min(std::numeric_limits<float>::max()), scene_max(std::numeric_limits<float>::lowest());
+        scene->enumerate_ray_tracing_models([&](Match::GLTFNode *node, std::shared_ptr<Match::GLTFPrimitive> primitive, std::shared_ptr<Match::RayTracingModel> model) {
+            // 变形后的图元由draw_deformed_primitives单独绘制, 不参与剔除
+            if (model->get_ray_tracing_model_type() == Match::RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive) {
+                return;
+            }
+            primitives.push_back(primitive);
+            scene_min = glm::min(scene_min, primitive->pos_min);
+            scene_max = glm::max(scene_max, primitive->pos_max);
+        });
+        float occluder_size = glm::length(scene_max - scene_min) * 0.1f;
+        for (auto &primitive : primitives) {
+            auto transform = glm::scale(glm::mat4(1), glm::vec3(1 / 400.0f));
+            if (glm::length(primitive->pos_max - primitive->pos_min) > occluder_size) {
+                software_culler->add_occluder(primitive, transform);
+            }
+            software_culler->add_occludee(primitive, transform);
+        }
+        bool enable_software_culling = false;
+        bool compare_with_reference = false;
+        // 自检: 一个倾斜的四边形遮挡物一端位于相机和近平面之间, 另一端在近平面之后
+        // 与近平面相交时整个遮挡物被跳过, 后面的物体可见; 整体移到近平面之后再光栅化, 后面的物体被遮挡
+        auto check_near_plane = [&]() {
+            auto check_culler = factory->create_software_occlusion_culler(64, 64);
+            std::vector<glm::vec3> positions = { { -10, -10, -0.05f }, { 10, -10, -0.05f }, { 10, 10, -5 }, { -10, 10, -5 } };
+            // 两种环绕方向各一份, 与投影是否翻转y轴无关
+            std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3, 0, 2, 1, 0, 3, 2 };
+            auto occluder = check_culler->add_occluder(positions.data(), indices.data(), 4, glm::mat4(1));
+            auto occludee = check_culler->add_occludee(glm::vec3(-0.5f), glm::vec3(0.5f), glm::translate(glm::mat4(1), { 0, 0, -20 }));
+            auto view_project = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+            check_culler->cull(view_project);
+            bool straddling_passed = check_culler->get_stats().rasterized_triangle_count == 0 && check_culler->is_visible(occludee);
+            check_culler->set_occluder_transform(occluder, glm::translate(glm::mat4(1), { 0, 0, -1 }));
+            check_culler->cull(view_project);
+            bool behind_passed = check_culler->get_stats().rasterized_triangle_count > 0 && !check_culler->is_visible(occludee);
+            if (!straddling_passed || !behind_passed) {
+                MCH_ERROR("Software occlusion near plane check failed: straddling {}, behind {}", straddling_passed, behind_passed)
+            }
+            return straddling_passed && behind_passed;
+        };
+        bool near_plane_check_passed = check_near_plane();
+        // 比较缓存的扁平变换层级与逐节点沿父节点递归计算世界矩阵的耗时
+        float hierarchy_update_time = 0, hierarchy_recursive_time = 0;
+        uint32_t hierarchy_updated_count = 0;
+        // 场景的层级通常很浅, 另外构造一条很深的节点链, 只修改中间的一个节点, 与递归计算比较
+        const uint32_t chain_length = 4096;
+        float chain_update_time = 0, chain_recursive_time = 0;
+        uint32_t chain_updated_count = 0;
+        auto benchmark_chain = [&]() {
+            // 与GLTFScene相同的先序扁平数组, 链上每个节点的子树都延伸到数组末尾
+            std::vector<int32_t> parents(chain_length);
+            std::vector<uint32_t> subtree_ends(chain_length, chain_length);
+            std::vector<glm::mat4> local_matrices(chain_length, glm::translate(glm::mat4(1), { 0, 0.001f, 0 }));
+            std::vector<glm::mat4> world_matrices(chain_length);
+            std::vector<uint8_t> dirty(chain_length, 0);
+            for (uint32_t i = 0; i < chain_length; i ++) {
+                parents[i] = int32_t(i) - 1;
+                world_matrices[i] = i == 0 ? local_matrices[i] : world_matrices[i - 1] * local_matrices[i];
+            }
+            uint32_t dirty_index = chain_length / 2;
+            local_matrices[dirty_index] = glm::rotate(glm::mat4(1), glm::radians(1.0f), { 0, 1, 0 });
+            dirty[dirty_index] = 1;
+
+            // 与GLTFScene::update_world_matrices相同: 跳过干净的节点, 只重新计算脏节点的子树
+            auto start = std::chrono::high_resolution_clock::now();
+            chain_updated_count = 0;
+            uint32_t node_index = 0;
+            while (node_index < chain_length) {
+                if (dirty[node_index] == 0) {
+                    node_index ++;
+                    continue;
+                }
+                uint32_t subtree_end = subtree_ends[node_index];
+                for (uint32_t i = node_index; i < subtree_end; i ++) {
+                    dirty[i] = 0;
+                    world_matrices[i] = parents[i] < 0 ? local_matrices[i] : world_matrices[parents[i]] * local_matrices[i];
+                }
+                chain_updated_count += subtree_end - node_index;
+                node_index = subtree_end;
+            }
+            chain_update_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+
+            glm::mat4 checksum(0);
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < chain_length; i ++) {
+                glm::mat4 world = local_matrices[i];
+                for (int32_t parent = parents[i]; parent >= 0; parent = parents[parent]) {
+                    world = local_matrices[parent] * world;
+                }
+                checksum += world;
+            }
+            chain_recursive_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            MCH_DEBUG("Deep chain checksum: {}, cached leaf: {}", checksum[3][3], world_matrices.back()[3][1])
+        };
+        auto benchmark_hierarchy = [&]() {
+            for (uint32_t i = 0; i < scene->get_node_count(); i ++) {
+                if (scene->node_parents[i] < 0) {
+                    scene->set_node_translation(i, scene->node_translations[i]);
+                }
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            hierarchy_updated_count = scene->update_world_matrices();
+            hierarchy_update_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            glm::mat4 checksum(0);
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < scene->get_node_count(); i ++) {
+                glm::mat4 world = scene->local_matrices[i];
+                for (int32_t parent = scene->node_parents[i]; parent >= 0; parent = scene->node_parents[parent]) {
+                    world = scene->local_matrices[parent] * world;
+                }
+                checksum += world;
+            }
+            hierarchy_recursive_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start).count();
+            MCH_DEBUG("Transform hierarchy checksum: {}", checksum[3][3])
+            benchmark_chain();
+        };
+        Match::SoftwareOcclusionReferenceResult reference_result {};
+        // 用不同的线程数重新加载场景, 比较加载耗时
+        bool benchmark_loading = false;
+        std::vector<Match::GLTFLoadStats> loading_results;
+
         while (Match::window->is_alive()) {
             Match::window->poll_events();
+            if (benchmark_loading) {
+                benchmark_loading = false;
+                loading_results.clear();
+                for (uint32_t thread_count : { 1, 2, 4, 8, 16 }) {
+                    loading_results.push_back(factory->load_gltf_scene("../../../Scene/resource/models/Sponza/glTF/Sponza.gltf", {}, thread_count)->get_load_stats());
+                }
+            }
             camera->update(ImGui::GetIO().DeltaTime);
 
-            renderer->begin_render();
-
-            renderer->bind_shader_program(sp);
-            renderer->bind_vertex_buffer(vertex_buffer);
-            renderer->bind_index_buffer(index_buffer);
-            for (auto *node : scene->all_node_references) {
-                for (auto &primitive : node->mesh->primitives) {
-                    renderer->draw_indexed(primitive->index_count, 1, primitive->primitive_instance_data.first_index, primitive->primitive_instance_data.first_vertex, 0);
+            renderer->acquire_next_image();
+            if (skinner.get() != nullptr) {
+                if (animation_index >= 0) {
+                    if (play_animation) {
+                        animator->advance(ImGui::GetIO().DeltaTime);
+                    }
+                    animator->evaluate();
+                    animator->apply_to_scene(0);
+                }
+                // 变形命令录制在渲染Pass之外
+                skinner->skin(*renderer);
+            }
+            auto view_project = camera->data.project * camera->data.view;
+            if (enable_gpu_instancing) {
+                // 动画可能改变了节点的变换
+                scene->update_instance_transforms();
+                renderer->begin_render_pass();
+                renderer->bind_shader_program(instanced_sp);
+                renderer->bind_vertex_buffers({ vertex_buffer, scene->get_instance_transform_buffer() });
+                renderer->bind_index_buffer(index_buffer);
+                scene->enumerate_ray_tracing_models([&](Match::GLTFNode *node, std::shared_ptr<Match::GLTFPrimitive> primitive, std::shared_ptr<Match::RayTracingModel> model) {
+                    if (model->get_ray_tracing_model_type() == Match::RayTracingModel::RayTracingModelType::eGLTFDeformedPrimitive) {
+                        return;
+                    }
+                    renderer->draw_indexed(primitive->index_count, node->get_instance_count(), primitive->primitive_instance_data.first_index, primitive->primitive_instance_data.first_vertex, node->get_first_instance());
+                });
+                draw_deformed_primitives();
+            } else if (enable_software_culling) {
+                // 录制绘制命令前在CPU上剔除, 只绘制可见的图元
+                software_culler->cull(view_project);
+                if (compare_with_reference) {
+                    reference_result = software_culler->compare_with_reference();
+                }
+                renderer->begin_render_pass();
+                renderer->bind_shader_program(sp);
+                renderer->bind_vertex_buffer(vertex_buffer);
+                renderer->bind_index_buffer(index_buffer);
+                for (auto idx : software_culler->get_visible_occludees()) {
+                    auto &primitive = primitives[idx];
+                    renderer->draw_indexed(primitive->index_count, 1, primitive->primitive_instance_data.first_index, primitive->primitive_instance_data.first_vertex, idx);
                 }
+                draw_deformed_primitives();
+            } else {
+                culler->cull(*renderer, view_project);
+                renderer->begin_render_pass();
+
+                // 第1阶段: 绘制上一帧可见的图元
+                renderer->bind_shader_program(sp);
+                renderer->bind_vertex_buffer(vertex_buffer);
+                renderer->bind_index_buffer(index_buffer);
+                culler->draw(*renderer);
+
+                // 第2阶段: 用第1阶段的深度剔除其余图元, 绘制新出现的图元
+                renderer->suspend_render_pass();
+                culler->cull_late(*renderer);
+                renderer->resume_render_pass();
+                renderer->bind_shader_program(sp);
+                renderer->bind_vertex_buffer(vertex_buffer);
+                renderer->bind_index_buffer(index_buffer);
+                culler->draw_late(*renderer);
+                draw_deformed_primitives();
             }
 
             renderer->begin_layer_render("imgui");
             ImGui::Text("Framerate: %f", ImGui::GetIO().Framerate);
+            ImGui::Checkbox("GPU Instancing (EXT_mesh_gpu_instancing)", &enable_gpu_instancing);
+            ImGui::Checkbox("CPU Software Occlusion Culling", &enable_software_culling);
+            if (enable_gpu_instancing) {
+                ImGui::Text("Instances: %u, Primitives: %u", scene->get_instance_count(), primitive_count);
+            } else if (enable_software_culling) {
+                auto &stats = software_culler->get_stats();
+                ImGui::Text("Kernels: %s, Depth Buffer: %ux%u", Match::SoftwareOcclusionCuller::get_simd_name(), software_culler->get_width(), software_culler->get_height());
+                ImGui::Text("Occluder Triangles: %u, Rasterized: %u", stats.occluder_triangle_count, stats.rasterized_triangle_count);
+                ImGui::Text("Visible: %u, Occluded: %u / %u", stats.visible_count, stats.occluded_count, stats.occludee_count);
+                ImGui::Text("Rasterize: %.3f ms (%.2f M tri/s), Test: %.3f ms", stats.rasterize_time, stats.triangles_per_second / 1000000.0f, stats.test_time);
+                ImGui::Text("Near Plane Check: %s", near_plane_check_passed ? "passed" : "failed");
+                ImGui::Checkbox("Compare With Scalar Reference", &compare_with_reference);
+                if (compare_with_reference) {
+                    ImGui::Text("Reference Rasterize: %.3f ms (%.2f M tri/s)", reference_result.reference_rasterize_time, reference_result.reference_triangles_per_second / 1000000.0f);
+                    ImGui::Text("Mismatch: %u depth pixels (max error %f), %u primitives", reference_result.depth_mismatch_count, reference_result.max_depth_error, reference_result.visibility_mismatch_count);
+                }
+            } else {
+                auto &stats = culler->get_stats();
+                ImGui::Text("Primitives: %u", stats.instance_count);
+                ImGui::Text("Visible: %u, Frustum Culled: %u, Occluded: %u", stats.visible_count, stats.culled_count - stats.occluded_count, stats.occluded_count);
+                ImGui::Text("Culling GPU Time: %.3f ms", stats.gpu_time);
+            }
+            ImGui::Text("Nodes: %u", scene->get_node_count());
+            if (ImGui::Button("Benchmark Transform Hierarchy")) {
+                benchmark_hierarchy();
+            }
+            ImGui::Text("Cached Update: %.3f ms (%u nodes), Recursive: %.3f ms", hierarchy_update_time, hierarchy_updated_count, hierarchy_recursive_time);
+            ImGui::Text("Deep Chain %u: Cached Update %.3f ms (%u nodes), Recursive: %.3f ms", chain_length, chain_update_time, chain_updated_count, chain_recursive_time);
+            if (ImGui::Button("Benchmark Scene Loading")) {
+                benchmark_loading = true;
+            }
+            for (auto &stats : loading_results) {
+                ImGui::Text("%2u Threads: Images %.1f ms, Primitives %.1f ms, Total %.1f ms", stats.thread_count, stats.image_time, stats.primitive_time, stats.total_time);
+            }
+            if (skinner.get() != nullptr) {
+                if (animation_index >= 0) {
+                    if (ImGui::BeginCombo("Animation", scene->get_animation_name(animation_index).c_str())) {
+                        for (uint32_t i = 0; i < scene->get_animation_count(); i ++) {
+                            if (ImGui::Selectable(scene->get_animation_name(i).c_str(), animation_index == static_cast<int32_t>(i))) {
+                                animation_index = i;
+                                create_animator();
+                            }
+                        }
+                        ImGui::EndCombo();
+                    }
+                    ImGui::Checkbox("Play Animation", &play_animation);
+                    float animation_time = animator->get_time(0);
+                    if (ImGui::SliderFloat("Animation Time", &animation_time, 0, scene->get_animation_duration(animation_index))) {
+                        animator->set_time(0, animation_time);
+                    }
+                    if (ImGui::Button("Add 1000 Animated Instances")) {
+                        for (uint32_t i = 0; i < 1000; i ++) {
+                            animator->add_instance(animated_instance_count * 0.01f);
+                            animated_instance_count ++;
+                        }
+                    }
+                    auto &animator_stats = animator->get_stats();
+                    ImGui::Text("Animated Instances: %u, Tracks: %u, Kernels: %s", animator_stats.instance_count, animator_stats.track_count, Match::GLTFAnimator::get_simd_name());
+                    ImGui::Text("Animation Evaluate: %.3f ms", animator_stats.evaluate_time);
+                }
+                auto &stats = skinner->get_stats();
+                ImGui::Text("Deformed Primitives: %u, Vertices: %u, Joints: %u", stats.deformed_primitive_count, stats.deformed_vertex_count, stats.joint_count);
+                ImGui::Text("Upload: %.3f ms, BLAS Refit: %u", stats.upload_time, stats.refit_count);
+            }
             renderer->end_layer_render("imgui");
             renderer->end_render();
         }
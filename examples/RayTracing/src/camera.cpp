@@ -18,6 +18,7 @@ void Camera::upload_data() {
     auto direction = glm::rotateY(glm::rotateX(glm::vec3(0, 0, 1), glm::radians(pitch)), glm::radians(yaw));
     data.view = glm::lookAt(data.pos, data.pos + direction, glm::vec3(.0f, 1.0f, .0f));
     memcpy(uniform->get_uniform_ptr(), &data, sizeof(CameraUniform));
+    uniform->flush();
 }
 
 void Camera::update(float dt) {
@@ -247,6 +247,8 @@ public:
             ImGui::SliderFloat("Ligjt Intensity", &light_ptr->intensity, 0, 10);
             ImGui::SliderFloat("Ligjt Height", &light_ptr->pos.y, -5, 5);
             renderer->end_layer_render("imgui");
+            g->flush();
+            light->flush();
 
             renderer->end_render_pass();
 
@@ -272,6 +272,8 @@ int main() {
             pos_scaler->y_pos_scale = pos_scaler->x_pos_scale;
             // 将scale范围从[-1, 1]变换到[0.6, 1.3]
             color_scaler->color_scale = (scale + 3) / 3;
+            pos_uniform->flush();
+            color_uniform->flush();
 
             renderer->begin_render();
             renderer->bind_shader_program(shader_program);
@@ -1,6 +1,7 @@
 #include "dragon_scene.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/rotate_vector.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <imgui.h>
 
 void DragonScene::initialize() {
@@ -110,11 +111,34 @@ void DragonScene::initialize() {
     camera->upload_data();
 
     model = factory->load_model("dragon.obj");
-    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_index_count());
-    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count());
+    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_index_count(), {}, Match::BufferUploadMode::eStatic);
+    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count(), {}, Match::BufferUploadMode::eStatic);
     model->upload_data(vertex_buffer, index_buffer);
     offset_buffer = factory->create_vertex_buffer(sizeof(glm::vec3), offsets.size());
     offset_buffer->upload_data_from_vector(offsets);
+
+    // 每个龙的每个Mesh都作为一个实例参与剔除, instance_id对应offset_buffer中的偏移
+    uint32_t mesh_count = model->enumerate_meshes_name().size();
+    culler = factory->create_gpu_culler(mesh_count, mesh_count * offsets.size());
+    auto draw_indices = culler->add_model(model);
+    for (uint32_t i = 0; i < offsets.size(); i ++) {
+        for (auto draw_index : draw_indices) {
+            culler->add_instance(draw_index, glm::translate(glm::mat4(1), offsets[i]), i);
+        }
+    }
+
+    // CPU剔除的物体序号为 龙的序号 * Mesh数量 + Mesh的序号
+    mesh_names = model->enumerate_meshes_name();
+    cpu_culler = factory->create_frustum_culler();
+    for (auto &offset : offsets) {
+        cpu_culler->add_model(model, glm::translate(glm::mat4(1), offset));
+    }
+}
+
+void DragonScene::prepare_render() {
+    if (enable_culling) {
+        culler->cull(*renderer, camera->data.project * camera->data.view);
+    }
 }
 
 void DragonScene::update(float delta) {
@@ -123,13 +147,23 @@ void DragonScene::update(float delta) {
     static float time = 0;
     light->data->lights[0].pos = glm::rotateY(glm::vec3(1.0f, 1.0f, 1.0f), time);
     time += delta * 3;
+    light->uniform->flush();
 }
 
 void DragonScene::render() {
     renderer->bind_shader_program(shader_program);
     renderer->bind_vertex_buffers({ vertex_buffer, offset_buffer });
     renderer->bind_index_buffer(index_buffer);
-    renderer->draw_model(model, offsets.size(), 0);
+    if (enable_culling) {
+        culler->draw(*renderer);
+    } else if (enable_cpu_culling) {
+        cpu_culler->cull(camera->data.project * camera->data.view);
+        for (auto object_index : cpu_culler->get_visible_objects()) {
+            renderer->draw_model_mesh(model, mesh_names[object_index % mesh_names.size()], 1, object_index / mesh_names.size());
+        }
+    } else {
+        renderer->draw_model(model, offsets.size(), 0);
+    }
     renderer->next_subpass();
     renderer->bind_shader_program(post_shader_program);
     renderer->draw_indexed(3, 2, 0, 0, 0);
@@ -146,7 +180,24 @@ void DragonScene::render_imgui() {
 
     ImGui::Separator();
 
+    ImGui::Checkbox("GPU Frustum Culling", &enable_culling);
+    if (enable_culling) {
+        auto &stats = culler->get_stats();
+        ImGui::Text("Visible: %u Culled: %u / %u", stats.visible_count, stats.culled_count, stats.instance_count);
+        ImGui::Text("Culling GPU Time: %.3f ms", stats.gpu_time);
+    } else {
+        ImGui::Checkbox("CPU SIMD Frustum Culling", &enable_cpu_culling);
+        if (enable_cpu_culling) {
+            auto &stats = cpu_culler->get_stats();
+            ImGui::Text("Visible: %u Culled: %u / %u", stats.visible_count, stats.culled_count, stats.object_count);
+            ImGui::Text("Culling CPU Time: %.3f ms (Bounds Update: %.3f ms)", stats.cull_time, stats.update_time);
+        }
+    }
+
+    ImGui::Separator();
+
     ImGui::ColorEdit3("LightColor", &light->data->lights[0].color.x);
+    light->uniform->flush();
 }
 
 void DragonScene::destroy() {
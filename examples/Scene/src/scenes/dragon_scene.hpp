@@ -22,6 +22,7 @@ struct LightController {
 // 使用宏定义Scene
 class DragonScene final : public Scene {
     define_scene(DragonScene)
+    void prepare_render() override;
 private:
     // 场景资源
     std::unique_ptr<Camera> camera;
@@ -33,4 +34,9 @@ private:
     std::shared_ptr<Match::VertexBuffer> vertex_buffer;
     std::shared_ptr<Match::VertexBuffer> offset_buffer;
     std::shared_ptr<Match::IndexBuffer> index_buffer;
+    std::shared_ptr<Match::GPUCuller> culler;
+    std::shared_ptr<Match::FrustumCuller> cpu_culler;
+    std::vector<std::string> mesh_names;
+    bool enable_culling = true;
+    bool enable_cpu_culling = false;
 };
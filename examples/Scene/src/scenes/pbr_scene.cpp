@@ -60,8 +60,8 @@ void PBRScene::initialize() {
     shader_program_ds->bind_uniform(2, lights->uniform_buffer);
 
     model = factory->load_model("mori_knob.obj");
-    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_vertex_count());
-    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count());
+    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_vertex_count(), {}, Match::BufferUploadMode::eStatic);
+    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count(), {}, Match::BufferUploadMode::eStatic);
     model->upload_data(vertex_buffer, index_buffer);
 }
 
@@ -74,6 +74,7 @@ void PBRScene::update(float delta) {
     lights->data->point_lights[0].pos = glm::vec3(0, pos.x, pos.z);    // 绕X轴旋转
     lights->data->point_lights[1].pos = glm::vec3(pos.x, 0, pos.z);    // 绕Y轴旋转
     lights->data->point_lights[2].pos = glm::vec3(pos.x, pos.z, 0);    // 绕Z轴旋转
+    lights->uniform_buffer->flush();
 }
 
 void PBRScene::render() {
@@ -95,6 +96,8 @@ void PBRScene::render_imgui() {
     ImGui::SliderFloat("粗糙度", &material->data->roughness, 0, 1);
     ImGui::SliderFloat("金属度", &material->data->metallic, 0, 1);
     ImGui::SliderFloat("反射度", &material->data->reflectance, 0, 1);
+    lights->uniform_buffer->flush();
+    material->uniform_buffer->flush();
 }
 
 void PBRScene::destroy() {
@@ -9,7 +9,8 @@ void RayTracingScene::initialize() {
     auto render_pass_builder = factory->create_render_pass_builder();
     render_pass_builder->add_subpass("main")
         .attach_output_attachment(Match::SWAPCHAIN_IMAGE_ATTACHMENT);
-    renderer = factory->create_renderer(render_pass_builder);
+    // 使用动态渲染, 窗口大小改变时不需要重建FrameBuffer和管线
+    renderer = factory->create_renderer(render_pass_builder, Match::RenderingMode::eDynamicRendering);
     renderer->attach_render_layer<Match::ImGuiLayer>("imgui layer");
 
     camera = std::make_unique<Camera>(*factory);
@@ -185,6 +186,31 @@ void RayTracingScene::initialize() {
             .depth_test_enable = VK_FALSE,
         });
     shader_program_ds->bind_texture(0, ray_tracing_result_image, sampler);
+
+    // 使用render_graph组织光追渲染和光栅化渲染
+    // 每个Pass声明自己读写的资源,render_graph会计算执行顺序,并自动插入Pass之间的屏障
+    render_graph = factory->create_render_graph(renderer);
+    render_graph->import_image("ray tracing result", ray_tracing_result_image);
+    // 光追类似于计算,并不是直接将画面输出到屏幕上,而是将光追的结果储存在缓存图片中,再由光栅化程序渲染到屏幕
+    render_graph->add_pass("ray tracing", Match::RenderGraphPassType::eRayTracing)
+        .write("ray tracing result", Match::RenderGraphResourceUsage::eStorage)
+        .execute([this]() {
+            renderer->bind_shader_program(ray_tracing_shader_program);
+            // 进行光追计算,也就是调用光线发射器,缓存图片的(宽高深)是(Width*Height*Depth)  (1920 * 1080 * 1),所以为每个像素都调用一次光线发射器,
+            // renderer->trace_rays() 默认 Width为窗口宽, Height为窗口高, Depth为1
+            // 之后会调用光线发射器 Width*Height*Depth 次,每次调用都会分配一个gl_LaunchIDEXT,代表W,H,D三个维度的索引,gl_LaunchSizeEXT代表总的W,H,D
+            auto [width, height] = Match::runtime_setting->get_window_size();
+            renderer->trace_rays(width, height, 1);
+        });
+    // 光栅化Pass会开启RenderPass,并保持开启给之后的imgui layer使用
+    render_graph->add_pass("present", Match::RenderGraphPassType::eRaster)
+        .read("ray tracing result", Match::RenderGraphResourceUsage::eSampled)
+        .execute([this]() {
+            // 基础光栅化渲染,将ray_tracing_result_image渲染到屏幕
+            renderer->bind_shader_program(shader_program);
+            renderer->draw(3, 2, 0, 0);
+        });
+    render_graph->compile();
 }
 
 void RayTracingScene::update(float dt) {
@@ -240,20 +266,8 @@ void RayTracingScene::update(float dt) {
 }
 
 void RayTracingScene::render() {
-    // 光追渲染
-    // 光追类似以计算,并不是直接将画面输出到屏幕上,而是将光追的结果储存在缓存图片中,再由光栅化程序渲染到屏幕
-    // 因为光追是计算,不应该在RenderPass中进行,而Scene::render()在调用前已经开启了RenderPass,所以会报错
-    renderer->bind_shader_program(ray_tracing_shader_program);
-    // 进行光追计算,也就是调用光线发射器,缓存图片的(宽高深)是(Width*Height*Depth)  (1920 * 1080 * 1),所以为每个像素都调用一次光线发射器,
-    // renderer->trace_rays() 默认 Width为窗口宽, Height为窗口高, Depth为1
-    // 之后会调用光线发射器 Width*Height*Depth 次,每次调用都会分配一个gl_LaunchIDEXT,代表W,H,D三个维度的索引,gl_LaunchSizeEXT代表总的W,H,D
-    auto [width, height] = Match::runtime_setting->get_window_size();
-    renderer->trace_rays(width, height, 1);
-
-    // 基础光栅化渲染,将ray_tracing_result_image渲染到屏幕
-    renderer->begin_render_pass();
-    renderer->bind_shader_program(shader_program);
-    renderer->draw(3, 2, 0, 0);
+    // 光追Pass和光栅化Pass之间的屏障与布局转换由render_graph自动插入
+    render_graph->execute();
 }
 
 void RayTracingScene::render_imgui() {
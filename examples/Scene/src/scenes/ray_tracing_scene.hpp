@@ -39,4 +39,6 @@ private:
     std::shared_ptr<Match::Sampler> sampler;
     std::shared_ptr<Match::DescriptorSet> shader_program_ds;
     std::shared_ptr<Match::GraphicsShaderProgram> shader_program;
+
+    std::shared_ptr<Match::RenderGraph> render_graph;
 };
@@ -137,10 +137,8 @@ void RayTracingV2Scene::initialize() {
         .bind_storage_buffer(4, sphere_collect->get_custom_data_buffer<Material>())
         .bind_storage_buffer(5, instance_collect->get_instance_address_data_buffer())
         .bind_storage_buffer(6, instance_collect->get_custom_instance_data_buffer<Material>())
-        .bind_storage_buffer(7, instance_collect->get_custom_instance_data_buffer<Match::GLTFPrimitiveInstanceData>())
-        .bind_storage_buffer(8, gltf_scene->get_materials_buffer())
-        .bind_storage_buffer(9, gltf_scene->get_attribute_buffer("NORMAL"))
-        .bind_storage_buffer(10, gltf_scene->get_attribute_buffer("TEXCOORD_0"));
+        .bind_storage_buffer(7, instance_collect->get_custom_instance_data_buffer<Match::GLTFPrimitiveInstanceData>());
+    bind_gltf_buffers(gltf_scene);
     gltf_scene->bind_textures(ray_tracing_shader_program_ds, 11);
 
     ray_tracing_shader_program = factory->create_ray_tracing_shader_program();
@@ -181,9 +179,44 @@ void RayTracingV2Scene::initialize() {
         });
 }
 
+void RayTracingV2Scene::bind_gltf_buffers(std::shared_ptr<Match::GLTFScene> scene) {
+    ray_tracing_shader_program_ds->bind_storage_buffer(8, scene->get_materials_buffer())
+        .bind_storage_buffer(9, scene->get_attribute_buffer("NORMAL"))
+        .bind_storage_buffer(10, scene->get_attribute_buffer("TEXCOORD_0"));
+}
+
 void RayTracingV2Scene::update(float dt) {
     camera->update(dt);
 
+    // 依次使用显存和主机可见内存中的法线, uv坐标和材质各渲染一段时间, 跳过切换后的前几帧
+    constexpr uint32_t warmup_frame_count = 10;
+    constexpr uint32_t measure_frame_count = 300;
+    if (benchmark_location >= 0) {
+        if (benchmark_frame_count >= warmup_frame_count) {
+            benchmark_frame_time += dt;
+        }
+        benchmark_frame_count ++;
+        if (benchmark_frame_count == warmup_frame_count + measure_frame_count) {
+            benchmark_results[benchmark_location] = benchmark_frame_time * 1000 / measure_frame_count;
+            benchmark_location ++;
+            benchmark_frame_count = 0;
+            benchmark_frame_time = 0;
+            // 描述符集可能还在被未完成的帧使用, 重新绑定前等待设备空闲
+            renderer->wait_for_destroy();
+            if (benchmark_location == 1) {
+                if (host_visible_gltf_scene.get() == nullptr) {
+                    host_visible_gltf_scene = factory->load_gltf_scene("Sponza/glTF/Sponza.gltf", {
+                        "NORMAL", "TEXCOORD_0"
+                    }, 0, Match::GLTFBufferLocation::eHostVisible);
+                }
+                bind_gltf_buffers(host_visible_gltf_scene);
+            } else {
+                bind_gltf_buffers(gltf_scene);
+                benchmark_location = -1;
+            }
+        }
+    }
+
     static float time = 0;
     time += dt;
     ray_tracing_shader_program_constants->push_constant("time", time);
@@ -240,6 +273,17 @@ void RayTracingV2Scene::render_imgui() {
     changed |= ImGui::ColorEdit3("light_color", &dragon_material.light_color.r);
     changed |= ImGui::SliderFloat("light_intensity", &dragon_material.light_intensity, 0, 1);
 
+    if (benchmark_location < 0) {
+        if (ImGui::Button("Benchmark GLTF Buffer Location")) {
+            benchmark_location = 0;
+            benchmark_frame_count = 0;
+            benchmark_frame_time = 0;
+        }
+    } else {
+        ImGui::Text("Benchmarking %s ...", benchmark_location == 0 ? "Device Local" : "Host Visible");
+    }
+    ImGui::Text("Device Local: %.3f ms, Host Visible: %.3f ms", benchmark_results[0], benchmark_results[1]);
+
     if (changed) {
         frame_count = 0;
     }
@@ -22,6 +22,13 @@ private:
     std::shared_ptr<Match::Model> model;
     std::shared_ptr<Match::SphereCollect> sphere_collect;
     std::shared_ptr<Match::GLTFScene> gltf_scene;
+    // 属性和材质放在主机可见内存中的同一个场景, 用于对比光追帧时间
+    std::shared_ptr<Match::GLTFScene> host_visible_gltf_scene;
+    // 当前测试的存放位置序号, -1表示没有在测试
+    int benchmark_location = -1;
+    uint32_t benchmark_frame_count = 0;
+    float benchmark_frame_time = 0;
+    float benchmark_results[2] = { 0, 0 };
 
     std::shared_ptr<Match::StorageImage> ray_tracing_result_image;
     std::shared_ptr<Match::RayTracingInstanceCollect> instance_collect;
@@ -33,4 +40,6 @@ private:
     std::shared_ptr<Match::Sampler> sampelr;
     std::shared_ptr<Match::DescriptorSet> shader_program_ds;
     std::shared_ptr<Match::GraphicsShaderProgram> shader_program;
+private:
+    void bind_gltf_buffers(std::shared_ptr<Match::GLTFScene> scene);
 };
@@ -45,6 +45,7 @@ void RayMarchingScene::update(float dt) {
     static float time = 0;
     time += dt;
     data->light = glm::vec3(data->sphere.x, 0, data->sphere.z) + glm::rotateY(glm::vec3(1, 1, 1), time);
+    uniform_buffer->flush();
 }
 
 void RayMarchingScene::render() {
@@ -60,6 +61,7 @@ void RayMarchingScene::render_imgui() {
     ImGui::SliderFloat("Epsillon Dist", &data->epsillon_dist, 0.000001, 0.01);
     ImGui::SliderFloat3("Sphere Pos", &data->sphere.x, -3, 3);
     ImGui::SliderFloat("Sphere R", &data->sphere.w, 0.001, 2);
+    uniform_buffer->flush();
 }
 
 void RayMarchingScene::destroy() {
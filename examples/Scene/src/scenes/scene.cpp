@@ -24,6 +24,7 @@ void SceneManager::render() {
     // 2. begin_render_pass();   开启RenderPass
     // 对于光追场景,需要在current_scene->render()中手动开启RenderPass
     current_scene->renderer->acquire_next_image();
+    current_scene->prepare_render();
     if (!current_scene->is_ray_tracing_scene) {
         current_scene->renderer->begin_render_pass();
     }
@@ -37,6 +38,13 @@ void SceneManager::render() {
             current_callback = callback;
         }
     }
+    // 碎片整理会等待设备空闲, 只在需要时手动触发, 和切换场景一样在帧结束后执行
+    if (ImGui::Button("Defragment")) {
+        current_callback = [this]() {
+            defragmentation_stats = Match::Defragment();
+        };
+    }
+    ImGui::Text("Moved %u allocations (%llu bytes), fragmentation %.3f -> %.3f", defragmentation_stats.allocations_moved, static_cast<unsigned long long>(defragmentation_stats.bytes_moved), defragmentation_stats.fragmentation_before, defragmentation_stats.fragmentation_after);
     current_scene->renderer->end_layer_render("imgui layer");
 
     current_scene->renderer->end_render();
@@ -49,7 +57,7 @@ void SceneManager::render() {
 
 void SceneManager::destroy_scene() {
     if (current_scene.get() != nullptr) {
-        current_scene->renderer->wait_for_destroy();
+        // 资源会交给销毁队列在帧完成后销毁, 不需要等待设备空闲
         current_scene->destroy();
         current_scene.reset();
     }
@@ -24,6 +24,8 @@ public:
     Scene(std::shared_ptr<Match::ResourceFactory> factory);
     virtual void initialize() = 0;
     virtual void update(float delta) = 0;
+    // 在RenderPass开始前调用, 用于录制计算任务
+    virtual void prepare_render() {}
     virtual void render() = 0;
     virtual void render_imgui() = 0;
     virtual void destroy() = 0;
@@ -63,4 +65,5 @@ private:
     std::unique_ptr<Scene> current_scene;
     std::map<std::string, LoadSceneCallback> load_scene_callbacks;
     std::optional<LoadSceneCallback> current_callback;
+    Match::DefragmentationStats defragmentation_stats {};
 };
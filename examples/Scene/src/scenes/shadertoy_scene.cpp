@@ -71,10 +71,6 @@ void ShaderToyScene::updata_shader_program() {
     shader_program->compile({
         .cull_mode = Match::CullMode::eNone,
         .depth_test_enable = VK_FALSE,
-        .dynamic_states = {
-            vk::DynamicState::eViewport,
-            vk::DynamicState::eScissor,
-        }
     });
 
     printf("\n\n\n\n\n\n\n\n");
@@ -110,6 +106,7 @@ void ShaderToyScene::update(float delta) {
         shader_input->uniform->iMouse.z = 1;
     }
     shader_input->uniform->iDate = glm::vec4(2023, 12, 24, 0);
+    shader_input->uniform_buffer->flush();
 }
 
 void ShaderToyScene::render() {
@@ -125,8 +122,8 @@ void ShaderToyScene::render() {
     shader_program_constants->push_constant("width", width);
     shader_program_constants->push_constant("height", height);
     shader_input->uniform->iResolution = glm::vec3(width, height, 1.0f);
-    renderer->set_viewport(0, static_cast<float>(size.height), static_cast<float>(size.width), -static_cast<float>(size.height));
-    renderer->set_scissor(0, 0, size.width, size.height);
+    shader_input->uniform_buffer->flush();
+    // 管线默认使用动态视口和裁剪, 绑定时自动设置为窗口大小
     renderer->draw_indexed(6, 1, 0, 0, 0);
 }
 
@@ -3,11 +3,12 @@
 
 void SSAOScene::initialize() {
     auto builder = factory->create_render_pass_builder();
-    builder->add_attachment("depth", Match::AttachmentType::eDepth);
+    // depth和NormalBuffer只在RenderPass内部使用, 声明为Transient
+    builder->add_transient_attachment("depth", Match::AttachmentType::eDepth);
     // PosBuffer 前三个Float存储世界坐标系坐标，最后一个Float存储深度信息
     builder->add_attachment("PosBuffer", Match::AttachmentType::eFloat4Buffer);
     // NormalBuffer 前三个Float存储世界坐标系法向量，最后一个Float标记该位置是否有Fragment，有为1，没有为0
-    builder->add_attachment("NormalBuffer", Match::AttachmentType::eFloat4Buffer);
+    builder->add_transient_attachment("NormalBuffer", Match::AttachmentType::eFloat4Buffer);
     builder->add_attachment("SSAOBuffer", Match::AttachmentType::eFloat4Buffer);
 
     auto &prepare_subpass = builder->add_subpass("prepare");
@@ -142,8 +143,8 @@ void SSAOScene::initialize() {
     // model = factory->load_model("dragon.obj");
     model = factory->load_model("mori_knob.obj");
     // 创建buffer
-    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_vertex_count());
-    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count());
+    vertex_buffer = factory->create_vertex_buffer(sizeof(Match::Vertex), model->get_vertex_count(), {}, Match::BufferUploadMode::eStatic);
+    index_buffer = factory->create_index_buffer(Match::IndexType::eUint32, model->get_index_count(), {}, Match::BufferUploadMode::eStatic);
     // 上传数据
     model->upload_data(vertex_buffer, index_buffer);
 
@@ -179,6 +180,7 @@ void SSAOScene::initialize() {
     }
     ssao_samples_uniform_buffer = factory->create_uniform_buffer(sizeof(glm::vec4) * ssao_samples.size());
     memcpy(ssao_samples_uniform_buffer->get_uniform_ptr(), ssao_samples.data(), sizeof(glm::vec4) * ssao_samples.size());
+    ssao_samples_uniform_buffer->flush();
     ssao_random_vecs_texture = factory->create_texture(reinterpret_cast<uint8_t *>(ssao_random_vecs.data()), a, a);
 
     ssao_shader_program_ds->bind_uniform(2, ssao_samples_uniform_buffer);
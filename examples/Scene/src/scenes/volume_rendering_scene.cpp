@@ -14,13 +14,15 @@ void VolumeRenderingScene::initialize() {
     args = factory->create_uniform_buffer(sizeof(VolumeRenderingArgs));
     auto *ptr = static_cast<VolumeRenderingArgs *>(args->get_uniform_ptr());
     *ptr = VolumeRenderingArgs {};
+    args->flush();
 
+    // 体积数据只上传一次, 使用静态上传模式, 上传完成后归还暂存缓冲
     volume_data_cloud = factory->load_volume_data("wdas_cloud_density.match_volume_data");
-    volume_buffer_cloud = factory->create_storage_buffer(sizeof(float) * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution);
+    volume_buffer_cloud = factory->create_storage_buffer(sizeof(float) * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution, Match::BufferUploadMode::eStatic);
     volume_data_cloud->upload_to_buffer(volume_buffer_cloud);
 
     volume_data_smoke = factory->load_volume_data("bunny_cloud_density.match_volume_data");
-    volume_buffer_smoke = factory->create_storage_buffer(sizeof(float) * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution);
+    volume_buffer_smoke = factory->create_storage_buffer(sizeof(float) * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution * Match::volume_raw_data_resolution, Match::BufferUploadMode::eStatic);
     volume_data_smoke->upload_to_buffer(volume_buffer_smoke);
 
     camera = std::make_unique<Camera>(*factory);
@@ -198,6 +200,7 @@ void VolumeRenderingScene::render_imgui() {
 
 
     if (changed) {
+        args->flush();
         frame_count = 0;
     }
 }